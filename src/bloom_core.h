@@ -0,0 +1,448 @@
+/*
+ * Bloom filter lookup core
+ *
+ * Copyright (c) 2025 John Byrd
+ * https://github.com/johnwbyrd/bloomer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Everything that turns a word into probes and tests a probe against a
+ * record, in portable C: the hash functions, the Golomb-coded set, the
+ * binary fuse filter remix, the heat remap, the common-word table and the
+ * generated lookup kernel.
+ * spellcheck.c builds it for the C64 and host/bloomcheck.c for the build
+ * machine, so both compute the same probes from the same generated
+ * headers. Include bloom_config.h first.
+ */
+
+#ifndef BLOOM_CORE_H
+#define BLOOM_CORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* ========================================================================== */
+/* CONSTANTS AND TYPES                                                       */
+/* ========================================================================== */
+
+#define RECORD_SIZE 254 /* CBM DOS REL max record size */
+#define BITS_PER_BYTE 8
+#define RECORD_BITS ((uint16_t)RECORD_SIZE * BITS_PER_BYTE)
+
+/* PETSCII character ranges */
+#define PETSCII_LOWERCASE_START 0xC1
+#define PETSCII_LOWERCASE_END 0xDA
+#define PETSCII_UPPERCASE_START 0x41
+#define PETSCII_UPPERCASE_END 0x5A
+#define PETSCII_SHIFTED_START 0x61
+#define PETSCII_SHIFTED_END 0x7A
+#define PETSCII_TO_ASCII_OFFSET 0x80
+#define LOWERCASE_TO_UPPERCASE_OFFSET 0x20
+
+/* Heat remap: high bits of each physical record, packed into bytes */
+#define REMAP_PER_BYTE (8 / BLOOM_REMAP_HIGH_BITS)
+#define REMAP_HIGH_MASK ((1 << BLOOM_REMAP_HIGH_BITS) - 1)
+
+#if BLOOM_LAYOUT == BLOOM_LAYOUT_GCS
+/* One Golomb-coded set value, located by record and key within record */
+typedef struct {
+  uint16_t record;
+  uint16_t key;
+} bloom_probe_t;
+#else
+/* One Bloom filter bit, located by record, byte within record and mask.
+ * A binary fuse filter probe is a byte, and mask its fingerprint share. */
+typedef struct {
+  uint16_t record;
+  uint8_t byte;
+  uint8_t mask;
+} bloom_probe_t;
+#endif
+
+/* ========================================================================== */
+/* HASH FUNCTIONS                                                            */
+/* ========================================================================== */
+/* Must match hash_functions.py exactly; bloomcheck -v checks it             */
+
+/*
+ * Each hash is a left-to-right fold: an initial value from the seed and a
+ * step per character. The lookup kernel advances them a character at a
+ * time as the user types, so they are also exposed one step at a time.
+ */
+
+static inline uint32_t fnv1a_init(uint8_t seed) {
+  return 2166136261UL + seed;
+}
+
+static inline uint32_t fnv1a_step(uint32_t hash, uint8_t c) {
+  hash ^= c;
+  return hash * 16777619UL;
+}
+
+static uint32_t hash_fnv1a(const char *word, uint8_t seed) {
+  uint32_t hash = fnv1a_init(seed);
+  while (*word) {
+    hash = fnv1a_step(hash, (uint8_t)(*word));
+    word++;
+  }
+  return hash;
+}
+
+static inline uint32_t djb2_init(uint8_t seed) {
+  return 5381UL + seed;
+}
+
+static inline uint32_t djb2_step(uint32_t hash, uint8_t c) {
+  return ((hash << 5) + hash) + c;
+}
+
+static uint32_t hash_djb2(const char *word, uint8_t seed) {
+  uint32_t hash = djb2_init(seed);
+  while (*word) {
+    hash = djb2_step(hash, (uint8_t)(*word));
+    word++;
+  }
+  return hash;
+}
+
+static inline uint32_t sdbm_init(uint8_t seed) {
+  return seed;
+}
+
+static inline uint32_t sdbm_step(uint32_t hash, uint8_t c) {
+  return c + (hash << 6) + (hash << 16) - hash;
+}
+
+static uint32_t hash_sdbm(const char *word, uint8_t seed) {
+  uint32_t hash = sdbm_init(seed);
+  while (*word) {
+    hash = sdbm_step(hash, (uint8_t)(*word));
+    word++;
+  }
+  return hash;
+}
+
+static inline uint32_t jenkins_init(uint8_t seed) {
+  return seed;
+}
+
+static inline uint32_t jenkins_step(uint32_t hash, uint8_t c) {
+  hash += c;
+  hash += (hash << 10);
+  hash ^= (hash >> 6);
+  return hash;
+}
+
+/* Final avalanche step of the Jenkins one-at-a-time hash */
+static uint32_t jenkins_final(uint32_t hash) {
+  hash += (hash << 3);
+  hash ^= (hash >> 11);
+  hash += (hash << 15);
+  return hash;
+}
+
+static uint32_t hash_jenkins(const char *word, uint8_t seed) {
+  uint32_t hash = jenkins_init(seed);
+  while (*word) {
+    hash = jenkins_step(hash, (uint8_t)(*word));
+    word++;
+  }
+  return jenkins_final(hash);
+}
+
+static inline uint32_t murmur_init(uint8_t seed) {
+  return seed + 0x9747b28cUL;
+}
+
+static inline uint32_t murmur_step(uint32_t hash, uint8_t c) {
+  hash ^= c;
+  hash *= 0x5bd1e995UL;
+  hash ^= (hash >> 15);
+  return hash;
+}
+
+static uint32_t hash_murmur(const char *word, uint8_t seed) {
+  uint32_t hash = murmur_init(seed);
+  while (*word) {
+    hash = murmur_step(hash, (uint8_t)(*word));
+    word++;
+  }
+  return hash;
+}
+
+#if BLOOM_HASH_SCHEME == BLOOM_HASH_PEARSON
+/*
+ * Pearson hash widened to 32 bits, for the 6502
+ *
+ * Four byte lanes each walk pearson_table (from bloom_config.h) with a
+ * key of their own XORed into every character: a step is an XOR and an
+ * indexed load per lane, with no multi-byte arithmetic. The keys are
+ * multiples of PEARSON_LANE_KEY; lane 0 is the low byte of the value.
+ */
+#define PEARSON_LANES 4
+#define PEARSON_LANE_KEY 32
+
+/* What lane of the hash with this seed XORs into each character */
+#define pearson_key(seed, lane)                                               \
+  ((uint8_t)(((seed) * PEARSON_LANES + (lane)) * PEARSON_LANE_KEY))
+
+static inline uint8_t pearson_step(uint8_t lane, uint8_t c) {
+  return pearson_table[lane ^ c];
+}
+
+static inline uint32_t pearson_value(const uint8_t *lanes) {
+  return lanes[0] | ((uint16_t)lanes[1] << 8) | ((uint32_t)lanes[2] << 16) |
+         ((uint32_t)lanes[3] << 24);
+}
+
+static uint32_t hash_pearson(const char *word, uint8_t seed) {
+  uint8_t lanes[PEARSON_LANES] = {0};
+  uint8_t i;
+
+  while (*word) {
+    for (i = 0; i < PEARSON_LANES; i++) {
+      lanes[i] = pearson_step(lanes[i], (uint8_t)*word ^ pearson_key(seed, i));
+    }
+    word++;
+  }
+  return pearson_value(lanes);
+}
+#endif
+
+#if BLOOM_LAYOUT == BLOOM_LAYOUT_FUSE
+/*
+ * Remix a word's first hash into one binary fuse filter value
+ *
+ * The MurmurHash3 finalizer. The kernel adds a different constant to the
+ * hash for each value; the shift-and-add hashes alone would not spread
+ * three probes independently over so few slots.
+ */
+static uint32_t fuse_mix(uint32_t hash) {
+  hash ^= hash >> 16;
+  hash *= 0x85EBCA6BUL;
+  hash ^= hash >> 13;
+  hash *= 0xC2B2AE35UL;
+  hash ^= hash >> 16;
+  return hash;
+}
+#endif
+
+#if BLOOM_LAYOUT == BLOOM_LAYOUT_GCS
+/* ========================================================================== */
+/* GOLOMB-CODED SET                                                          */
+/* ========================================================================== */
+/* Rice-coded sorted hash values in place of Bloom filter bits               */
+
+/*
+ * Find the record whose range holds a hash value
+ *
+ * Returns: the value's key, its offset from the record's base
+ *
+ * Binary search for the last record base not above value. Record 0
+ * starts at 0, so there always is one.
+ */
+static uint16_t gcs_locate(uint32_t value, uint16_t *record) {
+  uint16_t lo = 0, hi = NUM_RECORDS, mid;
+  uint32_t base;
+
+  while (hi - lo > 1) {
+    mid = (lo + hi) >> 1;
+    base = ((uint32_t)gcs_base_hi[mid] << 16) | gcs_base_lo[mid];
+    if (base <= value)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  *record = lo;
+  return (uint16_t)(value - (((uint32_t)gcs_base_hi[lo] << 16) |
+                             gcs_base_lo[lo]));
+}
+
+/* Step to the next bit of a record; running off the end is a miss */
+#define GCS_NEXT_BIT()                                                         \
+  if (!(mask >>= 1)) {                                                         \
+    if (next == end)                                                           \
+      return false;                                                            \
+    byte = *next++;                                                            \
+    mask = 0x80;                                                               \
+  }
+
+/*
+ * Look a key up in one record of the set
+ *
+ * Returns: true if the record holds the key
+ *
+ * Each value is coded as its gap from the one before: gap >> GCS_RICE_BITS
+ * zero bits, a one, then the low GCS_RICE_BITS bits. Decoding stops at
+ * the first value not below the key. The zero padding after the last
+ * value never completes a code, so it ends the scan at the record's end.
+ */
+static bool gcs_contains(const uint8_t *record, uint16_t key) {
+  const uint8_t *next = record;
+  const uint8_t *end = record + RECORD_SIZE;
+  uint8_t byte = 0;
+  uint8_t mask = 1; /* The first step loads record[0] */
+  uint16_t value = 0;
+  uint16_t remainder;
+  uint8_t i;
+
+  for (;;) {
+    for (;;) {
+      GCS_NEXT_BIT();
+      if (byte & mask)
+        break;
+      value += 1 << GCS_RICE_BITS;
+    }
+    remainder = 0;
+    for (i = 0; i < GCS_RICE_BITS; i++) {
+      GCS_NEXT_BIT();
+      remainder = (remainder << 1) | ((byte & mask) != 0);
+    }
+    value += remainder;
+    if (value >= key)
+      return value == key;
+  }
+}
+#endif
+
+/* ========================================================================== */
+/* PROBES                                                                    */
+/* ========================================================================== */
+/* From a word to its sorted probes, and from a probe to its answer          */
+
+/*
+ * Convert one PETSCII letter to uppercase ASCII
+ *
+ * Returns: ASCII 'A'-'Z', or 0 if c is not a letter
+ *
+ * Handles three PETSCII character ranges:
+ * - PETSCII lowercase (0xC1-0xDA) -> ASCII uppercase (A-Z)
+ * - PETSCII uppercase (0x41-0x5A) -> ASCII uppercase (A-Z)
+ * - PETSCII shifted lowercase (0x61-0x7A) -> ASCII uppercase (A-Z)
+ */
+static char petscii_letter(unsigned char c) {
+  /* PETSCII lowercase letters (a-z) */
+  if (c >= PETSCII_LOWERCASE_START && c <= PETSCII_LOWERCASE_END) {
+    return c - PETSCII_TO_ASCII_OFFSET;
+  }
+  /* PETSCII uppercase letters (A-Z) - already ASCII */
+  if (c >= PETSCII_UPPERCASE_START && c <= PETSCII_UPPERCASE_END) {
+    return c;
+  }
+  /* PETSCII shifted lowercase (A-Z) */
+  if (c >= PETSCII_SHIFTED_START && c <= PETSCII_SHIFTED_END) {
+    return c - LOWERCASE_TO_UPPERCASE_OFFSET;
+  }
+  return 0;
+}
+
+#if BLOOM_REMAP
+/*
+ * Translate a logical record (chosen by the hashes) to its block in BLOOM.DAT
+ *
+ * The build stores hot records first so they share a few adjacent tracks.
+ * Every probe carries the physical record, so the cache, the preload list,
+ * the record map and the sort all work in disk order.
+ */
+static inline uint16_t remap_record(uint16_t record) {
+  uint8_t high = record_remap_hi[record / REMAP_PER_BYTE] >>
+                 ((record % REMAP_PER_BYTE) * BLOOM_REMAP_HIGH_BITS);
+
+  return record_remap_lo[record] | ((uint16_t)(high & REMAP_HIGH_MASK) << 8);
+}
+#endif
+
+/*
+ * Generated by kernel_generator.py: computes a word's probes with direct
+ * hash calls and the configured range reduction, fully unrolled
+ */
+#include "bloom_kernel.h"
+
+#if COMMON_WORD_COUNT > 0
+/*
+ * Look a word up in the RAM table of common dictionary words
+ *
+ * The table holds 24-bit fingerprints (fp, from common_word_hash()):
+ * the top byte selects a bucket in common_word_index and the next 16
+ * bits are binary searched within it. A hit needs no disk access.
+ */
+static bool common_word_lookup(uint32_t fp) {
+  uint8_t bucket = fp >> 24;
+  uint16_t key = (uint16_t)(fp >> 8);
+  uint16_t lo = common_word_index[bucket];
+  uint16_t end = common_word_index[bucket + 1];
+  uint16_t hi = end;
+  uint16_t mid;
+
+  while (lo < hi) {
+    mid = (lo + hi) >> 1;
+    if (common_word_keys[mid] < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo < end && common_word_keys[lo] == key;
+}
+
+/*
+ * The hash a word's common-word fingerprint is the top of: Jenkins
+ * one-at-a-time with seed 0, or under Pearson hashing the kernel's
+ * first hash, so the C64 runs no Jenkins fold for the table
+ */
+static inline uint32_t common_word_hash(const char *word) {
+#if BLOOM_HASH_SCHEME == BLOOM_HASH_PEARSON
+  return hash_pearson(word, 0);
+#else
+  return hash_jenkins(word, 0);
+#endif
+}
+#endif
+
+/*
+ * Sort a word's probes by record
+ *
+ * Sorting by record minimizes disk seeks: probes are then tested in
+ * left-to-right disk order. Insertion sort; the list is short, and
+ * equal records keep their hash order.
+ */
+static void bloom_sort_probes(bloom_probe_t *probes) {
+  uint8_t i, j;
+  bloom_probe_t temp;
+
+  for (i = 1; i < NUM_BIT_PROBES; i++) {
+    temp = probes[i];
+    for (j = i; j > 0 && probes[j - 1].record > temp.record; j--) {
+      probes[j] = probes[j - 1];
+    }
+    probes[j] = temp;
+  }
+}
+
+#if BLOOM_LAYOUT == BLOOM_LAYOUT_FUSE
+/*
+ * A binary fuse filter probe's share of its word's lookup
+ *
+ * Returns: the probe's byte XOR its fingerprint share. A word is in the
+ * set if the shares of its NUM_BIT_PROBES probes XOR to zero.
+ */
+static inline uint8_t bloom_record_share(const uint8_t *record,
+                                         const bloom_probe_t *probe) {
+  return record[probe->byte] ^ probe->mask;
+}
+#else
+/*
+ * Test a probe against its record's RECORD_SIZE bytes
+ *
+ * Returns: true if the bit is set, or the Golomb-coded set holds the key
+ */
+static inline bool bloom_record_hit(const uint8_t *record,
+                                    const bloom_probe_t *probe) {
+#if BLOOM_LAYOUT == BLOOM_LAYOUT_GCS
+  return gcs_contains(record, probe->key);
+#else
+  return (record[probe->byte] & probe->mask) != 0;
+#endif
+}
+#endif
+
+#endif /* BLOOM_CORE_H */
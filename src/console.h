@@ -0,0 +1,199 @@
+/*
+ * Console output and line input for the spell checker
+ *
+ * Copyright (c) 2025 John Byrd
+ * https://github.com/johnwbyrd/bloomer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * The default build maps these calls onto the C library. With
+ * BLOOM_MINIMAL_RUNTIME (the spellcheck_min target) they go straight to
+ * the KERNAL instead: BSOUT (CHROUT) for output, BASIN (CHRIN) for lines
+ * typed at the screen editor, and a formatter that knows only what the
+ * program prints: %c, %s, %u and %lu with a width, '-' and '0'. printf,
+ * the stdio layer and ctype then stay out of the PRG, and the RAM they
+ * took goes to the record cache.
+ */
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if BLOOM_MINIMAL_RUNTIME
+
+#include <cbm.h>
+#include <stdarg.h>
+#include <string.h>
+
+#define CONSOLE_RETURN 0x0D   /* PETSCII end of line */
+#define CONSOLE_DIGITS 10     /* Decimal digits of a 32-bit value */
+
+/* Powers of ten for printing numbers by subtraction: no divide routine */
+static const uint32_t console_powers[CONSOLE_DIGITS - 1] = {
+    1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL,
+    10000UL,      1000UL,      100UL,      10UL};
+
+/* console_sprintf's destination; NULL prints to the screen */
+static char *console_buffer;
+
+/*
+ * Print one character, turning '\n' into RETURN as the C library does
+ */
+static void console_putc(char c) {
+  cbm_k_bsout(c == '\n' ? CONSOLE_RETURN : c);
+}
+
+static void console_emit(char c) {
+  if (console_buffer)
+    *console_buffer++ = c;
+  else
+    console_putc(c);
+}
+
+static void console_pad(uint8_t count, char fill) {
+  while (count--)
+    console_emit(fill);
+}
+
+/*
+ * Write value in decimal to digits, most significant first, and return
+ * the number of digits
+ */
+static uint8_t console_decimal(uint32_t value, char *digits) {
+  uint8_t i, len = 0;
+  char digit;
+
+  for (i = 0; i < CONSOLE_DIGITS - 1; i++) {
+    digit = '0';
+    while (value >= console_powers[i]) {
+      value -= console_powers[i];
+      digit++;
+    }
+    if (len || digit != '0')
+      digits[len++] = digit;
+  }
+  digits[len++] = '0' + (uint8_t)value;
+  return len;
+}
+
+/*
+ * The printf conversions the spell checker uses: an optional '-' or '0',
+ * a width, an optional 'l', then c, s, u or %
+ */
+static void console_format(const char *fmt, va_list args) {
+  char digits[CONSOLE_DIGITS];
+  const char *text;
+  uint8_t width, len, i;
+  bool left;
+  char fill;
+
+  for (; *fmt; fmt++) {
+    if (*fmt != '%') {
+      console_emit(*fmt);
+      continue;
+    }
+    fmt++;
+    left = *fmt == '-';
+    if (left)
+      fmt++;
+    fill = ' ';
+    if (*fmt == '0') {
+      fill = '0';
+      fmt++;
+    }
+    width = 0;
+    while (*fmt >= '0' && *fmt <= '9')
+      width = width * 10 + (*fmt++ - '0');
+
+    text = digits;
+    switch (*fmt) {
+    case 'c':
+      digits[0] = (char)va_arg(args, int);
+      len = 1;
+      break;
+    case 's':
+      text = va_arg(args, const char *);
+      len = strlen(text);
+      break;
+    case 'l':
+      fmt++; /* %lu */
+      len = console_decimal(va_arg(args, unsigned long), digits);
+      break;
+    case 'u':
+      len = console_decimal(va_arg(args, unsigned int), digits);
+      break;
+    default: /* %% */
+      digits[0] = *fmt;
+      len = 1;
+      break;
+    }
+
+    if (!left && width > len)
+      console_pad(width - len, fill);
+    for (i = 0; i < len; i++)
+      console_emit(text[i]);
+    if (left && width > len)
+      console_pad(width - len, ' ');
+  }
+}
+
+static void console_printf(const char *fmt, ...) {
+  va_list args;
+
+  va_start(args, fmt);
+  console_format(fmt, args);
+  va_end(args);
+}
+
+static void console_sprintf(char *buf, const char *fmt, ...) {
+  va_list args;
+
+  console_buffer = buf;
+  va_start(args, fmt);
+  console_format(fmt, args);
+  va_end(args);
+  *console_buffer = '\0';
+  console_buffer = NULL;
+}
+
+/*
+ * Read a line typed at the screen editor into buf, like fgets on stdin.
+ * The KERNAL hands over the line one character per BASIN call up to
+ * RETURN; characters beyond size are dropped.
+ */
+static bool console_gets(char *buf, uint8_t size) {
+  uint8_t len = 0;
+  char c;
+
+  while ((c = cbm_k_basin()) != CONSOLE_RETURN) {
+    if (len < size - 2)
+      buf[len++] = c;
+  }
+  buf[len++] = '\n';
+  buf[len] = '\0';
+  return true;
+}
+
+static bool console_isspace(char c) {
+  return c == ' ' || (c >= '\t' && c <= CONSOLE_RETURN);
+}
+
+#else
+
+#include <ctype.h>
+#include <stdio.h>
+
+#define console_putc putchar
+#define console_printf printf
+#define console_sprintf sprintf
+#define console_isspace(c) isspace((unsigned char)(c))
+
+static bool console_gets(char *buf, uint8_t size) {
+  return fgets(buf, size, stdin) != NULL;
+}
+
+#endif /* BLOOM_MINIMAL_RUNTIME */
+
+#endif /* CONSOLE_H */
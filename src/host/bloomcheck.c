@@ -0,0 +1,521 @@
+/*
+ * Host-side Bloom filter checker
+ *
+ * Copyright (c) 2025 John Byrd
+ * https://github.com/johnwbyrd/bloomer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ *
+ * Checks text against bloom.dat with the C64's own lookup code: the same
+ * bloom_core.h, compiled against the generated headers of the same
+ * build. The filter is mapped into memory and the input is split across
+ * threads. Words are cut out and uppercased the way the C64's batch mode
+ * reads a SEQ file, and a word passes exactly when the C64 would pass it.
+ *
+ * Usage: bloomcheck [-d bloom.dat] [-j threads] [-a | -p] [file ...]
+ *        bloomcheck [-d bloom.dat] -v bloom_crosscheck.txt
+ *
+ * Prints "line: WORD" for every misspelled word of the input (stdin when
+ * no file is given); -a prints every word with 1 or 0, and -p prints
+ * every word, its probes and 1 or 0. -v checks the probes and answers
+ * build_bloom.py listed from the Python implementation, in -p format,
+ * and fails if any differ.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bloom_config.h"
+#include "bloom_core.h"
+
+/* ========================================================================== */
+/* CONFIGURATION AND CONSTANTS                                               */
+/* ========================================================================== */
+
+#define MAX_WORD_LEN 64            /* As on the C64: longer words are cut */
+#define BLOCK_SIZE (8UL << 20)     /* Input checked per round of threads */
+#define MAX_THREADS 64
+#define PROBE_TEXT_LEN 16          /* "record:byte:mask " */
+#define MAX_REPORTED_DIFFERENCES 20
+#define DEFAULT_FILTER "build/generated/bloom.dat"
+#define APOSTROPHE '\''
+#define CARRIAGE_RETURN '\r'
+#define LINEFEED '\n'
+
+/* What is printed for each word */
+enum output_mode { OUTPUT_MISSPELLED, OUTPUT_ALL, OUTPUT_PROBES };
+
+/* ========================================================================== */
+/* TYPE DEFINITIONS                                                          */
+/* ========================================================================== */
+
+/* Growable output text */
+typedef struct {
+  char *data;
+  size_t len;
+  size_t cap;
+} buffer_t;
+
+/* One thread's share of an input block */
+typedef struct {
+  const char *start;
+  const char *end;
+  unsigned long line; /* Line number at start */
+  buffer_t out;
+  unsigned long words;
+  unsigned long misspelled;
+} slice_t;
+
+/* ========================================================================== */
+/* GLOBAL VARIABLES                                                          */
+/* ========================================================================== */
+
+static const uint8_t *filter; /* bloom.dat, NUM_RECORDS records */
+static enum output_mode output_mode = OUTPUT_MISSPELLED;
+
+/* ========================================================================== */
+/* UTILITIES                                                                 */
+/* ========================================================================== */
+
+static void fail(const char *format, ...) {
+  va_list args;
+
+  va_start(args, format);
+  fputs("bloomcheck: ", stderr);
+  vfprintf(stderr, format, args);
+  fputc('\n', stderr);
+  va_end(args);
+  exit(2);
+}
+
+static void buffer_reserve(buffer_t *buffer, size_t extra) {
+  if (buffer->len + extra <= buffer->cap)
+    return;
+  buffer->cap = (buffer->len + extra) * 2;
+  buffer->data = realloc(buffer->data, buffer->cap);
+  if (!buffer->data)
+    fail("out of memory");
+}
+
+static void buffer_printf(buffer_t *buffer, const char *format, ...) {
+  va_list args;
+  int len;
+
+  va_start(args, format);
+  len = vsnprintf(NULL, 0, format, args);
+  va_end(args);
+  buffer_reserve(buffer, (size_t)len + 1);
+  va_start(args, format);
+  vsnprintf(buffer->data + buffer->len, (size_t)len + 1, format, args);
+  va_end(args);
+  buffer->len += (size_t)len;
+}
+
+static double seconds_now(void) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* ========================================================================== */
+/* LOOKUP                                                                    */
+/* ========================================================================== */
+
+/*
+ * Map bloom.dat read-only
+ *
+ * Its size must match the bloom_config.h this program was built with.
+ */
+static void map_filter(const char *path) {
+  struct stat info;
+  void *data;
+  int fd = open(path, O_RDONLY);
+
+  if (fd < 0 || fstat(fd, &info) < 0)
+    fail("cannot open %s", path);
+  if ((unsigned long)info.st_size != (unsigned long)NUM_RECORDS * RECORD_SIZE)
+    fail("%s has %ld bytes, but bloom_config.h expects %lu; rebuild "
+         "bloomcheck against the same build",
+         path, (long)info.st_size, (unsigned long)NUM_RECORDS * RECORD_SIZE);
+  data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED)
+    fail("cannot map %s", path);
+  close(fd);
+  filter = data;
+}
+
+/*
+ * Check a word as the C64 does
+ *
+ * Returns: true if the word passes; probes receives its sorted probes,
+ * which are computed even when the common-word table answers
+ */
+static bool check_word(const char *word, bloom_probe_t *probes) {
+  uint8_t i;
+#if BLOOM_LAYOUT == BLOOM_LAYOUT_FUSE
+  uint8_t shares = 0;
+#endif
+
+  bloom_kernel_probes(word, probes);
+  bloom_sort_probes(probes);
+#if COMMON_WORD_COUNT > 0
+  if (common_word_lookup(common_word_hash(word)))
+    return true;
+#endif
+#if BLOOM_LAYOUT == BLOOM_LAYOUT_FUSE
+  for (i = 0; i < NUM_BIT_PROBES; i++) {
+    shares ^= bloom_record_share(
+        filter + (size_t)probes[i].record * RECORD_SIZE, &probes[i]);
+  }
+  return shares == 0;
+#else
+  for (i = 0; i < NUM_BIT_PROBES; i++) {
+    if (!bloom_record_hit(filter + (size_t)probes[i].record * RECORD_SIZE,
+                          &probes[i]))
+      return false;
+  }
+  return true;
+#endif
+}
+
+/*
+ * Print a word's probes in the order the C64 tests them
+ *
+ * Bit probes are record:byte:mask, Golomb-coded set probes record:key;
+ * a binary fuse filter probe's mask is its fingerprint share.
+ */
+static void format_probes(buffer_t *out, const bloom_probe_t *probes) {
+  uint8_t i;
+
+  for (i = 0; i < NUM_BIT_PROBES; i++) {
+#if BLOOM_LAYOUT == BLOOM_LAYOUT_GCS
+    buffer_printf(out, i ? " %u:%u" : "%u:%u", probes[i].record,
+                  probes[i].key);
+#else
+    buffer_printf(out, i ? " %u:%u:%u" : "%u:%u:%u", probes[i].record,
+                  probes[i].byte, probes[i].mask);
+#endif
+  }
+}
+
+/* Check one word of the input and print what the output mode asks for */
+static void report_word(slice_t *slice, const char *word) {
+  bloom_probe_t probes[NUM_BIT_PROBES];
+  bool found = check_word(word, probes);
+
+  slice->words++;
+  if (!found)
+    slice->misspelled++;
+
+  switch (output_mode) {
+  case OUTPUT_MISSPELLED:
+    if (!found)
+      buffer_printf(&slice->out, "%lu: %s\n", slice->line, word);
+    break;
+  case OUTPUT_ALL:
+    buffer_printf(&slice->out, "%s\t%d\n", word, found);
+    break;
+  case OUTPUT_PROBES:
+    buffer_printf(&slice->out, "%s\t", word);
+    format_probes(&slice->out, probes);
+    buffer_printf(&slice->out, "\t%d\n", found);
+    break;
+  }
+}
+
+/* ========================================================================== */
+/* TEXT INPUT                                                                */
+/* ========================================================================== */
+
+/*
+ * True if a slice may start right after c
+ *
+ * Words are letters and inner apostrophes, and CR LF counts as one line
+ * ending, so neither may be split.
+ */
+static bool is_cut_point(char c) {
+  return !petscii_letter((unsigned char)c) && c != APOSTROPHE &&
+         c != CARRIAGE_RETURN;
+}
+
+/*
+ * Find where to end a slice at or before end, preferring a line ending
+ *
+ * Returns: start if there is no place to cut
+ */
+static const char *find_cut(const char *start, const char *end) {
+  const char *p;
+
+  for (p = end; p > start; p--) {
+    if (p[-1] == LINEFEED)
+      return p;
+  }
+  for (p = end; p > start; p--) {
+    if (is_cut_point(p[-1]))
+      return p;
+  }
+  return start;
+}
+
+/* Count line endings as the C64 does: CR, or LF not after a CR */
+static unsigned long count_lines(const char *start, const char *end) {
+  unsigned long lines = 0;
+  bool was_return = false;
+
+  for (; start < end; start++) {
+    if (*start == CARRIAGE_RETURN || (*start == LINEFEED && !was_return))
+      lines++;
+    was_return = (*start == CARRIAGE_RETURN);
+  }
+  return lines;
+}
+
+/*
+ * Check every word of a slice
+ *
+ * Mirrors batch_check_file(): letters and inner apostrophes make a word,
+ * closing quotes are dropped, and words are cut at MAX_WORD_LEN - 1.
+ */
+static void *check_slice(void *arg) {
+  slice_t *slice = arg;
+  char token[MAX_WORD_LEN];
+  uint8_t len = 0;
+  char letter;
+  bool was_return = false;
+  const char *p;
+
+  for (p = slice->start; p <= slice->end; p++) {
+    char c = p < slice->end ? *p : LINEFEED;
+
+    letter = petscii_letter((unsigned char)c);
+    if (letter || (c == APOSTROPHE && len > 0)) {
+      if (len < MAX_WORD_LEN - 1)
+        token[len++] = letter ? letter : c;
+    } else if (len) {
+      while (token[len - 1] == APOSTROPHE)
+        len--;
+      token[len] = '\0';
+      len = 0;
+      report_word(slice, token);
+    }
+    if (p == slice->end)
+      break;
+    if (c == CARRIAGE_RETURN || (c == LINEFEED && !was_return))
+      slice->line++;
+    was_return = (c == CARRIAGE_RETURN);
+  }
+  return NULL;
+}
+
+/*
+ * Check one block of input on up to threads threads
+ *
+ * Returns: the line number after the block
+ */
+static unsigned long check_block(const char *start, const char *end,
+                                 unsigned long line, int threads,
+                                 unsigned long *words,
+                                 unsigned long *misspelled) {
+  slice_t slices[MAX_THREADS];
+  pthread_t ids[MAX_THREADS];
+  const char *cut = start;
+  size_t share = (size_t)(end - start) / threads + 1;
+  int count = 0, i;
+
+  while (cut < end) {
+    const char *next = end;
+
+    if ((size_t)(end - cut) > share && count < threads - 1) {
+      next = find_cut(cut, cut + share);
+      if (next == cut)
+        next = end;
+    }
+    memset(&slices[count], 0, sizeof(slices[count]));
+    slices[count].start = cut;
+    slices[count].end = next;
+    slices[count].line = line;
+    line += count_lines(cut, next);
+    cut = next;
+    count++;
+  }
+
+  for (i = 1; i < count; i++) {
+    if (pthread_create(&ids[i], NULL, check_slice, &slices[i]))
+      fail("cannot start a thread");
+  }
+  if (count)
+    check_slice(&slices[0]);
+  for (i = 0; i < count; i++) {
+    if (i)
+      pthread_join(ids[i], NULL);
+    fwrite(slices[i].out.data, 1, slices[i].out.len, stdout);
+    free(slices[i].out.data);
+    *words += slices[i].words;
+    *misspelled += slices[i].misspelled;
+  }
+  return line;
+}
+
+/*
+ * Check a whole stream, one block at a time
+ *
+ * A block ends at its last line ending; the rest is carried over, so no
+ * word is split between blocks.
+ */
+static void check_stream(FILE *in, int threads, unsigned long *words,
+                         unsigned long *misspelled) {
+  char *block = malloc(BLOCK_SIZE);
+  size_t used = 0, got;
+  unsigned long line = 1;
+  const char *cut;
+
+  if (!block)
+    fail("out of memory");
+  for (;;) {
+    got = fread(block + used, 1, BLOCK_SIZE - used, in);
+    used += got;
+    if (!got) {
+      check_block(block, block + used, line, threads, words, misspelled);
+      break;
+    }
+    if (used < BLOCK_SIZE)
+      continue;
+    cut = find_cut(block, block + used);
+    if (cut == block)
+      cut = block + used; /* One enormous word; it is cut anyway */
+    line = check_block(block, cut, line, threads, words, misspelled);
+    used -= (size_t)(cut - block);
+    memmove(block, cut, used);
+  }
+  free(block);
+}
+
+/* ========================================================================== */
+/* CROSS-CHECK                                                               */
+/* ========================================================================== */
+
+/*
+ * Compare the lookup code against a list of expected results
+ *
+ * Each line is a word, its probes and its answer, as printed by -p.
+ *
+ * Returns: number of words whose probes or answer differ
+ */
+static unsigned long verify(const char *path, unsigned long *checked) {
+  FILE *in = fopen(path, "r");
+  char *line = NULL;
+  size_t cap = 0;
+  ssize_t len;
+  unsigned long differ = 0;
+  slice_t slice;
+  char *tab;
+
+  if (!in)
+    fail("cannot open %s", path);
+  memset(&slice, 0, sizeof(slice));
+  while ((len = getline(&line, &cap, in)) > 0) {
+    tab = strchr(line, '\t');
+    if (!tab)
+      continue;
+    *tab = '\0';
+    slice.out.len = 0;
+    report_word(&slice, line);
+    *tab = '\t';
+    if ((size_t)len != slice.out.len ||
+        memcmp(line, slice.out.data, slice.out.len) != 0) {
+      if (++differ <= MAX_REPORTED_DIFFERENCES)
+        printf("expected %.*sbut got  %.*s", (int)len, line,
+               (int)slice.out.len, slice.out.data);
+    }
+  }
+  *checked = slice.words;
+  free(line);
+  free(slice.out.data);
+  fclose(in);
+  return differ;
+}
+
+/* ========================================================================== */
+/* MAIN PROGRAM                                                              */
+/* ========================================================================== */
+
+static void usage(void) {
+  fputs("usage: bloomcheck [-d bloom.dat] [-j threads] [-a | -p] [file ...]\n"
+        "       bloomcheck [-d bloom.dat] -v bloom_crosscheck.txt\n",
+        stderr);
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  const char *filter_path = DEFAULT_FILTER;
+  const char *verify_path = NULL;
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned long words = 0, misspelled = 0, differ;
+  double start;
+  FILE *in;
+  int opt, i;
+
+  while ((opt = getopt(argc, argv, "ad:j:pv:")) != -1) {
+    switch (opt) {
+    case 'a':
+      output_mode = OUTPUT_ALL;
+      break;
+    case 'd':
+      filter_path = optarg;
+      break;
+    case 'j':
+      threads = atol(optarg);
+      break;
+    case 'p':
+      output_mode = OUTPUT_PROBES;
+      break;
+    case 'v':
+      verify_path = optarg;
+      break;
+    default:
+      usage();
+    }
+  }
+  if (threads < 1)
+    threads = 1;
+  if (threads > MAX_THREADS)
+    threads = MAX_THREADS;
+
+  map_filter(filter_path);
+
+  if (verify_path) {
+    output_mode = OUTPUT_PROBES;
+    differ = verify(verify_path, &words);
+    fprintf(stderr, "%lu words cross-checked, %lu differ\n", words, differ);
+    return differ || !words;
+  }
+
+  start = seconds_now();
+  if (optind == argc) {
+    check_stream(stdin, (int)threads, &words, &misspelled);
+  }
+  for (i = optind; i < argc; i++) {
+    in = fopen(argv[i], "rb");
+    if (!in)
+      fail("cannot open %s", argv[i]);
+    check_stream(in, (int)threads, &words, &misspelled);
+    fclose(in);
+  }
+  fflush(stdout);
+  fprintf(stderr, "%lu words, %lu misspelled, %.2f s on %ld threads\n", words,
+          misspelled, seconds_now() - start, threads);
+  return 0;
+}
@@ -0,0 +1,97 @@
+"""
+Fixed word list for the lookup benchmark PRG.
+
+Copyright (c) 2025 John Byrd
+https://github.com/johnwbyrd/bloomer
+
+SPDX-License-Identifier: BSD-3-Clause
+"""
+import random
+import string
+import textwrap
+from pathlib import Path
+from typing import List, Sequence, Tuple
+from bloom_config import FIRST_DISK_DEVICE, LAST_DISK_DEVICE
+from cross_check import CrossCheck
+
+MISSPELLED_SHARE = 0.25  # Words given one wrong letter, as typos
+
+
+def bench_device(devices: Sequence[int]) -> int:
+    """The drive that holds SPELLBENCH and takes BENCH: the first free one.
+
+    The filter disks are left as the build made them, and are full.
+    """
+    return next(device for device in range(FIRST_DISK_DEVICE,
+                                            LAST_DISK_DEVICE + 1)
+                if device not in devices)
+
+
+class BenchWordList:
+    """Words that spellcheck_bench runs through check_word(), with answers.
+
+    The list is drawn with a fixed seed from the word list and the
+    frequency proxy alone, so it stays the same while the layout, cache
+    or hashing change and only the lookups' cost moves. Words are drawn by
+    frequency, repeats included, as in running text; a quarter have one
+    letter changed and are mostly misspelled. The answers are the ones
+    the C64 should give, so the benchmark reports any that differ.
+    """
+
+    def __init__(self, words: List[str], cross_check: CrossCheck):
+        self.words = words
+        self.cross_check = cross_check
+
+    def select(self, weighted_words: Sequence[Tuple[str, float]], count: int,
+               seed: int = 1) -> List[str]:
+        """Draw count words: by weight, or uniformly without a proxy."""
+        rng = random.Random(seed)
+        misspelled = int(count * MISSPELLED_SHARE)
+        if weighted_words:
+            chosen = rng.choices([word for word, _ in weighted_words],
+                                 [weight for _, weight in weighted_words],
+                                 k=count - misspelled)
+        else:
+            chosen = rng.sample(self.words, min(len(self.words),
+                                                count - misspelled))
+        for word in rng.sample(self.words, misspelled):
+            position = rng.randrange(len(word))
+            letter = rng.choice(string.ascii_uppercase.replace(word[position],
+                                                               ''))
+            chosen.append(word[:position] + letter + word[position + 1:])
+        rng.shuffle(chosen)
+        return chosen
+
+    def write_header(self, path: Path, words: List[str], device: int):
+        """Write bloom_bench.h: the words NUL-separated, their answers, and
+        the device that takes the results."""
+        text = '\n'.join(f'    "{word}\\0"' for word in words)
+        expected = textwrap.fill(', '.join(
+            str(int(self.cross_check.expected(word))) for word in words),
+            width=79, initial_indent='    ', subsequent_indent='    ')
+        with open(path, 'w') as f:
+            f.write(f"""/*
+ * Lookup benchmark word list
+ * Generated by build_bloom.py; included by spellcheck_bench (BLOOM_BENCH)
+ */
+
+#ifndef BLOOM_BENCH_H
+#define BLOOM_BENCH_H
+
+#include <stdint.h>
+
+#define BENCH_WORDS {len(words)}
+#define BENCH_DEVICE {device} /* Holds SPELLBENCH and takes BENCH */
+
+/* The words in the order they are checked, each ending in NUL */
+static const char bench_text[] =
+{text};
+
+/* 1 if the word should pass */
+static const uint8_t bench_expected[BENCH_WORDS] = {{
+{expected}}};
+
+#endif /* BLOOM_BENCH_H */
+""")
+        print(f"Benchmark word list written to {path} ({len(words)} words, "
+              f"{len(set(words))} distinct)")
@@ -8,7 +8,60 @@ SPDX-License-Identifier: BSD-3-Clause
 """
 import math
 from dataclasses import dataclass
+from typing import List, Optional, Tuple
 from disk_geometry import DiskGeometry
+from fuse_filter import FINGERPRINT_BITS as FUSE_FINGERPRINT_BITS
+from golomb_set import MAX_HASH_BITS, MIN_HASH_BITS
+from hash_functions import ALL_HASH_FUNCTIONS, hash_jenkins
+
+# Filter layouts. 'classic' spreads every probe over the whole bit array;
+# 'blocked' uses the first hash to pick one REL record and the remaining
+# hashes to pick bits inside it, so a lookup costs exactly one seek.
+# 'gcs' stores one hash per word as a Golomb-coded set instead of bits:
+# smaller on disk and in RAM, also one record per lookup, but each probe
+# decodes the record up to the value it wants. 'fuse' is a binary fuse
+# filter of 8-bit fingerprints: three bytes per word, in three consecutive
+# records, whose XOR is the word's fingerprint.
+LAYOUT_CLASSIC = 'classic'
+LAYOUT_BLOCKED = 'blocked'
+LAYOUT_GCS = 'gcs'
+LAYOUT_FUSE = 'fuse'
+LAYOUTS = (LAYOUT_CLASSIC, LAYOUT_BLOCKED, LAYOUT_GCS, LAYOUT_FUSE)
+
+# A binary fuse filter remixes each word's first hash into four values:
+# one picks the segment (and leaves the fingerprint over), three pick a
+# byte in each of its records. A segment is FUSE_ARITY consecutive records.
+FUSE_HASH_VALUES = 4
+FUSE_ARITY = 3
+
+# Hash schemes. 'independent' runs a separate string hash per probe;
+# 'double' makes one pass producing h1 and h2 and derives g_i = h1 + i*h2.
+# 'pearson' double hashes too, from two Pearson hashes: byte-wide table
+# lookups, with no 32-bit shift, add or multiply per character.
+HASH_INDEPENDENT = 'independent'
+HASH_DOUBLE = 'double'
+HASH_PEARSON = 'pearson'
+HASH_SCHEMES = (HASH_INDEPENDENT, HASH_DOUBLE, HASH_PEARSON)
+DOUBLE_HASHED = (HASH_DOUBLE, HASH_PEARSON)  # Schemes deriving g_i from h1, h2
+
+# Range reduction maps a 32-bit hash onto [0, n). 'modulo' is h % n;
+# 'multiply_shift' is (h * n) >> 32, which needs no division on the 6502.
+RANGE_MODULO = 'modulo'
+RANGE_MULTIPLY_SHIFT = 'multiply_shift'
+RANGE_REDUCTIONS = (RANGE_MODULO, RANGE_MULTIPLY_SHIFT)
+
+# Drives the filter can be striped across. Record r lives on drive
+# r % len(devices), as that drive's record r // len(devices), so records
+# that sort together alternate between the drives.
+MAX_DEVICES = 4
+FIRST_DISK_DEVICE = 8
+LAST_DISK_DEVICE = 30
+
+
+def stripe_records(data: bytes, record_size: int, stripes: int) -> List[bytes]:
+    """Split data into stripes, dealing records out to each in turn."""
+    records = [data[i:i + record_size] for i in range(0, len(data), record_size)]
+    return [b''.join(records[index::stripes]) for index in range(stripes)]
 
 
 @dataclass
@@ -17,21 +70,179 @@ class BloomConfig:
 
     geometry: DiskGeometry
     num_hash_functions: int = 5
+    layout: str = LAYOUT_CLASSIC
+    hash_scheme: str = HASH_INDEPENDENT
+    range_reduction: str = RANGE_MODULO
+    devices: Tuple[int, ...] = (FIRST_DISK_DEVICE,)  # One filter stripe per drive
+    gcs_hash_bits: int = 24     # Bits kept of each word's hash (gcs layout)
+    records: Optional[int] = None  # REL records; None = fill the drives
+    fuse_seed: int = 0          # Remix of the first hash a fuse build settled on
+
+    def __post_init__(self):
+        if self.layout not in LAYOUTS:
+            raise ValueError(f"Unknown Bloom filter layout: {self.layout}")
+        if self.hash_scheme not in HASH_SCHEMES:
+            raise ValueError(f"Unknown hash scheme: {self.hash_scheme}")
+        if self.range_reduction not in RANGE_REDUCTIONS:
+            raise ValueError(f"Unknown range reduction: {self.range_reduction}")
+        if (self.hash_scheme == HASH_INDEPENDENT and
+                self.num_hash_functions > len(ALL_HASH_FUNCTIONS)):
+            raise ValueError(f"Independent hashing supports at most "
+                             f"{len(ALL_HASH_FUNCTIONS)} hash functions")
+        if self.layout == LAYOUT_BLOCKED and self.num_hash_functions < 2:
+            raise ValueError("Blocked layout needs at least 2 hash functions")
+        if not MIN_HASH_BITS <= self.gcs_hash_bits <= MAX_HASH_BITS:
+            raise ValueError(f"gcs_hash_bits must be between {MIN_HASH_BITS} "
+                             f"and {MAX_HASH_BITS}")
+        self.devices = tuple(self.devices)
+        if not 1 <= len(self.devices) <= MAX_DEVICES:
+            raise ValueError(f"The filter needs 1 to {MAX_DEVICES} devices")
+        if len(set(self.devices)) != len(self.devices):
+            raise ValueError("Devices must be distinct")
+        if not all(FIRST_DISK_DEVICE <= d <= LAST_DISK_DEVICE
+                   for d in self.devices):
+            raise ValueError(f"Disk devices are numbered "
+                             f"{FIRST_DISK_DEVICE}-{LAST_DISK_DEVICE}")
 
     @property
     def size_bytes(self) -> int:
         """Bloom filter size in bytes."""
-        return self.geometry.bloom_size_bytes
+        return self.num_records * self.geometry.rel_record_size
 
     @property
     def size_bits(self) -> int:
         """Bloom filter size in bits."""
-        return self.geometry.bloom_size_bits
+        return self.size_bytes * 8
+
+    @property
+    def num_devices(self) -> int:
+        """Number of drives the filter is striped across."""
+        return len(self.devices)
+
+    @property
+    def is_striped(self) -> bool:
+        """True if the filter is split across several drives."""
+        return self.num_devices > 1
 
     @property
     def num_records(self) -> int:
-        """Number of REL records."""
-        return self.geometry.bloom_records
+        """Number of REL records, over all drives.
+
+        A Golomb-coded set or binary fuse filter is built first and then
+        sized to fit, so it can leave much of the disk free.
+        """
+        if self.records is not None:
+            return self.records
+        return self.geometry.bloom_records * self.num_devices
+
+    @property
+    def record_bits(self) -> int:
+        """Number of bits in one REL record."""
+        return self.geometry.rel_record_size * 8
+
+    @property
+    def is_blocked(self) -> bool:
+        """True if all probes for a word land in a single record."""
+        return self.layout == LAYOUT_BLOCKED
+
+    @property
+    def is_gcs(self) -> bool:
+        """True if the records hold a Golomb-coded set rather than bits."""
+        return self.layout == LAYOUT_GCS
+
+    @property
+    def is_fuse(self) -> bool:
+        """True if the records hold binary fuse filter fingerprints."""
+        return self.layout == LAYOUT_FUSE
+
+    @property
+    def fuse_segments(self) -> int:
+        """Records a binary fuse filter word's segment can start at.
+
+        Every record but the last FUSE_ARITY - 1.
+        """
+        return self.num_records - (FUSE_ARITY - 1)
+
+    @property
+    def format_name(self) -> str:
+        """What the records hold, for reports."""
+        if self.is_gcs:
+            return 'Golomb-coded set'
+        if self.is_fuse:
+            return 'binary fuse filter'
+        return f'Bloom filter ({self.layout})'
+
+    @property
+    def probes_per_word(self) -> int:
+        """Number of bits tested per word (blocked spends one hash on the record).
+
+        A Golomb-coded set tests one value per word, and a binary fuse
+        filter reads one byte in each of FUSE_ARITY records.
+        """
+        if self.is_gcs:
+            return 1
+        if self.is_fuse:
+            return FUSE_ARITY
+        if self.is_blocked:
+            return self.num_hash_functions - 1
+        return self.num_hash_functions
+
+    @property
+    def running_hashes(self) -> int:
+        """Hash states the C64 advances per character of a word.
+
+        A state is one 32-bit value, or four byte lanes under Pearson
+        hashing; either way it finishes into one 32-bit hash.
+        """
+        if self.is_gcs or self.is_fuse:
+            return 1
+        if self.hash_scheme in DOUBLE_HASHED:
+            return 2
+        return self.num_hash_functions
+
+    def reduce(self, hash_val: int, n: int) -> int:
+        """Map a 32-bit hash value onto [0, n) with the configured reduction."""
+        if self.range_reduction == RANGE_MULTIPLY_SHIFT:
+            return (hash_val * n) >> 32
+        return hash_val % n
+
+    def fuse_value_index(self, value: int) -> int:
+        """The fuse_mix() index of binary fuse filter hash value number value."""
+        return self.fuse_seed * FUSE_HASH_VALUES + value
+
+    def avalanches(self, index: int) -> bool:
+        """True if independent hash index gets jenkins_final() before use.
+
+        Multiply-shift reduction reads only the top bits of a hash, and
+        those of DJB2 and SDBM barely change with the last letters of a
+        short word; the Jenkins avalanche mixes them in. The Jenkins hash
+        ends in it already, and double and Pearson hashing finish their
+        own values.
+        """
+        return (self.hash_scheme == HASH_INDEPENDENT and
+                self.range_reduction == RANGE_MULTIPLY_SHIFT and
+                ALL_HASH_FUNCTIONS[index] is not hash_jenkins)
+
+    def reduce_rest(self, hash_val: int, n: int) -> int:
+        """The low 32 bits of h * n that multiply-shift reduce() drops.
+
+        A blocked filter adds them to the hashes that pick bits in the
+        record, whose top bits would otherwise follow the record's own
+        choice under double hashing. Modulo leaves nothing to add: 0.
+        """
+        if self.range_reduction == RANGE_MULTIPLY_SHIFT:
+            return hash_val * n & 0xFFFFFFFF
+        return 0
+
+    def reduce_leftover(self, hash_val: int, n: int) -> int:
+        """The FUSE_FINGERPRINT_BITS of hash_val that reduce() leaves unused.
+
+        Multiply-shift keeps the top of the low 32 bits of h * n; modulo
+        the low bits of the quotient h / n.
+        """
+        if self.range_reduction == RANGE_MULTIPLY_SHIFT:
+            return (hash_val * n & 0xFFFFFFFF) >> (32 - FUSE_FINGERPRINT_BITS)
+        return hash_val // n & ((1 << FUSE_FINGERPRINT_BITS) - 1)
 
     def optimal_k(self, expected_words: int) -> float:
         """Calculate optimal number of hash functions for given word count."""
@@ -40,9 +251,36 @@ class BloomConfig:
     def print_summary(self, expected_words: int = 124000):
         """Print configuration summary."""
         self.geometry.print_summary()
-        optimal = self.optimal_k(expected_words)
-        print(f"Hash functions: {self.num_hash_functions}")
-        print(f"Optimal k for ~{expected_words:,} words: (m/n) × ln(2) = {optimal:.2f}")
-        print(f"Using k={self.num_hash_functions} (fewer disk reads per lookup)")
+        if self.is_gcs:
+            print(f"Hash scheme: {self.hash_scheme} (first hash only)")
+            print(f"Layout: {self.layout} (one {self.gcs_hash_bits}-bit hash "
+                  f"per word, Golomb-coded)")
+        elif self.is_fuse:
+            print(f"Hash scheme: {self.hash_scheme} (first hash only, "
+                  f"remixed into {FUSE_HASH_VALUES} values)")
+            print(f"Range reduction: {self.range_reduction}")
+            print(f"Layout: {self.layout} ({FUSE_FINGERPRINT_BITS}-bit "
+                  f"fingerprints, {FUSE_ARITY} byte probes per word in "
+                  f"consecutive records)")
+        else:
+            optimal = self.optimal_k(expected_words)
+            print(f"Hash functions: {self.num_hash_functions}")
+            print(f"Optimal k for ~{expected_words:,} words: "
+                  f"(m/n) × ln(2) = {optimal:.2f}")
+            print(f"Using k={self.num_hash_functions} "
+                  f"(fewer disk reads per lookup)")
+            print(f"Hash scheme: {self.hash_scheme}")
+            print(f"Range reduction: {self.range_reduction}")
+            print(f"Layout: {self.layout} "
+                  f"({self.probes_per_word} bit probes per word)")
+        if self.is_striped:
+            devices = ', '.join(str(device) for device in self.devices)
+            print(f"Striped across devices {devices}: "
+                  f"{self.num_records // self.num_devices} records each, "
+                  f"{self.num_records} in all ({self.size_bytes / 1024:.2f} KB)")
+        if self.is_blocked:
+            print(f"  Hash 0 selects one of {self.num_records} records, "
+                  f"hashes 1-{self.num_hash_functions - 1} select bits "
+                  f"within its {self.record_bits} bits")
         print("=" * 80)
         print()
@@ -6,30 +6,181 @@ https://github.com/johnwbyrd/bloomer
 
 SPDX-License-Identifier: BSD-3-Clause
 """
-from typing import List
-from bloom_config import BloomConfig
-from hash_functions import ALL_HASH_FUNCTIONS
+import dataclasses
+from array import array
+from typing import List, Optional, Set, Tuple
+from bloom_config import (BloomConfig, DOUBLE_HASHED, FUSE_ARITY,
+                          FUSE_HASH_VALUES, HASH_PEARSON)
+from fuse_filter import BinaryFuseFilter
+from golomb_set import GolombCodedSet
+from hash_functions import (ALL_HASH_FUNCTIONS, double_hash_values, fuse_mix,
+                            hash_pair, jenkins_final, pearson_pair)
+from word_hashes import (WordHashes, fuse_keys, set_bits, test_bits,
+                         test_shares, vectorized)
 
 
 class BloomFilter:
-    """Bloom filter for efficient set membership testing."""
+    """Bloom filter for efficient set membership testing.
+
+    With the gcs layout the records hold a Golomb-coded set of one hash
+    per word instead; every probe is then (record, key, 0), and the
+    config is replaced by one with the record count the set needs.
+    A binary fuse filter keeps every word's first hash until it is
+    built, and is resized the same way; its probes are (record, byte,
+    fingerprint share), and a word passes if the bytes XOR to zero.
+    """
 
     def __init__(self, config: BloomConfig):
         self.config = config
         self.data = bytearray(config.size_bytes)
         self._hash_functions = ALL_HASH_FUNCTIONS[:config.num_hash_functions]
+        self._gcs_values: Set[int] = set()
+        self.gcs: Optional[GolombCodedSet] = None
+        self._fuse_hashes = array('I')
+        self.fuse: Optional[BinaryFuseFilter] = None
+
+    def _hash_values(self, word: str) -> List[int]:
+        """Calculate the 32-bit hash values for a word, one per hash function."""
+        if self.config.hash_scheme in DOUBLE_HASHED:
+            pair = (pearson_pair if self.config.hash_scheme == HASH_PEARSON
+                    else hash_pair)
+            return double_hash_values(word, self.config.num_hash_functions,
+                                      pair)
+        values = [hash_func(word, seed=i)
+                  for i, hash_func in enumerate(self._hash_functions)]
+        return [jenkins_final(value) if self.config.avalanches(i) else value
+                for i, value in enumerate(values)]
 
     def _get_bit_positions(self, word: str) -> List[int]:
         """Calculate bit positions for a word using all hash functions."""
-        positions = []
-        for i, hash_func in enumerate(self._hash_functions):
-            hash_val = hash_func(word, seed=i)
-            bit_pos = hash_val % self.config.size_bits
-            positions.append(bit_pos)
-        return positions
+        hash_values = self._hash_values(word)
+        if self.config.is_blocked:
+            return self._get_blocked_bit_positions(hash_values)
+        return [self.config.reduce(hash_val, self.config.size_bits)
+                for hash_val in hash_values]
+
+    def _get_blocked_bit_positions(self, hash_values: List[int]) -> List[int]:
+        """Calculate bit positions confined to one record (blocked layout).
+
+        Hash 0 selects the record; every other hash selects a bit inside it,
+        with what the record's reduction left over added in.
+        """
+        config = self.config
+        record_bits = config.record_bits
+        record = config.reduce(hash_values[0], config.num_records)
+        rest = config.reduce_rest(hash_values[0], config.num_records)
+        base = record * record_bits
+        return [base + config.reduce((hash_val + rest) & 0xFFFFFFFF,
+                                     record_bits)
+                for hash_val in hash_values[1:]]
+
+    def _fuse_slots(self, first: int) -> Tuple[List[int], int]:
+        """A word's binary fuse filter slots and fingerprint (fuse layout).
+
+        The first hash is remixed into FUSE_HASH_VALUES values. Value 0
+        selects the segment, and what its reduction leaves over is the
+        fingerprint; every other value selects a byte in one of the
+        segment's records.
+        """
+        config = self.config
+        size = config.geometry.rel_record_size
+        hash_values = [fuse_mix(first, config.fuse_value_index(i))
+                       for i in range(FUSE_HASH_VALUES)]
+        segment = config.reduce(hash_values[0], config.fuse_segments)
+        slots = [(segment + i) * size + config.reduce(hash_val, size)
+                 for i, hash_val in enumerate(hash_values[1:])]
+        return slots, config.reduce_leftover(hash_values[0],
+                                             config.fuse_segments)
+
+    def record_fill_rates(self) -> List[float]:
+        """Calculate the proportion of bits set in each REL record."""
+        record_size = self.config.geometry.rel_record_size
+        record_bits = self.config.record_bits
+        return [_popcount(self.data[i:i + record_size]) / record_bits
+                for i in range(0, len(self.data), record_size)]
+
+    def _gcs_value(self, word: str) -> int:
+        """The word's hash value, as stored in the Golomb-coded set."""
+        return self._hash_values(word)[0] >> (32 - self.config.gcs_hash_bits)
+
+    def records_for_word(self, word: str) -> List[int]:
+        """Return the sorted distinct REL records probed for a word."""
+        if self.config.is_gcs or self.config.is_fuse:
+            return [probe[0] for probe in self.probes_for_word(word)]
+        record_bits = self.config.record_bits
+        return sorted({pos // record_bits for pos in self._get_bit_positions(word)})
+
+    def probes_for_word(self, word: str) -> List[Tuple[int, int, int]]:
+        """Return (record, byte, mask) probes in the order the C64 tests them.
+
+        Like check_word(), probes are stably sorted by record. A binary
+        fuse filter's first probe carries the fingerprint as its mask.
+        """
+        if self.config.is_gcs:
+            return [self.gcs.locate(self._gcs_value(word)) + (0,)]
+        if self.config.is_fuse:
+            size = self.config.geometry.rel_record_size
+            slots, fingerprint = self._fuse_slots(self._hash_values(word)[0])
+            return [divmod(slot, size) + (fingerprint if i == 0 else 0,)
+                    for i, slot in enumerate(slots)]
+        record_bits = self.config.record_bits
+        probes = []
+        for pos in self._get_bit_positions(word):
+            record, offset = divmod(pos, record_bits)
+            probes.append((record, offset >> 3, 1 << (offset & 7)))
+        return sorted(probes, key=lambda probe: probe[0])
+
+    def probe_hit(self, data: bytes, probe: Tuple[int, int, int]) -> bool:
+        """Test one probe against filter data laid out in records.
+
+        A binary fuse filter probe says nothing on its own; see
+        probe_share().
+        """
+        record, byte, mask = probe
+        size = self.config.geometry.rel_record_size
+        if self.config.is_gcs:
+            return self.gcs.decode(data[record * size:(record + 1) * size],
+                                   byte)[0]
+        return (data[record * size + byte] & mask) != 0
+
+    def probe_share(self, data: bytes, probe: Tuple[int, int, int]) -> int:
+        """A binary fuse filter probe's byte XOR its fingerprint share."""
+        record, byte, mask = probe
+        size = self.config.geometry.rel_record_size
+        return data[record * size + byte] ^ mask
+
+    def probes_pass(self, data: bytes,
+                    probes: List[Tuple[int, int, int]]) -> bool:
+        """Test a word's probes as the C64 does, stopping where it stops."""
+        if self.config.is_fuse:
+            shares = 0
+            for probe in probes:
+                shares ^= self.probe_share(data, probe)
+            return shares == 0
+        return all(self.probe_hit(data, probe) for probe in probes)
+
+    def lookup_cost(self, word: str) -> Tuple[int, int]:
+        """Probes the C64 tests and distinct records it reads for a word.
+
+        Bloom filter probes stop at the first clear bit; the bytes of a
+        binary fuse filter are all needed.
+        """
+        probes = self.probes_for_word(word)
+        if not self.config.is_fuse:
+            for index, probe in enumerate(probes):
+                if not self.probe_hit(self.data, probe):
+                    probes = probes[:index + 1]
+                    break
+        return len(probes), len({probe[0] for probe in probes})
 
     def add(self, word: str):
         """Add a word to the Bloom filter."""
+        if self.config.is_gcs:
+            self._gcs_values.add(self._gcs_value(word))
+            return
+        if self.config.is_fuse:
+            self._fuse_hashes.append(self._hash_values(word)[0])
+            return
         for bit_pos in self._get_bit_positions(word):
             byte_idx = bit_pos // 8
             bit_idx = bit_pos % 8
@@ -37,6 +188,10 @@ class BloomFilter:
 
     def check(self, word: str) -> bool:
         """Check if a word might be in the filter."""
+        if self.config.is_gcs:
+            return self._gcs_value(word) in self._gcs_values
+        if self.config.is_fuse:
+            return self.probes_pass(self.data, self.probes_for_word(word))
         for bit_pos in self._get_bit_positions(word):
             byte_idx = bit_pos // 8
             bit_idx = bit_pos % 8
@@ -44,24 +199,111 @@ class BloomFilter:
                 return False
         return True
 
-    def build_from_words(self, words: List[str], progress_interval: int = 10000):
-        """Build filter from word list with optional progress display."""
-        print(f"Building Bloom filter ({self.config.size_bytes:,} bytes, "
-              f"{self.config.num_hash_functions} hash functions)...")
+    def check_words(self, words: List[str]) -> List[bool]:
+        """check() every word of a list, vectorized when NumPy is installed."""
+        if not vectorized():
+            return [self.check(word) for word in words]
+        hashes = WordHashes.compute(words, self.config.hash_scheme)
+        if self.config.is_gcs:
+            return [value in self._gcs_values
+                    for value in hashes.gcs_values(self.config).tolist()]
+        if self.config.is_fuse:
+            return test_shares(self.data, *hashes.fuse_keys(self.config))
+        return test_bits(self.data, hashes.bit_positions(self.config))
 
-        for idx, word in enumerate(words):
-            if progress_interval and idx % progress_interval == 0:
-                print(f"  Processing word {idx}/{len(words)}...")
-            self.add(word)
+    def build_from_words(self, words: List[str], progress_interval: int = 10000,
+                         hashes: Optional[WordHashes] = None):
+        """Build filter from word list with optional progress display.
 
+        Given the words' hashes, or with NumPy installed, every word is
+        added at once instead; the filter comes out the same.
+        """
+        if self.config.is_fuse:
+            print(f"Building binary fuse filter ({len(words):,} words, "
+                  f"{self.config.hash_scheme} first hash)...")
+        else:
+            print(f"Building Bloom filter ({self.config.size_bytes:,} bytes, "
+                  f"{self.config.num_hash_functions} {self.config.hash_scheme} "
+                  f"hash functions, {self.config.layout} layout)...")
+
+        if hashes is None and vectorized():
+            hashes = WordHashes.compute(words, self.config.hash_scheme)
+        if hashes is not None:
+            self._add_hashes(hashes)
+        else:
+            for idx, word in enumerate(words):
+                if progress_interval and idx % progress_interval == 0:
+                    print(f"  Processing word {idx}/{len(words)}...")
+                self.add(word)
+
+        if self.config.is_gcs:
+            self._build_gcs()
+        if self.config.is_fuse:
+            self._build_fuse()
         print("Bloom filter built successfully")
 
+    def _add_hashes(self, hashes: WordHashes):
+        """Add every word of a hashed list."""
+        if hashes.scheme != self.config.hash_scheme:
+            raise ValueError(f"Word hashes are {hashes.scheme}, the filter "
+                             f"is {self.config.hash_scheme}")
+        if self.config.is_gcs:
+            self._gcs_values.update(int(value) for value in
+                                    hashes.gcs_values(self.config))
+            return
+        if self.config.is_fuse:
+            self._fuse_hashes.extend(int(value) for value in
+                                     hashes.values(self.config)[0])
+            return
+        set_bits(self.data, hashes.bit_positions(self.config))
+
+    def _build_gcs(self):
+        """Encode the collected hash values into as few records as fit."""
+        config = self.config
+        self.gcs = GolombCodedSet.build(
+            self._gcs_values, config.gcs_hash_bits,
+            config.geometry.rel_record_size,
+            config.geometry.bloom_records * config.num_devices,
+            config.num_devices)
+        self.gcs.verify()
+        self.config = dataclasses.replace(config, records=self.gcs.num_records)
+        self.data = bytearray(self.gcs.data)
+        print(f"  Golomb-coded {len(self.gcs):,} hashes into "
+              f"{self.gcs.num_records} records")
+
+    def _build_fuse(self):
+        """Fit the collected words' fingerprints into as few records as hold them."""
+        config = self.config
+
+        def keys(records: int, seed: int):
+            return fuse_keys(dataclasses.replace(config, records=records,
+                                                 fuse_seed=seed),
+                             self._fuse_hashes)
+
+        self.fuse = BinaryFuseFilter.build(
+            keys, len(self._fuse_hashes), config.geometry.rel_record_size,
+            config.geometry.bloom_records * config.num_devices,
+            config.num_devices)
+        self.config = dataclasses.replace(config,
+                                          records=self.fuse.num_records,
+                                          fuse_seed=self.fuse.seed)
+        self.fuse.verify(*keys(self.fuse.num_records, self.fuse.seed))
+        self.data = bytearray(self.fuse.data)
+        print(f"  Assigned {len(self._fuse_hashes):,} fingerprints to "
+              f"{self.fuse.num_records} records, {FUSE_ARITY} consecutive "
+              f"records per word")
+
     @property
     def bits_set(self) -> int:
         """Count number of bits set in the filter."""
-        return sum(bin(byte).count('1') for byte in self.data)
+        return _popcount(self.data)
 
     @property
     def fill_rate(self) -> float:
         """Calculate actual fill rate (proportion of bits set)."""
         return self.bits_set / self.config.size_bits
+
+
+def _popcount(data: bytes) -> int:
+    """Number of bits set in data."""
+    return bin(int.from_bytes(data, 'little')).count('1')
@@ -7,7 +7,17 @@ https://github.com/johnwbyrd/bloomer
 SPDX-License-Identifier: BSD-3-Clause
 """
 import math
+from collections import Counter
+from pathlib import Path
+from typing import Dict, List, Optional, Sequence, Tuple
+from bloom_config import FUSE_ARITY, FUSE_FINGERPRINT_BITS
 from bloom_filter import BloomFilter
+from common_words import CommonWordTable
+from hot_records import HotRecordSelector
+from record_remap import RecordRemap
+
+# Shares of record accesses to report the cache size needed for
+HIT_RATE_TARGETS = (0.5, 0.75, 0.9, 0.99)
 
 
 class BloomStatistics:
@@ -19,6 +29,8 @@ class BloomStatistics:
 
     def theoretical_fill_rate(self) -> float:
         """Calculate theoretical fill rate: 1 - e^(-kn/m)."""
+        if self.filter.config.is_blocked:
+            return self._blocked_expectation(lambda fill: fill)
         k = self.filter.config.num_hash_functions
         n = self.word_count
         m = self.filter.config.size_bits
@@ -27,8 +39,42 @@ class BloomStatistics:
 
     def false_positive_rate(self) -> float:
         """Calculate false positive rate: (1 - e^(-kn/m))^k."""
+        if self.filter.config.is_gcs:
+            return self.filter.gcs.false_positive_rate
+        if self.filter.config.is_fuse:
+            return self.filter.fuse.false_positive_rate
+        if self.filter.config.is_blocked:
+            k = self.filter.config.probes_per_word
+            return self._blocked_expectation(lambda fill: fill ** k)
         return self.theoretical_fill_rate() ** self.filter.config.num_hash_functions
 
+    def _blocked_expectation(self, func) -> float:
+        """Average func(fill) over the Poisson distribution of words per record.
+
+        A record holding j words with k probes each has fill
+        1 - (1 - 1/B)^(kj), where B is the number of bits per record.
+        """
+        config = self.filter.config
+        k = config.probes_per_word
+        b = config.record_bits
+        lam = self.word_count / config.num_records
+        upper = int(lam + 12 * math.sqrt(lam) + 20)
+
+        total = 0.0
+        for j in range(upper + 1):
+            log_p = -lam + j * math.log(lam) - math.lgamma(j + 1)
+            fill = 1 - (1 - 1 / b) ** (k * j)
+            total += math.exp(log_p) * func(fill)
+        return total
+
+    def observed_fp_rate(self) -> float:
+        """Estimate FP rate from the bits actually set in the built filter."""
+        k = self.filter.config.probes_per_word
+        if self.filter.config.is_blocked:
+            fills = self.filter.record_fill_rates()
+            return sum(fill ** k for fill in fills) / len(fills)
+        return self.filter.fill_rate ** k
+
     def optimal_k(self) -> float:
         """Calculate optimal k for minimum FP rate."""
         m = self.filter.config.size_bits
@@ -43,11 +89,31 @@ class BloomStatistics:
         fill = 1 - math.exp(-k_opt * n / m)
         return fill ** k_opt
 
+    def records_per_word(self) -> float:
+        """Expected distinct records a dictionary word's probes touch.
+
+        Classic probes can share a record: r(1 - (1 - 1/r)^k) for r records.
+        """
+        config = self.filter.config
+        if config.is_fuse:
+            return FUSE_ARITY
+        if config.is_blocked or config.is_gcs:
+            return 1
+        r = config.num_records
+        return r * (1 - (1 - 1 / r) ** config.num_hash_functions)
+
     def print_statistics(self):
         """Print comprehensive statistics."""
+        if self.filter.config.is_gcs:
+            self._print_gcs_statistics()
+            return
+        if self.filter.config.is_fuse:
+            self._print_fuse_statistics()
+            return
         n = self.word_count
         k = self.filter.config.num_hash_functions
         m = self.filter.config.size_bits
+        layout = self.filter.config.layout
 
         actual_fill = self.filter.fill_rate
         theoretical_fill = self.theoretical_fill_rate()
@@ -57,6 +123,8 @@ class BloomStatistics:
         print(f"Words inserted (n): {n:,}")
         print(f"Bits in filter (m): {m:,}")
         print(f"Hash functions (k): {k}")
+        print(f"Layout: {layout} "
+              f"({self.filter.config.probes_per_word} bit probes per word)")
         print(f"Bits per word (m/n): {m/n:.2f}")
         print(f"\nActual bits set: {self.filter.bits_set:,} / {m:,} "
               f"({actual_fill * 100:.2f}%)")
@@ -64,7 +132,14 @@ class BloomStatistics:
         print(f"Difference: {abs(actual_fill - theoretical_fill) * 100:.2f}%")
         print(f"\nFalse positive rate: {fp_rate * 100:.4f}% "
               f"(1 in {1/fp_rate:.0f})")
-        print(f"Formula: (1 - e^(-{k}×{n}/{m}))^{k} = {fp_rate:.6f}")
+        if self.filter.config.is_blocked:
+            r = self.filter.config.num_records
+            print(f"Formula: E[(1 - (1 - 1/B)^({k - 1}j))^{k - 1}], "
+                  f"j ~ Poisson({n}/{r}) = {fp_rate:.6f}")
+        else:
+            print(f"Formula: (1 - e^(-{k}×{n}/{m}))^{k} = {fp_rate:.6f}")
+        print(f"Observed from filter contents: "
+              f"{self.observed_fp_rate() * 100:.4f}%")
 
         optimal_k = self.optimal_k()
         print(f"\nOptimal k for minimum FP rate: {optimal_k:.2f}")
@@ -74,3 +149,173 @@ class BloomStatistics:
             print(f"With k={k_opt_int}: FP rate would be {opt_fp * 100:.4f}%")
             print(f"Trade-off: Using k={k} reduces disk I/O "
                   "(fewer sector reads per word)")
+
+    def _print_gcs_statistics(self):
+        """Print the size, cost and false positive rate of a Golomb-coded set."""
+        config = self.filter.config
+        gcs = self.filter.gcs
+        fp_rate = gcs.false_positive_rate
+        bloom_bytes = (config.geometry.bloom_records * config.num_devices *
+                       config.geometry.rel_record_size)
+
+        print("\n=== GOLOMB-CODED SET STATISTICS ===")
+        print(f"Words inserted (n): {self.word_count:,}")
+        gcs.print_summary(self.word_count, bloom_bytes)
+        print(f"Bits per word: {config.size_bits / self.word_count:.2f}")
+        print(f"\nFalse positive rate: {fp_rate * 100:.4f}% "
+              f"(1 in {1/fp_rate:.0f})")
+        print(f"Formula: {len(gcs):,} / 2^{gcs.hash_bits} = {fp_rate:.6f}")
+
+    def _print_fuse_statistics(self):
+        """Print the size and false positive rate of a binary fuse filter."""
+        config = self.filter.config
+        fuse = self.filter.fuse
+        fp_rate = fuse.false_positive_rate
+        bloom_bytes = (config.geometry.bloom_records * config.num_devices *
+                       config.geometry.rel_record_size)
+
+        print("\n=== BINARY FUSE FILTER STATISTICS ===")
+        print(f"Words inserted (n): {self.word_count:,}")
+        fuse.print_summary(bloom_bytes)
+        print(f"Remix seed: {config.fuse_seed}")
+        print(f"\nFalse positive rate: {fp_rate * 100:.4f}% "
+              f"(1 in {1/fp_rate:.0f})")
+        print(f"Formula: 2^-{FUSE_FINGERPRINT_BITS} = {fp_rate:.6f}")
+
+    def print_record_report(self, weighted_words: List[Tuple[str, float]],
+                            output_dir: Path,
+                            common_table: Optional[CommonWordTable] = None,
+                            remap: Optional[RecordRemap] = None,
+                            cache_slots: int = 0):
+        """Print and write per-record density, access heat and cache curve.
+
+        weighted_words are the lookups to measure. Words the common-word
+        table answers never reach the disk and are left out. Three CSV
+        files go to output_dir:
+
+        record_heat.csv: each logical record's place in BLOOM.DAT, bits
+        set, density, weighted accesses and their share, and heat rank.
+        records_per_word.csv: the weighted distribution of distinct
+        records a word touches.
+        cache_curve.csv: with the n hottest records held in RAM, the
+        share of record accesses they serve and the share of words that
+        never touch the disk, for every n. That is the preload of n
+        records; the CLOCK cache does at least as well once warm.
+        """
+        config = self.filter.config
+        num_records = config.num_records
+        lookups = weighted_words
+        if common_table:
+            lookups = [(word, weight) for word, weight in weighted_words
+                       if not common_table.contains(word)]
+        if not lookups:
+            print("\nPer-record statistics: no lookups to measure")
+            return
+        selector = HotRecordSelector(self.filter, lookups)
+        ranked = selector.ranked()
+        rank_of = {record: rank for rank, record in enumerate(ranked)}
+        accesses = sum(selector.heat.values())
+
+        # A word is served from RAM once its coldest record is cached
+        per_word: Dict[int, float] = Counter()
+        served_at: Dict[int, float] = Counter()
+        for word, weight in lookups:
+            records = set(self.filter.records_for_word(word))
+            per_word[len(records)] += weight
+            served_at[max(rank_of[record] for record in records) + 1] += weight
+        words = sum(per_word.values())
+
+        curve = [(0, 0.0, 0.0)]
+        record_hits = word_hits = 0.0
+        for n, record in enumerate(ranked, 1):
+            record_hits += selector.heat[record]
+            word_hits += served_at[n]
+            curve.append((n, record_hits / accesses, word_hits / words))
+        curve += [(n, 1.0, 1.0)
+                  for n in range(len(ranked) + 1, num_records + 1)]
+
+        output_dir.mkdir(parents=True, exist_ok=True)
+        densities = self.filter.record_fill_rates()[:num_records]
+        with open(output_dir / 'record_heat.csv', 'w') as f:
+            f.write("record,physical,bits_set,density,accesses,share,rank\n")
+            for record, density in enumerate(densities):
+                heat = selector.heat.get(record, 0.0)
+                rank = rank_of.get(record)
+                f.write(f"{record},"
+                        f"{remap.physical(record) if remap else record},"
+                        f"{round(density * config.record_bits)},"
+                        f"{density:.4f},{heat:.1f},{heat / accesses:.6f},"
+                        f"{'' if rank is None else rank + 1}\n")
+        with open(output_dir / 'records_per_word.csv', 'w') as f:
+            f.write("records,weight,share\n")
+            for count in sorted(per_word):
+                f.write(f"{count},{per_word[count]:.1f},"
+                        f"{per_word[count] / words:.6f}\n")
+        with open(output_dir / 'cache_curve.csv', 'w') as f:
+            f.write("cached_records,record_hit_rate,word_hit_rate\n")
+            for n, record_rate, word_rate in curve:
+                f.write(f"{n},{record_rate:.6f},{word_rate:.6f}\n")
+
+        mean = sum(densities) / len(densities)
+        spread = math.sqrt(sum((d - mean) ** 2 for d in densities) /
+                           len(densities))
+        sparsest = min(range(len(densities)), key=densities.__getitem__)
+        densest = max(range(len(densities)), key=densities.__getitem__)
+        print("\n=== PER-RECORD STATISTICS ===")
+        print(f"Lookups measured: {len(lookups):,} words "
+              f"({len(weighted_words) - len(lookups):,} left to the "
+              f"common-word table)")
+        print(f"Bit density: mean {mean * 100:.2f}%, std dev "
+              f"{spread * 100:.2f}%")
+        print(f"  Lowest record {sparsest} at "
+              f"{densities[sparsest] * 100:.2f}%, highest record {densest} "
+              f"at {densities[densest] * 100:.2f}%")
+        hottest = selector.heat[ranked[0]] / accesses
+        print(f"Records touched: {len(ranked)} / {num_records}; record "
+              f"{ranked[0]} takes {hottest * 100:.2f}% of accesses")
+        mean_records = sum(count * weight
+                           for count, weight in per_word.items()) / words
+        shares = ', '.join(f"{count}: {weight / words * 100:.1f}%"
+                           for count, weight in sorted(per_word.items()))
+        print(f"Distinct records per word: mean {mean_records:.2f} "
+              f"({shares})")
+        print("Records held in RAM, hottest first:")
+        for target in HIT_RATE_TARGETS:
+            n = next(n for n, rate, _ in curve if rate >= target)
+            print(f"  {target * 100:.0f}% of record accesses: {n} records "
+                  f"({n * config.geometry.rel_record_size:,} bytes)")
+        if cache_slots:
+            n, record_rate, word_rate = curve[min(cache_slots, num_records)]
+            print(f"  {n}, the cache as built: {record_rate * 100:.1f}% of "
+                  f"accesses, {word_rate * 100:.1f}% of words never read")
+        print(f"Per-record CSV files written to {output_dir}")
+
+    def print_comparison(self, others: List['BloomStatistics']):
+        """Print size, lookup cost and FP rate beside other formats'."""
+        filters = [self] + others
+        print("\n=== FORMAT COMPARISON ===")
+        rows = [
+            ('Format', [s.filter.config.format_name for s in filters]),
+            ('Size (bytes)', [f"{s.filter.config.size_bytes:,}"
+                              for s in filters]),
+            ('Bits per word', [f"{s.filter.config.size_bits / s.word_count:.2f}"
+                               for s in filters]),
+            ('Hash states', [str(s.filter.config.running_hashes)
+                             for s in filters]),
+            ('Probes per word', [str(s.filter.config.probes_per_word)
+                                 for s in filters]),
+            ('Records per word', [f"{s.records_per_word():.2f}"
+                                  for s in filters]),
+            ('False positives', [f"{s.false_positive_rate() * 100:.4f}%"
+                                 for s in filters]),
+        ]
+        print_table(rows)
+
+
+def print_table(rows: Sequence[Tuple[str, Sequence[str]]]):
+    """Print (label, values) rows as aligned columns, one per format."""
+    widths = [max(len(values[i]) for _, values in rows)
+              for i in range(len(rows[0][1]))]
+    for label, values in rows:
+        print(f"{label:<18}" + ''.join(f"  {value:>{width}}"
+                                       for value, width in zip(values, widths)))
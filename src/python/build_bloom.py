@@ -9,18 +9,32 @@ SPDX-License-Identifier: BSD-3-Clause
 """
 import os
 import sys
+from collections import Counter
 from pathlib import Path
 
 # Import our modules
 from disk_geometry import DiskGeometry
-from bloom_config import BloomConfig
+from bloom_config import BloomConfig, LAYOUT_CLASSIC, LAYOUT_FUSE
+from memory_map import MemoryMap
+from runtime_config import RuntimeConfig
 from bloom_filter import BloomFilter
 from bloom_statistics import BloomStatistics
 from empirical_validator import EmpiricalValidator
 from scowl_downloader import SCOWLDownloader
 from scowl_parser import SCOWLParser
 from header_generator import CHeaderGenerator
+from kernel_generator import LookupKernelGenerator
+from common_words import CommonWordTable, read_corpus
+from cross_check import CrossCheck
+from bench_words import BenchWordList, bench_device
+from hot_records import HotRecordSelector
+from record_remap import RecordRemap
+from word_frequency import WordFrequency
 from disk_creator import DiskImageCreator
+from disk_simulator import (preload_record_ms, program_block_ms,
+                            record_interval_ms)
+from rel_layout import Interleave
+from word_hashes import WordHashes
 
 
 # SCOWL Configuration
@@ -34,6 +48,61 @@ SCOWL_CONFIG = {
     'format': 'inline',
 }
 
+# Disk drive configuration
+DISK_CONFIG = {
+    'drive': '1541',            # 1541, 1571 (double-sided) or 1581
+    'devices': (8,),            # e.g. (8, 9) stripes the filter across two drives
+    'crunch': True,             # Store the program self-unpacking: fewer blocks
+    'fastloader': True,         # BOOT, first on the disk, loads it faster
+}
+
+# Bloom filter configuration
+FILTER_CONFIG = {
+    'num_hash_functions': 5,
+    'layout': 'classic',        # classic, blocked (one record per lookup),
+                                # gcs (Golomb-coded, smaller, slower to test),
+                                # fuse (binary fuse filter, 3 probes, ~0.4% FP)
+    'gcs_hash_bits': 24,        # gcs only: false positives ~ words / 2^bits
+    'hash_scheme': 'independent',  # independent, double (one pass, any k),
+                                # pearson (one pass of byte table lookups)
+    'range_reduction': 'multiply_shift',  # multiply_shift (no division), modulo
+}
+
+# C64 runtime configuration
+RUNTIME_CONFIG = {
+    'cache_slots': None,        # Record cache size; None = fill free RAM
+    'preload_hot_records': True,  # Stream hot records into the cache at startup
+    'preload_seconds': 5.0,     # Stop the preload after this long; None = fill cache
+    'preload_sizes': (10, 20, 35),  # SCOWL sizes used as a frequency proxy
+    'access': 'rel',            # rel (P command), direct (U1 block reads)
+    'batch_words': 128,         # Words per document sweep; 0 = no batch mode
+    'common_words': 2048,       # Most frequent words answered from RAM; 0 = off
+    'common_words_corpus': None,  # Optional text file to measure RAM hits on
+    'recent_words': 255,        # Results of recently checked words; 0 = off
+    'profile': False,           # Print CIA-timed per-phase cost of each lookup
+    'interleave': None,         # BLOOM.DAT sector gap; None = match the access mode
+    'heat_order': True,         # Store hot records first, on adjacent tracks
+    'heat_corpus': None,        # Text file to rank records by; None = SCOWL proxy
+    'reu': True,                # Load the whole filter into a 17xx REU if present
+    'type_ahead': True,         # Check words in the background while typing
+    'suggest': True,            # '?WORD' lists corrections; needs batch_words
+    'fast_serial': True,        # rel_byte caches whole records under JiffyDOS
+}
+
+# Build host configuration
+BUILD_CONFIG = {
+    'jobs': None,               # Worker processes; None = one per CPU
+    'hash_cache': True,         # Keep the word list's hashes between builds
+    'validation_samples': 100000,  # Random non-words for the measured FP rate
+    'validation_seed': 1,       # Seeds the samples; None = new ones each build
+    'require_fp_match': True,   # Stop the build if the FP rate is off theory
+    'cross_check_samples': 20000,  # Words listed for bloomcheck -v; 0 = none
+    'compare_formats': True,    # Also build a fuse (or Bloom) filter to compare
+    'record_stats': True,       # Per-record density, heat and cache curve CSVs
+    'record_stats_corpus': None,  # Text file to measure them on; None = SCOWL proxy
+    'bench_words': 128,         # Words spellcheck_bench checks; 0 = no list
+}
+
 # Directory structure
 BUILD_DIR = Path('build')
 CACHE_DIR = BUILD_DIR / 'cache'
@@ -42,6 +111,22 @@ ARTIFACTS_DIR = BUILD_DIR / 'artifacts'
 WORD_LIST_CACHE = CACHE_DIR / 'scowl_wordlist.txt'
 
 
+def disk_geometry() -> DiskGeometry:
+    """The drive's disk, less the blocks kept for BOOT and the program.
+
+    The program gets room for the largest PRG that memory_map.py's program
+    reserve allows. Its tables grow with the filter, so they are sized for
+    a filter that fills the whole disk before the program takes its share.
+    """
+    geometry = DiskGeometry.for_drive(DISK_CONFIG['drive'])
+    config = BloomConfig(geometry=geometry, devices=DISK_CONFIG['devices'],
+                         **FILTER_CONFIG)
+    runtime = RuntimeConfig(memory=MemoryMap(), **RUNTIME_CONFIG)
+    blocks = DiskImageCreator(geometry).program_blocks(
+        runtime.program_file_bytes(config), DISK_CONFIG['fastloader'])
+    return geometry.with_program(blocks)
+
+
 def main():
     # Change to project directory
     script_dir = Path(__file__).parent
@@ -49,9 +134,23 @@ def main():
         os.chdir(script_dir.parent.parent)
 
     # Setup configuration
-    geometry = DiskGeometry()
-    config = BloomConfig(geometry=geometry, num_hash_functions=5)
+    geometry = disk_geometry()
+    config = BloomConfig(geometry=geometry, devices=DISK_CONFIG['devices'],
+                         **FILTER_CONFIG)
     config.print_summary()
+    runtime = RuntimeConfig(memory=MemoryMap(), **RUNTIME_CONFIG)
+    runtime.validate(config)
+
+    # A program built already must fit the blocks the filter leaves it
+    disk_creator = DiskImageCreator(geometry)
+    prg_path = ARTIFACTS_DIR / 'spellcheck.prg'
+    blocks = disk_creator.stored_program_blocks(prg_path, DISK_CONFIG['crunch'],
+                                                DISK_CONFIG['fastloader'])
+    if blocks is not None and blocks > geometry.program_sectors:
+        print(f"{prg_path} takes {blocks} blocks with BOOT, but the filter "
+              f"leaves {geometry.program_sectors}; raise program_reserve in "
+              f"memory_map.py so the disk keeps room for it")
+        sys.exit(1)
 
     # Download word list
     downloader = SCOWLDownloader(CACHE_DIR)
@@ -62,8 +161,15 @@ def main():
     words = parser.parse(word_file)
 
     # Build Bloom filter
+    hashes = None
+    if BUILD_CONFIG['hash_cache']:
+        hashes = WordHashes.cached(words, config.hash_scheme, SCOWL_CONFIG,
+                                   CACHE_DIR, BUILD_CONFIG['jobs'])
     bloom = BloomFilter(config)
-    bloom.build_from_words(words)
+    bloom.build_from_words(words, hashes=hashes)
+    config = bloom.config  # gcs and fuse filters know their size only now
+    preload_ms = preload_record_ms(runtime.access)
+    runtime.print_summary(config, preload_ms)
 
     # Calculate and display statistics
     stats = BloomStatistics(bloom, len(words))
@@ -71,26 +177,138 @@ def main():
 
     # Run empirical validation
     validator = EmpiricalValidator(bloom, words)
-    validator.print_validation(stats.false_positive_rate())
+    matches = validator.print_validation(stats.false_positive_rate(),
+                                         BUILD_CONFIG['validation_samples'],
+                                         BUILD_CONFIG['jobs'],
+                                         BUILD_CONFIG['validation_seed'])
+    if not matches and BUILD_CONFIG['require_fp_match']:
+        print("This filter configuration fails validation; set "
+              "BUILD_CONFIG['require_fp_match'] to False to build it anyway")
+        sys.exit(1)
+
+    # Build the other format from the same words, to compare the two
+    if BUILD_CONFIG['compare_formats']:
+        layout = LAYOUT_CLASSIC if config.is_fuse else LAYOUT_FUSE
+        other = BloomFilter(BloomConfig(geometry=geometry,
+                                        devices=DISK_CONFIG['devices'],
+                                        **{**FILTER_CONFIG, 'layout': layout}))
+        try:
+            other.build_from_words(words, hashes=hashes)
+        except ValueError as error:
+            # A fuse filter has a minimum size, which may not fit this disk
+            print(f"\nNo format comparison: {error}")
+        else:
+            stats.print_comparison([BloomStatistics(other, len(words))])
+            validator.print_comparison([EmpiricalValidator(other, words)],
+                                       BUILD_CONFIG['validation_samples'],
+                                       BUILD_CONFIG['jobs'])
+
+    # Word frequency drives the preload, the common-word table and placement
+    preload_records = []
+    minimal_preload_records = []
+    common_table = None
+    remap = None
+    weighted_words = []
+    preload_count = runtime.preload_record_count(config, preload_ms)
+    heat_proxy = runtime.heat_order and not runtime.heat_corpus
+    stats_proxy = (BUILD_CONFIG['record_stats'] and
+                   not BUILD_CONFIG['record_stats_corpus'])
+    if (preload_count or runtime.common_words or heat_proxy or stats_proxy or
+            BUILD_CONFIG['bench_words']):
+        print("\nLoading word frequency proxy...")
+        frequency = WordFrequency(downloader, SCOWL_CONFIG, CACHE_DIR)
+        weighted_words = frequency.load(runtime.preload_sizes)
+
+        # Answer the most common words from RAM without touching the disk
+        if runtime.common_words:
+            common_table = CommonWordTable.select(weighted_words, set(words),
+                                                  runtime.common_words,
+                                                  config.hash_scheme)
+            corpus = runtime.common_words_corpus
+            common_table.print_summary(weighted_words,
+                                       Path(corpus) if corpus else None)
+
+    # Rank records by the words that reach the disk, for the preload and
+    # for placement alike. Words answered from the common-word table never
+    # do, so they neither heat a record nor earn it a place in the preload.
+    if preload_count or runtime.heat_order:
+        if runtime.heat_corpus:
+            heat_words = list(Counter(read_corpus(Path(runtime.heat_corpus))).items())
+        else:
+            heat_words = weighted_words
+        if common_table:
+            heat_words = [(word, weight) for word, weight in heat_words
+                          if not common_table.contains(word)]
+        selector = HotRecordSelector(bloom, heat_words)
+
+        # Choose hot records to preload into the C64 record cache
+        if preload_count:
+            preload_records = selector.select(preload_count)
+            selector.print_selection(preload_records)
+            # spellcheck_min caches more, so it preloads more
+            minimal_preload_records = selector.select(
+                runtime.minimal().preload_record_count(config, preload_ms))
+
+        # Store the hottest records first so they share a few adjacent tracks
+        if runtime.heat_order:
+            selector.print_placement()
+            remap = RecordRemap.from_ranking(selector.ranked(), config.num_records)
+            preload_records = sorted(remap.physical(r) for r in preload_records)
+            minimal_preload_records = sorted(remap.physical(r)
+                                             for r in minimal_preload_records)
+
+    # Per-record behavior, to size the cache and preload from evidence
+    if BUILD_CONFIG['record_stats']:
+        stats_corpus = BUILD_CONFIG['record_stats_corpus']
+        if stats_corpus:
+            stats_words = list(Counter(read_corpus(Path(stats_corpus))).items())
+        else:
+            stats_words = weighted_words
+        stats.print_record_report(stats_words, GENERATED_DIR, common_table,
+                                  remap, runtime.record_cache_slots(config))
 
     # Write Bloom filter data
     bloom_path = GENERATED_DIR / 'bloom.dat'
     bloom_path.parent.mkdir(parents=True, exist_ok=True)
     with open(bloom_path, 'wb') as f:
-        f.write(bloom.data)
+        if remap:
+            f.write(remap.apply(bloom.data, geometry.rel_record_size))
+        else:
+            f.write(bloom.data)
     print(f"Bloom filter written to {bloom_path}")
 
     # Generate C header
     header_gen = CHeaderGenerator()
     header_path = GENERATED_DIR / 'bloom_config.h'
-    header_gen.generate(config, len(words), stats.false_positive_rate() * 100,
-                       SCOWL_CONFIG, header_path)
+    header_gen.generate(config, runtime, len(words),
+                       stats.false_positive_rate() * 100,
+                       SCOWL_CONFIG, header_path, preload_records,
+                       minimal_preload_records, common_table, remap, bloom.gcs)
+    LookupKernelGenerator().generate(config, GENERATED_DIR / 'bloom_kernel.h',
+                                     remap is not None and not remap.is_identity)
+    if BUILD_CONFIG['cross_check_samples']:
+        CrossCheck(bloom, remap, common_table).write(
+            GENERATED_DIR / 'bloom_crosscheck.txt', words,
+            BUILD_CONFIG['cross_check_samples'])
+    if BUILD_CONFIG['bench_words']:
+        bench = BenchWordList(words, CrossCheck(bloom, remap, common_table))
+        bench.write_header(GENERATED_DIR / 'bloom_bench.h',
+                           bench.select(weighted_words,
+                                        BUILD_CONFIG['bench_words']),
+                           bench_device(config.devices))
 
-    # Create disk image
-    disk_creator = DiskImageCreator()
-    prg_path = ARTIFACTS_DIR / 'spellcheck.prg'
-    d64_path = ARTIFACTS_DIR / 'spellcheck.d64'
-    disk_creator.create(prg_path, bloom_path, d64_path)
+    # Create disk images, one per drive
+    d64_path = ARTIFACTS_DIR / f'spellcheck.{geometry.image_type}'
+    map_path = GENERATED_DIR / 'bloom_map.csv'
+    if runtime.interleave is None:
+        interleave = Interleave(consume_ms=record_interval_ms(runtime.access))
+    else:
+        interleave = Interleave(sectors=runtime.interleave)
+    fastloader = DISK_CONFIG['fastloader']
+    program_interleave = Interleave(consume_ms=program_block_ms(fastloader))
+    disk_creator.create(prg_path, bloom_path, d64_path, map_path, interleave,
+                        config.devices, program_interleave,
+                        DISK_CONFIG['crunch'], fastloader)
 
     print("\n" + "=" * 60)
     print("BUILD COMPLETE!")
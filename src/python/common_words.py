@@ -0,0 +1,115 @@
+"""
+RAM-resident table of the most common dictionary words.
+
+Copyright (c) 2025 John Byrd
+https://github.com/johnwbyrd/bloomer
+
+SPDX-License-Identifier: BSD-3-Clause
+"""
+import re
+from bisect import bisect_left
+from pathlib import Path
+from typing import Iterable, List, Optional, Set, Tuple
+from bloom_config import HASH_INDEPENDENT, HASH_PEARSON
+from hash_functions import hash_jenkins, hash_pearson
+
+FINGERPRINT_BITS = 24
+NUM_BUCKETS = 256          # Top fingerprint byte selects a bucket
+INDEX_ENTRIES = NUM_BUCKETS + 1
+MAX_COMMON_WORDS = 16384
+
+WORD_PATTERN = re.compile(r"[A-Za-z]+(?:'[A-Za-z]+)*")
+
+
+def read_corpus(path: Path) -> List[str]:
+    """Words of a text file or word list, upper-cased like the C64 input."""
+    with open(path, 'r', encoding='utf-8', errors='replace') as f:
+        return [token.upper() for token in WORD_PATTERN.findall(f.read())]
+
+
+def word_fingerprint(word: str, scheme: str = HASH_INDEPENDENT) -> int:
+    """24-bit fingerprint: the top bits of Jenkins one-at-a-time, seed 0.
+
+    Under Pearson hashing it is the top bits of the filter's first hash
+    instead, which the C64 computes anyway, so a word costs no Jenkins
+    fold at all.
+    """
+    if scheme == HASH_PEARSON:
+        return hash_pearson(word, 0) >> (32 - FINGERPRINT_BITS)
+    return hash_jenkins(word, 0) >> (32 - FINGERPRINT_BITS)
+
+
+class CommonWordTable:
+    """Exact-membership set of common words, stored as sorted fingerprints.
+
+    The C64 keeps a 257-entry index of bucket start offsets and one 16-bit
+    key per word, sorted within each bucket. A word is accepted only if its
+    fingerprint is present, so every dictionary word in the table answers
+    OK with no disk access. A misspelling is wrongly accepted only if it
+    collides with one of the fingerprints.
+    """
+
+    def __init__(self, words: Iterable[str], scheme: str = HASH_INDEPENDENT):
+        self.words = list(dict.fromkeys(words))
+        self.scheme = scheme
+        self.fingerprints = sorted({word_fingerprint(word, scheme)
+                                    for word in self.words})
+        self.keys = [fp & 0xFFFF for fp in self.fingerprints]
+        self.index = [bisect_left(self.fingerprints, bucket << 16)
+                      for bucket in range(INDEX_ENTRIES)]
+
+    @classmethod
+    def select(cls, weighted_words: List[Tuple[str, float]],
+               dictionary: Set[str], count: int,
+               scheme: str = HASH_INDEPENDENT) -> 'CommonWordTable':
+        """Build a table of the count most frequent dictionary words."""
+        ranked = sorted((pair for pair in weighted_words if pair[0] in dictionary),
+                        key=lambda pair: -pair[1])
+        return cls((word for word, _ in ranked[:count]), scheme)
+
+    def __len__(self) -> int:
+        return len(self.fingerprints)
+
+    def contains(self, word: str) -> bool:
+        """True if word's fingerprint is in the table."""
+        fp = word_fingerprint(word, self.scheme)
+        pos = bisect_left(self.fingerprints, fp)
+        return pos < len(self.fingerprints) and self.fingerprints[pos] == fp
+
+    @property
+    def size_bytes(self) -> int:
+        """C64 RAM used by the index and the keys."""
+        return 2 * INDEX_ENTRIES + 2 * len(self.keys)
+
+    @property
+    def false_positive_rate(self) -> float:
+        """Chance that a random misspelling matches some fingerprint."""
+        return len(self.fingerprints) / (1 << FINGERPRINT_BITS)
+
+    def weighted_hit_rate(self, weighted_words: List[Tuple[str, float]]) -> float:
+        """Fraction of frequency-weighted lookups answered from the table."""
+        total = sum(weight for _, weight in weighted_words)
+        hits = sum(weight for word, weight in weighted_words if self.contains(word))
+        return hits / total if total else 0.0
+
+    def corpus_hit_rate(self, corpus_path: Path) -> Tuple[int, float]:
+        """Token count and fraction of tokens in a text file served from RAM."""
+        tokens = read_corpus(corpus_path)
+        if not tokens:
+            return 0, 0.0
+        hits = sum(1 for token in tokens if self.contains(token))
+        return len(tokens), hits / len(tokens)
+
+    def print_summary(self, weighted_words: List[Tuple[str, float]],
+                      corpus_path: Optional[Path] = None):
+        """Print table size and expected disk avoidance."""
+        print("\n=== COMMON WORD TABLE ===")
+        print(f"Words: {len(self.words):,} ({len(self.fingerprints):,} distinct "
+              f"{FINGERPRINT_BITS}-bit fingerprints, {self.size_bytes:,} bytes)")
+        print(f"Misspelling collision rate: {self.false_positive_rate * 100:.4f}%")
+        print(f"Weighted lookups with no disk access (Zipf estimate): "
+              f"{self.weighted_hit_rate(weighted_words) * 100:.1f}%")
+        if corpus_path is not None:
+            tokens, rate = self.corpus_hit_rate(corpus_path)
+            print(f"Sample corpus {corpus_path}: {tokens:,} words, "
+                  f"{rate * 100:.1f}% with no disk access")
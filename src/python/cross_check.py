@@ -0,0 +1,65 @@
+"""
+Expected probes and answers for checking the C lookup code against Python.
+
+Copyright (c) 2025 John Byrd
+https://github.com/johnwbyrd/bloomer
+
+SPDX-License-Identifier: BSD-3-Clause
+"""
+import random
+import string
+from pathlib import Path
+from typing import List, Optional
+from bloom_filter import BloomFilter
+from common_words import CommonWordTable
+from record_remap import RecordRemap
+
+
+class CrossCheck:
+    """List what the C64 should compute for sample words, from Python alone.
+
+    One line per word, in the format of bloomcheck -p: the word, a tab,
+    its probes in the order the C64 tests them, a tab, and 1 if the C64
+    passes the word. Bit and binary fuse filter probes are record:byte:mask
+    (a fuse mask is the fingerprint share) and Golomb-coded set probes
+    record:key, with records after the heat remap. bloomcheck -v
+    recomputes every line with bloom_core.h and reports any difference.
+    """
+
+    def __init__(self, bloom_filter: BloomFilter,
+                 remap: Optional[RecordRemap] = None,
+                 common_table: Optional[CommonWordTable] = None):
+        self.filter = bloom_filter
+        self.remap = remap
+        self.common_table = common_table
+
+    def line(self, word: str) -> str:
+        """The expected bloomcheck -p line for a word."""
+        probes = self.filter.probes_for_word(word)
+        if self.remap:
+            probes = sorted(((self.remap.physical(record), byte, mask)
+                             for record, byte, mask in probes),
+                            key=lambda probe: probe[0])
+        if self.filter.config.is_gcs:
+            text = ' '.join(f'{record}:{key}' for record, key, _ in probes)
+        else:
+            text = ' '.join(f'{record}:{byte}:{mask}'
+                            for record, byte, mask in probes)
+        return f'{word}\t{text}\t{int(self.expected(word))}\n'
+
+    def expected(self, word: str) -> bool:
+        """Whether the C64 passes a word: common words pass from RAM."""
+        return ((self.common_table is not None and
+                 self.common_table.contains(word)) or
+                self.filter.check(word))
+
+    def write(self, path: Path, words: List[str], samples: int, seed: int = 1):
+        """Write lines for samples words: half dictionary, half random."""
+        rng = random.Random(seed)
+        chosen = rng.sample(words, min(len(words), samples // 2))
+        chosen += [''.join(rng.choices(string.ascii_uppercase,
+                                       k=rng.randint(3, 15)))
+                   for _ in range(samples - len(chosen))]
+        with open(path, 'w') as f:
+            f.writelines(self.line(word) for word in chosen)
+        print(f"Cross-check list written to {path} ({len(chosen):,} words)")
@@ -0,0 +1,157 @@
+"""
+Raw .d64/.d71/.d81 image access for inspecting file layout on disk.
+
+Copyright (c) 2025 John Byrd
+https://github.com/johnwbyrd/bloomer
+
+SPDX-License-Identifier: BSD-3-Clause
+"""
+from dataclasses import dataclass
+from pathlib import Path
+from typing import Iterator, List, Optional, Tuple
+from disk_geometry import DiskGeometry, SIDE_SECTOR_ENTRIES
+
+FILE_TYPE_MASK = 0x07
+FILE_TYPE_PRG = 0x02
+FILE_TYPE_REL = 0x04
+FILENAME_PAD = 0xA0
+ENTRY_SIZE = 32
+ENTRIES_PER_SECTOR = 8
+SIDE_SECTOR_NUMBER = 2       # Side sector index, or SUPER_SIDE_SECTOR
+SIDE_SECTOR_DATA_OFFSET = 16  # Data block T/S list starts here
+SUPER_SIDE_SECTOR = 0xFE      # Marks a 1581 super side sector
+
+
+@dataclass(frozen=True)
+class DirectoryEntry:
+    """One CBM DOS directory entry."""
+
+    file_type: int
+    name: bytes
+    track: int
+    sector: int
+    side_track: int
+    side_sector: int
+    record_length: int
+    blocks: int
+
+
+class D64Image:
+    """Read-only view of a .d64 image at the track/sector level."""
+
+    def __init__(self, data: bytes, geometry: DiskGeometry = DiskGeometry()):
+        self.data = data
+        self.geometry = geometry
+
+    @classmethod
+    def load(cls, path: Path, geometry: DiskGeometry = DiskGeometry()):
+        """Load an image from disk."""
+        with open(path, 'rb') as f:
+            return cls(f.read(), geometry)
+
+    def block(self, track: int, sector: int) -> bytes:
+        """Return the 256 bytes of one block."""
+        size = self.geometry.bytes_per_sector
+        offset = self.geometry.sector_index(track, sector) * size
+        return self.data[offset:offset + size]
+
+    def chain(self, track: int, sector: int) -> Iterator[Tuple[int, int, bytes]]:
+        """Follow a block chain, yielding (track, sector, block) tuples."""
+        seen = set()
+        while track != 0:
+            if (track, sector) in seen:
+                raise ValueError(f"Block chain loops at {track}/{sector}")
+            seen.add((track, sector))
+            block = self.block(track, sector)
+            yield track, sector, block
+            track, sector = block[0], block[1]
+
+    def directory(self) -> Iterator[DirectoryEntry]:
+        """Yield every used directory entry."""
+        for _, _, block in self.chain(self.geometry.directory_track,
+                                      self.geometry.directory_sector):
+            for i in range(ENTRIES_PER_SECTOR):
+                entry = block[i * ENTRY_SIZE:(i + 1) * ENTRY_SIZE]
+                if entry[2] == 0:
+                    continue
+                yield DirectoryEntry(
+                    file_type=entry[2],
+                    name=entry[5:21].rstrip(bytes([FILENAME_PAD])),
+                    track=entry[3], sector=entry[4],
+                    side_track=entry[21], side_sector=entry[22],
+                    record_length=entry[23],
+                    blocks=entry[30] | (entry[31] << 8))
+
+    def find_file(self, name: bytes) -> Optional[DirectoryEntry]:
+        """Find a directory entry by file name."""
+        for entry in self.directory():
+            if entry.name == name:
+                return entry
+        return None
+
+    def file_blocks(self, name: bytes) -> List[Tuple[int, int]]:
+        """Return the (track, sector) of every block of a file, in order."""
+        entry = self.find_file(name)
+        if entry is None:
+            raise FileNotFoundError(name.decode('ascii', 'replace'))
+        return [(track, sector) for track, sector, _
+                in self.chain(entry.track, entry.sector)]
+
+    def read_file(self, name: bytes) -> bytes:
+        """Return a sequential file's contents, as LOAD would read them."""
+        data = bytearray()
+        for track, sector in self.file_blocks(name):
+            block = self.block(track, sector)
+            data += block[2:] if block[0] else block[2:block[1] + 1]
+        return bytes(data)
+
+    def rel_side_sectors(self, name: bytes) -> List[Tuple[int, int]]:
+        """Return the (track, sector) of every side sector of a REL file.
+
+        Side sector N lists data blocks 120 * N to 120 * N + 119. A 1581
+        super side sector ahead of them is not included.
+        """
+        return [(track, sector) for track, sector, _
+                in self._side_sector_chain(name)]
+
+    def rel_record_map(self, name: bytes) -> List[Tuple[int, int]]:
+        """Return the (track, sector) of every data block of a REL file.
+
+        Reads side sectors exactly as the C64 does in direct access mode.
+        With 254-byte records, data block N holds record N.
+        """
+        blocks = []
+        for _, _, side in self._side_sector_chain(name):
+            for i in range(SIDE_SECTOR_ENTRIES):
+                offset = SIDE_SECTOR_DATA_OFFSET + 2 * i
+                track, sector = side[offset], side[offset + 1]
+                if track == 0:
+                    break
+                blocks.append((track, sector))
+        return blocks
+
+    def _side_sector_chain(self, name: bytes) -> Iterator[Tuple[int, int, bytes]]:
+        """Follow a REL file's side sectors, skipping any super side sector.
+
+        The 1581 links its super side sector to the first side sector, and
+        every side sector to the next across groups.
+        """
+        entry = self._rel_entry(name)
+        for track, sector, block in self.chain(entry.side_track,
+                                               entry.side_sector):
+            if block[SIDE_SECTOR_NUMBER] != SUPER_SIDE_SECTOR:
+                yield track, sector, block
+
+    def _rel_entry(self, name: bytes) -> DirectoryEntry:
+        """Find the directory entry of a REL file."""
+        entry = self.find_file(name)
+        if entry is None:
+            raise FileNotFoundError(name.decode('ascii', 'replace'))
+        if entry.file_type & FILE_TYPE_MASK != FILE_TYPE_REL:
+            raise ValueError(f"{name!r} is not a REL file")
+        return entry
+
+    def read_blocks(self, blocks: List[Tuple[int, int]]) -> bytes:
+        """Concatenate the data bytes (2-255) of a list of blocks."""
+        return b''.join(self.block(track, sector)[2:]
+                        for track, sector in blocks)
@@ -0,0 +1,391 @@
+#!/usr/bin/env python3
+"""
+Replay a corpus through the disk access simulator and compare configurations.
+
+Copyright (c) 2025 John Byrd
+https://github.com/johnwbyrd/bloomer
+
+SPDX-License-Identifier: BSD-3-Clause
+"""
+import argparse
+import os
+import sys
+from collections import Counter
+from pathlib import Path
+from typing import Dict, List, Optional, Tuple
+
+from disk_geometry import DiskGeometry
+from bloom_config import BloomConfig, HASH_SCHEMES, LAYOUTS
+from memory_map import MemoryMap
+from runtime_config import ACCESS_DRIVE, ACCESS_MODES, RuntimeConfig
+from bloom_filter import BloomFilter
+from scowl_downloader import SCOWLDownloader
+from scowl_parser import SCOWLParser
+from common_words import CommonWordTable, read_corpus
+from hot_records import HotRecordSelector
+from word_frequency import WordFrequency
+from d64_image import D64Image
+from disk_creator import BOOT_NAME, PROGRAM_NAME
+from disk_simulator import (DiskAccessSimulator, DriveTiming, JIFFYDOS_TIMING,
+                            drive_upload_ms, program_load_ms,
+                            record_interval_ms)
+from fastloader import DRIVE_CODE, DRIVE_WRITE_CHUNK
+from golomb_set import C64_CYCLES_PER_MS
+from kernel_generator import LookupKernelGenerator
+from prg_cruncher import is_crunched, unpack_cycles
+from rel_layout import (BlockAllocator, Interleave, RelFileWriter,
+                        plan_rel_blocks)
+from record_remap import RecordRemap
+from word_hashes import WordHashes
+from build_bloom import (ARTIFACTS_DIR, BUILD_CONFIG, CACHE_DIR, DISK_CONFIG,
+                         FILTER_CONFIG, RUNTIME_CONFIG, SCOWL_CONFIG,
+                         WORD_LIST_CACHE, disk_geometry)
+
+# Preload sets: nothing, the build's SCOWL frequency proxy, or the hottest
+# records of the corpus itself (an upper bound no real build can reach)
+PRELOAD_NONE = 'none'
+PRELOAD_HOT = 'hot'
+PRELOAD_CORPUS = 'corpus'
+PRELOAD_SETS = (PRELOAD_NONE, PRELOAD_HOT, PRELOAD_CORPUS)
+
+# Record placement: as hashed, hottest first by the SCOWL proxy, or hottest
+# first by the corpus itself
+PLACEMENT_IDENTITY = 'identity'
+PLACEMENT_HEAT = 'heat'
+PLACEMENT_CORPUS = 'corpus'
+PLACEMENTS = (PLACEMENT_IDENTITY, PLACEMENT_HEAT, PLACEMENT_CORPUS)
+
+# Serial bus: the stock KERNAL, or JiffyDOS at both ends
+BUS_KERNAL = 'kernal'
+BUS_JIFFYDOS = 'jiffydos'
+BUSES = {BUS_KERNAL: DriveTiming(), BUS_JIFFYDOS: JIFFYDOS_TIMING}
+
+# Interleaves: the image as built, matched to the access mode, or a number
+INTERLEAVE_IMAGE = 'image'
+INTERLEAVE_AUTO = 'auto'
+
+DOS_INTERLEAVE = Interleave(sectors=10)  # What the DOS gives a SAVEd program
+
+
+def parse_args() -> argparse.Namespace:
+    """Parse the command line; every list option multiplies the comparison."""
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('corpus', type=Path,
+                        help="word list or text file to replay, in order")
+    parser.add_argument('--d64', type=Path,
+                        help="disk image whose BLOOM.DAT layout to use "
+                             "(default: the last build's)")
+    parser.add_argument('--layout', nargs='+', choices=LAYOUTS,
+                        default=[FILTER_CONFIG['layout']])
+    parser.add_argument('-k', '--hash-functions', nargs='+', type=int,
+                        default=[FILTER_CONFIG['num_hash_functions']])
+    parser.add_argument('--hash-scheme', nargs='+', choices=HASH_SCHEMES,
+                        default=[FILTER_CONFIG['hash_scheme']])
+    parser.add_argument('--access', nargs='+', choices=ACCESS_MODES,
+                        default=[RUNTIME_CONFIG['access']])
+    parser.add_argument('--bus', nargs='+', choices=BUSES,
+                        default=[BUS_KERNAL],
+                        help="serial bus speeds to compare")
+    parser.add_argument('--cache', nargs='+', type=int,
+                        help="cache slots (default: what the build compiles in)")
+    parser.add_argument('--preload', nargs='+', choices=PRELOAD_SETS,
+                        default=[PRELOAD_HOT])
+    parser.add_argument('--interleave', nargs='+', default=[INTERLEAVE_IMAGE],
+                        help="BLOOM.DAT sector gaps to re-lay the image with: "
+                             "image, auto or a sector count")
+    parser.add_argument('--placement', nargs='+', choices=PLACEMENTS,
+                        default=[PLACEMENT_IDENTITY, PLACEMENT_HEAT],
+                        help="record orders to compare (BLOOM.DAT is re-laid "
+                             "over the same blocks)")
+    parser.add_argument('--common-words', type=int,
+                        default=RUNTIME_CONFIG['common_words'],
+                        help="common-word table size; 0 = off")
+    parser.add_argument('--recent-words', type=int,
+                        default=RUNTIME_CONFIG['recent_words'],
+                        help="recently checked words remembered; 0 = off")
+    return parser.parse_args()
+
+
+class CorpusBenchmark:
+    """Build each filter configuration once and replay the corpus against it."""
+
+    def __init__(self, args: argparse.Namespace, corpus: List[str]):
+        self.args = args
+        self.corpus = corpus
+        self.geometry = disk_geometry()
+        self.downloader = SCOWLDownloader(CACHE_DIR)
+        self.words = SCOWLParser().parse(
+            self.downloader.download(SCOWL_CONFIG, WORD_LIST_CACHE))
+        self._weighted: Optional[List[Tuple[str, float]]] = None
+
+        image = D64Image.load(args.d64, self.geometry)
+        self.image = image
+        self.record_map = image.rel_record_map(b'BLOOM.DAT')
+        self.side_sectors = image.rel_side_sectors(b'BLOOM.DAT')
+        self.free_blocks = (RelFileWriter(bytearray(image.data),
+                                          self.geometry).free_blocks() +
+                            self.record_map + self.side_sectors)
+        tracks = sorted({track for track, _ in self.record_map})
+        print(f"Layout from {args.d64}: {len(self.record_map)} records on "
+              f"tracks {tracks[0]}-{tracks[-1]}, "
+              f"{len(self.side_sectors)} side sectors")
+        print(f"Corpus {args.corpus}: {len(corpus):,} words, "
+              f"{len(set(corpus)):,} distinct")
+
+    @property
+    def weighted_words(self) -> List[Tuple[str, float]]:
+        """SCOWL frequency proxy, downloaded only when first needed."""
+        if self._weighted is None:
+            frequency = WordFrequency(self.downloader, SCOWL_CONFIG, CACHE_DIR)
+            self._weighted = frequency.load(RUNTIME_CONFIG['preload_sizes'])
+        return self._weighted
+
+    def print_startup(self):
+        """Program load times: spellcheck.prg as SAVEd, against the image.
+
+        The image may store the program packed and may start it from
+        BOOT; unpacking is charged to it too. For comparison the build's
+        program is laid out with the DOS interleave on an empty disk.
+        """
+        prg_path = ARTIFACTS_DIR / 'spellcheck.prg'
+        saved = self._saved_blocks(prg_path) if prg_path.exists() else None
+        program = self.image.read_file(PROGRAM_NAME)
+        blocks = self.image.file_blocks(PROGRAM_NAME)
+        boot = self.image.find_file(BOOT_NAME) is not None
+        unpack_ms = 0.0
+        if is_crunched(program):
+            unpack_ms = unpack_cycles(program) / C64_CYCLES_PER_MS
+        how = ("BOOT fastloading" if boot else "LOAD of") + " SPELLCHECK"
+        if unpack_ms:
+            how += f" and unpacking ({unpack_ms / 1000:.1f} s)"
+
+        for bus in self.args.bus:
+            timing = BUSES[bus]
+            if saved:
+                before = program_load_ms(self.geometry, saved, timing=timing)
+                print(f"Startup ({bus}): LOAD of {prg_path.name}, "
+                      f"{len(saved)} blocks: {before / 1000:.1f} s")
+            if boot:
+                after = (program_load_ms(self.geometry,
+                                         self.image.file_blocks(BOOT_NAME),
+                                         timing=timing) +
+                         drive_upload_ms(len(DRIVE_CODE), DRIVE_WRITE_CHUNK,
+                                         timing) +
+                         program_load_ms(self.geometry, blocks, True, timing))
+            else:
+                after = program_load_ms(self.geometry, blocks, timing=timing)
+            after += unpack_ms
+            change = f", {before / after:.1f}x as fast" if saved else ""
+            print(f"Startup ({bus}): {how}, {len(blocks)} blocks: "
+                  f"{after / 1000:.1f} s{change}")
+
+    def _saved_blocks(self, prg_path: Path) -> List[Tuple[int, int]]:
+        """Where the DOS would SAVE the program on an empty disk."""
+        empty = [(track, sector)
+                 for track in range(1, self.geometry.tracks + 1)
+                 if self.geometry.is_data_track(track)
+                 for sector in range(self.geometry.sectors_per_track(track))]
+        size = self.geometry.rel_record_size
+        return BlockAllocator(self.geometry, empty).allocate(
+            -(-prg_path.stat().st_size // size), DOS_INTERLEAVE)
+
+    def run(self):
+        """Replay every combination and print one row for each."""
+        hash_cycles: Dict[Tuple[str, int], float] = {}
+        for scheme in self.args.hash_scheme:
+            common_table = None
+            if self.args.common_words:
+                common_table = CommonWordTable.select(
+                    self.weighted_words, set(self.words),
+                    self.args.common_words, scheme)
+
+            # Every filter below is built from the same word hashes
+            hashes = WordHashes.cached(self.words, scheme, SCOWL_CONFIG,
+                                       CACHE_DIR, BUILD_CONFIG['jobs'])
+            for layout in self.args.layout:
+                for k in self.args.hash_functions:
+                    # One drive: a striped build is replayed as its first image
+                    config = BloomConfig(geometry=self.geometry, **dict(
+                        FILTER_CONFIG, layout=layout, num_hash_functions=k,
+                        hash_scheme=scheme))
+                    self._print_hash_cost(config, hash_cycles)
+                    self._run_config(config, hashes, common_table)
+
+    def _print_hash_cost(self, config: BloomConfig,
+                         hash_cycles: Dict[Tuple[str, int], float]):
+        """Estimated hashing cost of a corpus word, against the first scheme.
+
+        The disk rows leave it out, as type-ahead hashes most words while
+        they are typed; spellcheck_bench measures the real cost.
+        """
+        kernel = LookupKernelGenerator()
+        cycles = sum(kernel.hash_cycles(config, len(word),
+                                        bool(self.args.common_words))
+                     for word in self.corpus) / len(self.corpus)
+        line = (f"Hashing ({config.hash_scheme}, {config.layout}, "
+                f"k={config.num_hash_functions}): ~{cycles:,.0f} cycles "
+                f"per word (~{cycles / C64_CYCLES_PER_MS:.1f} ms, estimated)")
+        first = hash_cycles.setdefault(
+            (config.layout, config.num_hash_functions), cycles)
+        if first != cycles:
+            line += (f", {first / cycles:.1f}x as fast as "
+                     f"{self.args.hash_scheme[0]}")
+        print(line)
+
+    def _run_config(self, config: BloomConfig, hashes: WordHashes,
+                    common_table: Optional[CommonWordTable]):
+        """Build one filter and replay the corpus under every access mode."""
+        bloom = BloomFilter(config)
+        bloom.build_from_words(self.words, progress_interval=0, hashes=hashes)
+        remaps = {placement: self._remap(bloom, placement, common_table)
+                  for placement in self.args.placement}
+        print(f"{'layout':8} {'k':>2} {'access':8} {'bus':8} "
+              f"{'inter':>5} {'cache':>5} {'preload':7} {'place':8} "
+              f"{'rec/w':>6} {'reads/w':>7} {'trk/w':>6} {'travel/w':>8} "
+              f"{'hit%':>6} {'ram%':>5} {'ms/word':>8} "
+              f"{'start s':>7}")
+        for access in self.args.access:
+            self._run_access(bloom, access, common_table, remaps)
+
+    def _disk_words(self, corpus: bool,
+                    common_table: Optional[CommonWordTable]
+                    ) -> List[Tuple[str, float]]:
+        """Weighted words that reach the disk, as build_bloom.py ranks by."""
+        if corpus:
+            weighted = list(Counter(self.corpus).items())
+        else:
+            weighted = self.weighted_words
+        if common_table:
+            weighted = [(word, weight) for word, weight in weighted
+                        if not common_table.contains(word)]
+        return weighted
+
+    def _remap(self, bloom: BloomFilter, placement: str,
+               common_table: Optional[CommonWordTable]) -> RecordRemap:
+        """Record order for a placement, ranked as build_bloom.py does."""
+        num_records = bloom.config.num_records
+        if placement == PLACEMENT_IDENTITY:
+            return RecordRemap.identity(num_records)
+        weighted = self._disk_words(placement == PLACEMENT_CORPUS, common_table)
+        ranked = HotRecordSelector(bloom, weighted).ranked()
+        return RecordRemap.from_ranking(ranked, num_records)
+
+    def _run_access(self, bloom: BloomFilter, access: str,
+                    common_table: Optional[CommonWordTable],
+                    remaps: Dict[str, RecordRemap]):
+        """Replay one filter under one access mode at every cache size."""
+        config = bloom.config
+        runtime = RuntimeConfig(memory=MemoryMap(), **dict(
+            RUNTIME_CONFIG, access=access,
+            common_words=self.args.common_words,
+            recent_words=self.args.recent_words))
+        try:
+            runtime.validate(config)
+        except ValueError as error:
+            print(f"{config.layout:8} {access:8} skipped: {error}")
+            return
+        if access == ACCESS_DRIVE:
+            cache_sizes, preloads = [0], [PRELOAD_NONE]
+        else:
+            cache_sizes = (self.args.cache or
+                           [runtime.record_cache_slots(config)])
+            preloads = self.args.preload
+
+        for bus in self.args.bus:
+            timing = BUSES[bus]
+            for interleave in self.args.interleave:
+                side_sectors, record_map = self._layout(interleave, access,
+                                                        timing)
+                for slots in cache_sizes:
+                    for preload in preloads:
+                        travel = {}
+                        for placement, remap in remaps.items():
+                            simulator = DiskAccessSimulator(
+                                bloom, record_map, side_sectors, access, slots,
+                                self._preload_records(bloom, preload, slots,
+                                                      common_table),
+                                common_table, timing, remap,
+                                fast_serial=(bus == BUS_JIFFYDOS and
+                                             runtime.fast_serial),
+                                recent_words=self.args.recent_words)
+                            result = simulator.replay(self.corpus)
+                            travel[placement] = result.per_word(result.travel)
+                            self._print_row(config, access, bus, interleave,
+                                            slots, preload, placement,
+                                            simulator)
+                        self._print_travel_change(travel)
+
+    def _print_travel_change(self, travel: Dict[str, float]):
+        """Head travel of each placement relative to the identity layout."""
+        base = travel.get(PLACEMENT_IDENTITY)
+        if not base:
+            return
+        for placement, value in travel.items():
+            if placement != PLACEMENT_IDENTITY:
+                print(f"    {placement}: head travel {(value / base - 1) * 100:+.1f}% "
+                      f"vs {PLACEMENT_IDENTITY}")
+
+    def _layout(self, interleave: str, access: str, timing: DriveTiming
+                ) -> Tuple[List[Tuple[int, int]], List[Tuple[int, int]]]:
+        """Side sectors and record map of BLOOM.DAT under an interleave."""
+        if interleave == INTERLEAVE_IMAGE:
+            return self.side_sectors, self.record_map
+        if interleave == INTERLEAVE_AUTO:
+            gap = Interleave(consume_ms=record_interval_ms(access, timing))
+        else:
+            gap = Interleave(sectors=int(interleave))
+        return plan_rel_blocks(self.geometry, self.free_blocks,
+                               len(self.record_map), gap)
+
+    def _preload_records(self, bloom: BloomFilter, preload: str, slots: int,
+                         common_table: Optional[CommonWordTable]) -> List[int]:
+        """Records streamed into the cache before the replay starts."""
+        if preload == PRELOAD_NONE or not slots:
+            return []
+        weighted = self._disk_words(preload == PRELOAD_CORPUS, common_table)
+        return HotRecordSelector(bloom, weighted).select(slots)
+
+    def _print_row(self, config: BloomConfig, access: str, bus: str,
+                   interleave: str, slots: int, preload: str, placement: str,
+                   simulator: DiskAccessSimulator):
+        result = simulator.result
+        print(f"{config.layout:8} {config.num_hash_functions:>2} {access:8} "
+              f"{bus:8} {interleave:>5} {slots:>5} {preload:7} {placement:8} "
+              f"{result.per_word(result.records):>6.2f} "
+              f"{result.per_word(result.reads):>7.2f} "
+              f"{result.per_word(result.tracks):>6.2f} "
+              f"{result.per_word(result.travel):>8.2f} "
+              f"{result.hit_rate * 100:>6.1f} "
+              f"{result.per_word(result.ram_words) * 100:>5.1f} "
+              f"{result.per_word(result.ms):>8.0f} "
+              f"{simulator.preload_result.ms / 1000:>7.1f}")
+
+
+def main():
+    args = parse_args()
+    corpus = read_corpus(args.corpus)
+    if args.d64:
+        args.d64 = args.d64.resolve()
+
+    # Run from the project directory, like build_bloom.py
+    script_dir = Path(__file__).parent
+    if script_dir.name == 'python':
+        os.chdir(script_dir.parent.parent)
+    if not args.d64:
+        image_type = DiskGeometry.for_drive(DISK_CONFIG['drive']).image_type
+        args.d64 = ARTIFACTS_DIR / f'spellcheck.{image_type}'
+
+    if not corpus:
+        print(f"No words in {args.corpus}")
+        sys.exit(1)
+    if not args.d64.exists():
+        print(f"{args.d64} not found; run build_bloom.py first")
+        sys.exit(1)
+
+    benchmark = CorpusBenchmark(args, corpus)
+    benchmark.print_startup()
+    benchmark.run()
+
+
+if __name__ == '__main__':
+    main()
@@ -7,45 +7,209 @@ https://github.com/johnwbyrd/bloomer
 SPDX-License-Identifier: BSD-3-Clause
 """
 from pathlib import Path
+from typing import List, Optional, Sequence, Tuple
 import d64
+from bloom_config import FIRST_DISK_DEVICE, stripe_records
+from d64_image import D64Image
+from disk_geometry import DiskGeometry
+from fastloader import Fastloader
+from prg_cruncher import PrgCruncher
+from rel_layout import Interleave, RelFileWriter
+
+PROGRAM_NAME = b'SPELLCHECK'
+BOOT_NAME = b'BOOT'
 
 
 class DiskImageCreator:
-    """Create C64 .d64 disk images."""
+    """Create C64 disk images (.d64, .d71 or .d81), one per filter drive."""
+
+    def __init__(self, geometry: DiskGeometry = DiskGeometry()):
+        self.geometry = geometry
+
+    def image_paths(self, output: Path, devices: Sequence[int]) -> List[Path]:
+        """Image file of each device.
+
+        The first drive, which also holds the program, gets output itself;
+        device N after it gets output-N.
+        """
+        return [output] + [output.with_name(f"{output.stem}-{device}"
+                                            f"{output.suffix}")
+                           for device in devices[1:]]
+
+    def create(self, prg_path: Path, bloom_path: Path, output_d64: Path,
+               map_path: Optional[Path] = None,
+               interleave: Interleave = Interleave(sectors=10),
+               devices: Sequence[int] = (FIRST_DISK_DEVICE,),
+               program_interleave: Interleave = Interleave(sectors=10),
+               crunch: bool = False, fastloader: bool = False):
+        """Create disk images with the program and the Bloom filter.
 
-    def create(self, prg_path: Path, bloom_path: Path, output_d64: Path):
-        """Create .d64 disk image with program and Bloom filter."""
-        print(f"Creating disk image: {output_d64}")
-        output_d64.parent.mkdir(parents=True, exist_ok=True)
+        A filter striped across several devices puts every Nth record on
+        each one, in the order of devices. With crunch the program is
+        stored self-unpacking; with fastloader BOOT comes first on the
+        first drive and loads it.
+        """
+        with open(bloom_path, 'rb') as src:
+            stripes = stripe_records(src.read(), self.geometry.rel_record_size,
+                                     len(devices))
+        program = self._program(prg_path, crunch)
+        if fastloader and not self.geometry.job_queue:
+            print("No BOOT fastloader: the drive has no 1541 job queue")
+            fastloader = False
+        if (program and self.program_blocks(len(program), fastloader) >
+                self.geometry.program_sectors):
+            raise RuntimeError(f"{prg_path} does not fit the "
+                               f"{self.geometry.program_sectors} blocks the "
+                               f"filter leaves for it")
 
-        d64.DiskImage.create('d64', output_d64, b'SPELLCHECK', b'SK')
+        record_maps = []
+        paths = self.image_paths(output_d64, devices)
+        for index, (device, path, stripe) in enumerate(zip(devices, paths,
+                                                           stripes)):
+            print(f"Creating disk image for device {device}: {path}")
+            path.parent.mkdir(parents=True, exist_ok=True)
 
-        with d64.DiskImage(output_d64, mode='w') as img:
-            self._add_program(img, prg_path)
-            self._add_bloom_filter(img, bloom_path)
+            d64.DiskImage.create(self.geometry.image_type, path,
+                                 PROGRAM_NAME, b'SK')
+            if index == 0 and program:
+                self._add_program(path, program, program_interleave,
+                                  device if fastloader else None)
+            self._add_bloom_filter(path, stripe, interleave)
 
-        self._print_directory(output_d64)
+            self._print_directory(path)
+            record_maps.append(self.verify_record_map(path, stripe))
+
+        if map_path:
+            self.write_record_map(record_maps, devices, map_path)
         return True
 
-    def _add_program(self, img, prg_path: Path):
-        """Add program file to disk image."""
-        if prg_path.exists():
-            print(f"Adding program: {prg_path} ({prg_path.stat().st_size} bytes)")
-            p = img.path(b'SPELLCHECK')
-            with p.open('w', ftype='prg') as f:
-                with open(prg_path, 'rb') as src:
-                    f.write(src.read())
-        else:
+    def program_blocks(self, program_bytes: int, fastloader: bool) -> int:
+        """Blocks a program_bytes PRG takes on the disk, with BOOT if any."""
+        size = self.geometry.rel_record_size
+        blocks = -(-program_bytes // size)
+        if fastloader and self.geometry.job_queue:
+            blocks += -(-Fastloader.boot_size(PROGRAM_NAME) // size)
+        return blocks
+
+    def stored_program_blocks(self, prg_path: Path, crunch: bool,
+                              fastloader: bool) -> Optional[int]:
+        """Blocks the program and BOOT take as create() would store them."""
+        program = self._program(prg_path, crunch)
+        if program is None:
+            return None
+        return self.program_blocks(len(program), fastloader)
+
+    def record_map(self, d64_path: Path) -> List[Tuple[int, int]]:
+        """Return BLOOM.DAT's record-to-(track, sector) map from its side sectors."""
+        return D64Image.load(d64_path, self.geometry).rel_record_map(b'BLOOM.DAT')
+
+    def verify_record_map(self, d64_path: Path,
+                          expected: bytes) -> List[Tuple[int, int]]:
+        """Check that reading blocks through the map reproduces the image's
+        share of bloom.dat.
+
+        This is the same map the C64 builds at startup in direct access mode.
+        """
+        image = D64Image.load(d64_path, self.geometry)
+        record_map = image.rel_record_map(b'BLOOM.DAT')
+
+        actual = image.read_blocks(record_map)[:len(expected)]
+        if actual != expected:
+            raise RuntimeError(f"BLOOM.DAT blocks in {d64_path} do not "
+                               f"match bloom.dat")
+
+        tracks = sorted({track for track, _ in record_map})
+        print(f"Verified record map: {len(record_map)} records on "
+              f"tracks {tracks[0]}-{tracks[-1]}")
+        return record_map
+
+    def write_record_map(self, record_maps: List[List[Tuple[int, int]]],
+                         devices: Sequence[int], map_path: Path):
+        """Write the record map as CSV for host-side tools.
+
+        Records are numbered as the C64 numbers them, over all drives; the
+        device column only appears when there is more than one.
+        """
+        map_path.parent.mkdir(parents=True, exist_ok=True)
+        striped = len(devices) > 1
+        with open(map_path, 'w') as f:
+            f.write("record,device,track,sector\n" if striped else
+                    "record,track,sector\n")
+            for record in range(sum(len(m) for m in record_maps)):
+                index, local = record % len(devices), record // len(devices)
+                track, sector = record_maps[index][local]
+                if striped:
+                    f.write(f"{record},{devices[index]},{track},{sector}\n")
+                else:
+                    f.write(f"{record},{track},{sector}\n")
+        print(f"Record map written to {map_path}")
+
+    def _program(self, prg_path: Path, crunch: bool) -> Optional[bytes]:
+        """The PRG to store: the program itself, or packed when it saves blocks."""
+        if not prg_path.exists():
             print(f"Warning: Program file {prg_path} not found")
+            return None
+        with open(prg_path, 'rb') as src:
+            program = src.read()
+        if not crunch:
+            return program
+
+        size = self.geometry.rel_record_size
+        crunched = PrgCruncher().crunch(program)
+        blocks, packed_blocks = (-(-len(program) // size),
+                                 -(-len(crunched.prg) // size))
+        print(f"Crunched {prg_path.name}: {len(program):,} -> "
+              f"{len(crunched.prg):,} bytes ({crunched.ratio:.0%}), "
+              f"{blocks} -> {packed_blocks} blocks, unpacks in "
+              f"{crunched.unpack_cycles / 1e6:.1f}M cycles")
+        if packed_blocks >= blocks:
+            print("Storing the program unpacked: packing saves no blocks")
+            return program
+        return crunched.prg
+
+    def _add_program(self, output_d64: Path, program: bytes,
+                     interleave: Interleave, boot_device: Optional[int]):
+        """Add the program, and BOOT to load it from boot_device, if any.
+
+        The program's blocks are written first, since BOOT carries the
+        first one's track and sector, but BOOT takes the first directory
+        slot so that LOAD"*",8 finds it.
+        """
+        print(f"Adding program: {len(program)} bytes, "
+              f"interleave {interleave.describe()}")
+        with open(output_d64, 'rb') as f:
+            image = bytearray(f.read())
+        writer = RelFileWriter(image, self.geometry)
+        blocks = writer.write_program(PROGRAM_NAME, program, interleave,
+                                      directory=boot_device is None)
+        if boot_device is not None:
+            boot = Fastloader(boot_device).boot_program(program, blocks[0],
+                                                        PROGRAM_NAME)
+            print(f"Adding fastloader: {BOOT_NAME.decode()}, "
+                  f"{len(boot)} bytes")
+            writer.write_program(BOOT_NAME, boot, Interleave(sectors=10))
+            writer.add_program_entry(PROGRAM_NAME, blocks)
+        with open(output_d64, 'wb') as f:
+            f.write(image)
+        if D64Image(bytes(image), self.geometry).read_file(PROGRAM_NAME) != program:
+            raise RuntimeError(f"{PROGRAM_NAME.decode()} in {output_d64} does "
+                               f"not match the program")
+
+    def _add_bloom_filter(self, output_d64: Path, data: bytes,
+                          interleave: Interleave):
+        """Add Bloom filter as REL file to disk image.
 
-    def _add_bloom_filter(self, img, bloom_path: Path):
-        """Add Bloom filter as REL file to disk image."""
-        print(f"Adding Bloom filter: {bloom_path} "
-              f"({bloom_path.stat().st_size} bytes)")
-        p = img.path(b'BLOOM.DAT')
-        with p.open('w', ftype='rel', record_len=254) as f:
-            with open(bloom_path, 'rb') as src:
-                f.write(src.read())
+        The blocks are placed directly in the image rather than through the
+        d64 library, so consecutive records follow the chosen interleave.
+        """
+        print(f"Adding Bloom filter: {len(data)} bytes, "
+              f"interleave {interleave.describe()}")
+        with open(output_d64, 'rb') as f:
+            image = bytearray(f.read())
+        RelFileWriter(image, self.geometry).write(b'BLOOM.DAT', data,
+                                                  interleave)
+        with open(output_d64, 'wb') as f:
+            f.write(image)
 
     def _print_directory(self, output_d64: Path):
         """Print disk directory listing."""
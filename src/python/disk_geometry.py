@@ -1,35 +1,174 @@
 """
-C1541 disk geometry calculations for Bloom filter sizing.
+CBM disk geometry calculations for Bloom filter sizing.
 
 Copyright (c) 2025 John Byrd
 https://github.com/johnwbyrd/bloomer
 
 SPDX-License-Identifier: BSD-3-Clause
 """
-from dataclasses import dataclass
+from dataclasses import dataclass, replace
+from typing import Tuple
+
+# Drive models with a geometry profile
+DRIVE_1541 = '1541'
+DRIVE_1571 = '1571'
+DRIVE_1581 = '1581'
+DRIVES = (DRIVE_1541, DRIVE_1571, DRIVE_1581)
+
+# (first track, sectors per track) for each speed zone. The 1571's second
+# side repeats the 1541 zones from track 36; the 1581 has no zones.
+ZONES_1541 = ((1, 21), (18, 19), (25, 18), (31, 17))
+SIDE_TRACKS_1571 = 35
+ZONES_1571 = ZONES_1541 + tuple((track + SIDE_TRACKS_1571, sectors)
+                                for track, sectors in ZONES_1541)
+ZONES_1581 = ((1, 40),)
+
+SIDE_SECTOR_ENTRIES = 120  # Data blocks listed by one REL side sector
+SIDE_SECTOR_GROUP = 6      # Side sectors a directory entry (or group) reaches
+SUPER_SIDE_GROUPS = 126    # Groups a 1581 super side sector can list
+
+# BAM layout: the 1541 keeps four bytes per track (free count, then a
+# bitmap) from offset 4 of 18/0. The 1571 keeps its second side's counts
+# at the end of 18/0 and their bitmaps, three bytes per track, in 53/0. The
+# 1581 keeps six bytes per track from offset 16 of 40/1 and 40/2.
+BAM_ENTRY_OFFSET = 4
+BAM_ENTRY_SIZE = 4
+BAM_1571_COUNT_OFFSET = 0xDD
+BAM_1571_TRACK = 53
+BAM_1571_BITMAP_SIZE = 3
+BAM_1581_ENTRY_OFFSET = 16
+BAM_1581_ENTRY_SIZE = 6
+BAM_1581_TRACKS_PER_SECTOR = 40
 
 
 @dataclass(frozen=True)
 class DiskGeometry:
-    """Immutable C1541 disk geometry configuration."""
+    """Immutable CBM disk geometry configuration (a 1541 by default)."""
 
+    drive: str = DRIVE_1541
     total_sectors: int = 683
-    directory_sectors: int = 19
-    program_sectors: int = 20
-    rel_overhead_sectors: int = 15
+    directory_sectors: int = 19        # Whole tracks the DOS keeps for itself
+    program_sectors: int = 0           # BOOT and the program; see with_program()
     bytes_per_sector: int = 256
     rel_record_size: int = 254
+    tracks: int = 35
+    directory_track: int = 18
+    directory_sector: int = 1          # First directory block
+    speed_zones: Tuple[Tuple[int, int], ...] = ZONES_1541
+    reserved_tracks: Tuple[int, ...] = ()  # DOS tracks besides the directory's
+    super_side_sector: bool = False    # REL files start with a super side sector
+    job_queue: bool = True             # 1541 job queue: codes at $00, buffers at $0300
+    image_type: str = 'd64'
+
+    @classmethod
+    def for_drive(cls, drive: str) -> 'DiskGeometry':
+        """Geometry profile of a drive model."""
+        if drive == DRIVE_1541:
+            return cls()
+        if drive == DRIVE_1571:
+            return cls(drive=drive, total_sectors=1366, directory_sectors=38,
+                       tracks=70, speed_zones=ZONES_1571,
+                       reserved_tracks=(BAM_1571_TRACK,), image_type='d71')
+        if drive == DRIVE_1581:
+            return cls(drive=drive, total_sectors=3200, directory_sectors=40,
+                       tracks=80, directory_track=40,
+                       directory_sector=3, speed_zones=ZONES_1581,
+                       super_side_sector=True, job_queue=False,
+                       image_type='d81')
+        raise ValueError(f"Unknown drive: {drive} (choose from "
+                         f"{', '.join(DRIVES)})")
+
+    def with_program(self, sectors: int) -> 'DiskGeometry':
+        """The same disk with sectors kept for BOOT and the program."""
+        geometry = replace(self, program_sectors=sectors)
+        if geometry.bloom_records < 1:
+            raise ValueError(f"A {sectors}-block program leaves no room for "
+                             f"the filter on a {self.drive} disk")
+        return geometry
+
+    def sectors_per_track(self, track: int) -> int:
+        """Number of sectors on a track (1-based)."""
+        if not 1 <= track <= self.tracks:
+            raise ValueError(f"Track {track} out of range 1-{self.tracks}")
+        for first_track, sectors in reversed(self.speed_zones):
+            if track >= first_track:
+                return sectors
+        raise AssertionError("unreachable")
+
+    def sector_index(self, track: int, sector: int) -> int:
+        """Linear block number of a track/sector pair, as laid out in an image."""
+        if not 0 <= sector < self.sectors_per_track(track):
+            raise ValueError(f"Sector {sector} out of range on track {track}")
+        return sum(self.sectors_per_track(t) for t in range(1, track)) + sector
+
+    def is_data_track(self, track: int) -> bool:
+        """True if files may use the track."""
+        return (track != self.directory_track and
+                track not in self.reserved_tracks)
+
+    def bam_location(self, track: int) -> Tuple[Tuple[int, int], int,
+                                                 Tuple[int, int], int]:
+        """Where the BAM keeps a track's free count and its bitmap.
+
+        Returns (count block, count offset, bitmap block, bitmap offset),
+        with blocks as (track, sector).
+        """
+        if self.drive == DRIVE_1581:
+            block = (self.directory_track,
+                     1 + (track - 1) // BAM_1581_TRACKS_PER_SECTOR)
+            offset = (BAM_1581_ENTRY_OFFSET + BAM_1581_ENTRY_SIZE *
+                      ((track - 1) % BAM_1581_TRACKS_PER_SECTOR))
+            return block, offset, block, offset + 1
+        header = (self.directory_track, 0)
+        if self.drive == DRIVE_1571 and track > SIDE_TRACKS_1571:
+            index = track - SIDE_TRACKS_1571 - 1
+            return (header, BAM_1571_COUNT_OFFSET + index,
+                    (BAM_1571_TRACK, 0), BAM_1571_BITMAP_SIZE * index)
+        offset = BAM_ENTRY_OFFSET + BAM_ENTRY_SIZE * (track - 1)
+        return header, offset, header, offset + 1
+
+    @property
+    def max_side_sectors(self) -> int:
+        """Side sectors one REL file can have."""
+        if self.super_side_sector:
+            return SIDE_SECTOR_GROUP * SUPER_SIDE_GROUPS
+        return SIDE_SECTOR_GROUP
 
     @property
     def available_sectors(self) -> int:
-        """Calculate sectors available for Bloom filter data."""
+        """Calculate sectors available for BLOOM.DAT, side sectors included."""
         return (self.total_sectors - self.directory_sectors -
-                self.program_sectors - self.rel_overhead_sectors)
+                self.program_sectors)
+
+    @property
+    def rel_data_sectors(self) -> int:
+        """Data blocks BLOOM.DAT can have once its side sectors are counted.
+
+        Each side sector lists SIDE_SECTOR_ENTRIES data blocks, and a 1581
+        REL file starts with a super side sector as well.
+        """
+        sectors = self.available_sectors - int(self.super_side_sector)
+        return sectors * SIDE_SECTOR_ENTRIES // (SIDE_SECTOR_ENTRIES + 1)
+
+    @property
+    def rel_side_sectors(self) -> int:
+        """Side sectors (and super side sector) BLOOM.DAT needs."""
+        records = self.bloom_records * self.rel_record_size
+        blocks = -(-records // (self.bytes_per_sector - 2))
+        return (-(-blocks // SIDE_SECTOR_ENTRIES) +
+                int(self.super_side_sector))
 
     @property
     def bloom_records(self) -> int:
-        """Calculate number of REL records for Bloom filter."""
-        return self.available_sectors * self.bytes_per_sector // self.rel_record_size
+        """Calculate number of REL records for Bloom filter.
+
+        A data block carries 254 bytes after its link. A REL file without
+        a super side sector is limited to SIDE_SECTOR_GROUP side sectors,
+        which caps the 1571 well short of its free space.
+        """
+        records = (self.rel_data_sectors * (self.bytes_per_sector - 2) //
+                   self.rel_record_size)
+        return max(0, min(records, self.max_side_sectors * SIDE_SECTOR_ENTRIES))
 
     @property
     def bloom_size_bytes(self) -> int:
@@ -44,17 +183,22 @@ class DiskGeometry:
     def print_summary(self):
         """Print disk geometry summary."""
         print("=" * 80)
-        print("C1541 DISK GEOMETRY")
+        print(f"C{self.drive} DISK GEOMETRY")
         print("=" * 80)
         print(f"Total disk sectors: {self.total_sectors}")
         print(f"  - Directory/BAM: {self.directory_sectors} sectors")
-        print(f"  - Program file: {self.program_sectors} sectors")
-        print(f"  - REL side sectors: {self.rel_overhead_sectors} sectors")
-        print(f"  = Available: {self.available_sectors} sectors")
+        print(f"  - BOOT and program: {self.program_sectors} sectors")
+        print(f"  - REL side sectors: {self.rel_side_sectors} sectors")
+        print(f"  = Available: {self.rel_data_sectors} sectors")
         print()
         print(f"REL record size: {self.rel_record_size} bytes (CBM DOS max)")
-        print(f"Records: {self.available_sectors} × {self.bytes_per_sector} ÷ "
-              f"{self.rel_record_size} = {self.bloom_records}")
+        records = (self.rel_data_sectors * (self.bytes_per_sector - 2) //
+                   self.rel_record_size)
+        print(f"Records: {self.rel_data_sectors} × "
+              f"{self.bytes_per_sector - 2} ÷ {self.rel_record_size} = {records}")
+        if records > self.bloom_records:
+            print(f"  Limited to {self.bloom_records} by "
+                  f"{self.max_side_sectors} side sectors per REL file")
         print()
         print("BLOOM FILTER SIZE")
         print(f"  Bytes: {self.bloom_records} × {self.rel_record_size} = "
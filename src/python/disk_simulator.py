@@ -0,0 +1,444 @@
+"""
+Host-side model of the C64 spell checker's 1541 disk accesses.
+
+Copyright (c) 2025 John Byrd
+https://github.com/johnwbyrd/bloomer
+
+SPDX-License-Identifier: BSD-3-Clause
+"""
+from dataclasses import dataclass
+from typing import Dict, Iterable, List, Optional, Sequence, Set, Tuple
+from bloom_filter import BloomFilter
+from common_words import CommonWordTable
+from d64_image import SIDE_SECTOR_ENTRIES
+from disk_geometry import DiskGeometry
+from golomb_set import C64_CYCLES_PER_MS
+from record_remap import RecordRemap
+from runtime_config import (ACCESS_DIRECT, ACCESS_DRIVE, ACCESS_MODES,
+                            ACCESS_REL_BYTE)
+
+# Bytes that cross the serial bus per operation, as sent by spellcheck.c
+STATUS_BYTES = 13        # "00, OK,00,00" and a carriage return
+P_COMMAND_BYTES = 5      # 'P', channel, record low, record high, position
+U1_COMMAND_BYTES = 12    # "U1:3,0,TT,SS"
+BP_COMMAND_BYTES = 7     # "B-P:3,2"
+MW_HEADER_BYTES = 6      # "M-W", address, length
+ME_COMMAND_BYTES = 5     # "M-E", address
+MR_COMMAND_BYTES = 6     # "M-R", address, length
+DRIVE_REQUEST_HEADER = 2  # Result and probe count
+DRIVE_PROBE_BYTES = 4    # Track, sector, byte in block, mask
+DRIVE_MAX_PROBES = 8
+RECORD_SIZE = 254
+ANGLE_SLACK = 1e-9  # So a sector arriving exactly on time costs no extra turn
+
+
+@dataclass(frozen=True)
+class DriveTiming:
+    """Approximate stock 1541 and KERNAL serial bus timings, in milliseconds.
+
+    These are ballpark figures, not measurements. Calibrate them against
+    the C64's own profiling mode ('profile': True) on real hardware.
+    """
+
+    step_ms: float = 12.0         # Head movement per track
+    settle_ms: float = 20.0       # Extra delay after any head movement
+    revolution_ms: float = 200.0  # 300 RPM
+    byte_ms: float = 1.3          # One byte over the serial bus, either way
+    channel_ms: float = 3.0       # CHKIN or CHKOUT, then CLRCHN
+    command_ms: float = 8.0       # DOS parsing and dispatching a command
+    job_ms: float = 2.0           # Drive probe routine between job queue reads
+    fastload_byte_ms: float = 0.7  # One byte from BOOT's drive code
+
+    def seek_ms(self, travel: int) -> float:
+        """Head movement across travel tracks."""
+        return travel * self.step_ms + (self.settle_ms if travel else 0.0)
+
+    def bus_ms(self, num_bytes: int) -> float:
+        """One channel transaction carrying num_bytes."""
+        return self.channel_ms + num_bytes * self.byte_ms
+
+
+# A JiffyDOS KERNAL and drive move bytes several times faster over the
+# same KERNAL calls. As ballpark as the stock figures.
+JIFFYDOS_TIMING = DriveTiming(byte_ms=0.2)
+
+
+def record_interval_ms(access: str, timing: DriveTiming = DriveTiming()) -> float:
+    """C64 time between two block reads while sweeping uncached records.
+
+    This is what a block's interleave has to cover: finishing one record
+    and issuing the command that reads the next.
+    """
+    record = timing.bus_ms(RECORD_SIZE)
+    if access == ACCESS_DRIVE:
+        return timing.job_ms
+    if access == ACCESS_DIRECT:
+        return (timing.bus_ms(STATUS_BYTES) + timing.bus_ms(BP_COMMAND_BYTES) +
+                timing.command_ms + timing.bus_ms(STATUS_BYTES) + record +
+                timing.bus_ms(U1_COMMAND_BYTES) + timing.command_ms)
+    if access == ACCESS_REL_BYTE:
+        record = timing.bus_ms(1)
+    else:
+        record += timing.bus_ms(STATUS_BYTES)
+    return record + timing.bus_ms(P_COMMAND_BYTES) + timing.command_ms
+
+
+def preload_record_ms(access: str, timing: DriveTiming = DriveTiming()) -> float:
+    """Ballpark C64 time to stream one hot record into the cache at startup.
+
+    On top of the sweep's command and transfer, each record waits, on
+    average, half a revolution for its block.
+    """
+    return record_interval_ms(access, timing) + timing.revolution_ms / 2
+
+
+def sector_wait_ms(sector: int, sectors: int, angle: float, elapsed_ms: float,
+                   timing: DriveTiming) -> float:
+    """Rotation until a sector reaches the head.
+
+    angle is the disk position in revolutions elapsed_ms ago.
+    """
+    angle += elapsed_ms / timing.revolution_ms
+    return (sector / sectors - angle + ANGLE_SLACK) % 1.0 * timing.revolution_ms
+
+
+def program_block_ms(fastload: bool, timing: DriveTiming = DriveTiming()) -> float:
+    """C64 time to take one block of a program: what its interleave covers.
+
+    The drive reads the next block only once the C64 has this one, under
+    LOAD and under BOOT alike. BOOT sends a count byte ahead of the data.
+    """
+    if fastload:
+        return (RECORD_SIZE + 1) * timing.fastload_byte_ms
+    return RECORD_SIZE * timing.byte_ms
+
+
+def program_load_ms(geometry: DiskGeometry, blocks: Sequence[Tuple[int, int]],
+                    fastload: bool = False,
+                    timing: DriveTiming = DriveTiming()) -> float:
+    """Time to load a program stored in blocks, from the LOAD command on.
+
+    Finding the file costs the command and a directory sector read. Each
+    block then costs the head movement, the rotation until it arrives and
+    its transfer, as in DiskAccessSimulator.
+    """
+    head = geometry.directory_track
+    ms = (timing.command_ms + timing.revolution_ms / 2 +
+          timing.revolution_ms / geometry.sectors_per_track(head))
+    angle, angle_ms = None, 0.0
+    for track, sector in blocks:
+        sectors = geometry.sectors_per_track(track)
+        travel = abs(track - head)
+        head = track
+        ms += timing.seek_ms(travel)
+        if travel or angle is None:
+            ms += timing.revolution_ms / 2
+        else:
+            ms += sector_wait_ms(sector, sectors, angle, ms - angle_ms, timing)
+        ms += timing.revolution_ms / sectors
+        angle, angle_ms = (sector + 1) / sectors, ms
+        ms += program_block_ms(fastload, timing)
+    return ms
+
+
+def drive_upload_ms(code_size: int, chunk: int,
+                    timing: DriveTiming = DriveTiming()) -> float:
+    """M-W commands of chunk bytes carrying code_size bytes, then M-E."""
+    ms = timing.bus_ms(ME_COMMAND_BYTES) + timing.command_ms
+    for offset in range(0, code_size, chunk):
+        ms += (timing.bus_ms(MW_HEADER_BYTES + min(chunk, code_size - offset)) +
+               timing.command_ms)
+    return ms
+
+
+class ClockCache:
+    """The C64 record cache: free slots first, then CLOCK eviction.
+
+    The cache of recently checked words works the same way, with words
+    in place of records.
+    """
+
+    def __init__(self, slots: int):
+        self.slots = slots
+        self.records: List[int] = []
+        self.referenced: List[bool] = []
+        self.slot_of: Dict[int, int] = {}
+        self.hand = 0
+
+    def lookup(self, record: int) -> bool:
+        """True on a hit, which also sets the slot's reference bit."""
+        slot = self.slot_of.get(record)
+        if slot is None:
+            return False
+        self.referenced[slot] = True
+        return True
+
+    def insert(self, record: int):
+        """Load a record, evicting one if the cache is full."""
+        if not self.slots:
+            return
+        if len(self.records) < self.slots:
+            slot = len(self.records)
+            self.records.append(record)
+            self.referenced.append(True)
+        else:
+            while self.referenced[self.hand]:
+                self.referenced[self.hand] = False
+                self.hand = (self.hand + 1) % self.slots
+            slot = self.hand
+            self.hand = (self.hand + 1) % self.slots
+            del self.slot_of[self.records[slot]]
+            self.records[slot] = record
+            self.referenced[slot] = True
+        self.slot_of[record] = slot
+
+
+@dataclass
+class BenchmarkResult:
+    """Totals for one corpus replay."""
+
+    words: int = 0
+    ram_words: int = 0         # Answered by the common or recent words
+    accepted: int = 0
+    records: int = 0           # Distinct records probed, summed over words
+    reads: int = 0             # Blocks read by the drive mechanism
+    tracks: int = 0            # Distinct tracks read, summed over words
+    travel: int = 0            # Head movement in tracks
+    hits: int = 0
+    misses: int = 0
+    ms: float = 0.0
+
+    def per_word(self, total: float) -> float:
+        """Average of a total over every replayed word."""
+        return total / self.words if self.words else 0.0
+
+    @property
+    def hit_rate(self) -> float:
+        """Fraction of record lookups served by the C64 cache."""
+        lookups = self.hits + self.misses
+        return self.hits / lookups if lookups else 0.0
+
+
+class DiskAccessSimulator:
+    """Replay lookups against a built filter and the real BLOOM.DAT layout.
+
+    Follows the C64 program's access pattern for each access mode: probes
+    sorted by record, the record cache and preload, early exit at the first
+    clear bit, and the drive's own buffers. The REL modes pay for side
+    sector reads whenever a record lives under a different side sector
+    than the last one; direct and drive modes never touch them.
+
+    Rotation is tracked while the head stays on one track, so interleave
+    shows up in the times. After a step, or between words while the user
+    types, the disk position is unknown and a read waits half a turn.
+    The startup preload is replayed too, into preload_result.
+
+    With a remap, records are stored in BLOOM.DAT in its physical order
+    and every probe is translated before sorting, as the kernel does.
+    Preload records are given as logical records. A Golomb-coded set
+    also charges its estimated decode time to every probe.
+
+    fast_serial replays a session where the program found JiffyDOS: rel_byte
+    then caches whole records. Pass JIFFYDOS_TIMING along with it.
+
+    recent_words remembers the results of that many recently checked
+    words, so a repeated word is answered without probing.
+    """
+
+    def __init__(self, bloom_filter: BloomFilter,
+                 record_map: Sequence[Tuple[int, int]],
+                 side_sectors: Sequence[Tuple[int, int]], access: str,
+                 cache_slots: int, preload: Iterable[int] = (),
+                 common_table: Optional[CommonWordTable] = None,
+                 timing: DriveTiming = DriveTiming(),
+                 remap: Optional[RecordRemap] = None,
+                 fast_serial: bool = False, recent_words: int = 0):
+        if access not in ACCESS_MODES:
+            raise ValueError(f"Unknown disk access mode: {access}")
+        if len(record_map) < bloom_filter.config.num_records:
+            raise ValueError("Record map is shorter than the filter")
+        self.filter = bloom_filter
+        self.record_map = record_map
+        self.side_sectors = side_sectors
+        self.access = access
+        self.timing = timing
+        self.fast_serial = fast_serial
+        self.common_table = common_table
+        self.geometry = bloom_filter.config.geometry
+        self.remap = remap
+        self.data = bloom_filter.data
+        self.decode_ms = 0.0
+        if bloom_filter.gcs is not None:
+            self.decode_ms = bloom_filter.gcs.probe_cycles() / C64_CYCLES_PER_MS
+        if remap is not None:
+            self.data = remap.apply(bloom_filter.data, self.geometry.rel_record_size)
+            preload = [remap.physical(record) for record in preload]
+
+        if access == ACCESS_DRIVE:
+            cache_slots = 0  # No records reach C64 RAM
+        self.cache = ClockCache(cache_slots)
+        self.recent = ClockCache(recent_words)
+        self.recent_results: Dict[str, bool] = {}
+
+        self.head = self.geometry.directory_track  # Where opening BLOOM.DAT leaves it
+        self.rel_side: Optional[int] = None     # Side sector in the DOS buffer
+        self.rel_record: Optional[int] = None   # Data block in the DOS buffer
+        self.drive_block: Optional[Tuple[int, int]] = None  # Drive buffer 1
+        self._angle: Optional[float] = None     # Revolutions, at _angle_ms
+        self._angle_ms = 0.0
+        self._word_tracks: Set[int] = set()
+
+        # Like cache_preload(), stream the records in ascending order
+        self.result = BenchmarkResult()
+        for record in sorted(preload)[:cache_slots]:
+            self._load_record(record)
+            self.cache.insert(record)
+            self.result.misses += 1
+            self.result.records += 1
+        self.preload_result = self.result
+        self.result = BenchmarkResult()
+
+    def replay(self, words: Iterable[str]) -> BenchmarkResult:
+        """Check every word in order and return the running totals."""
+        for word in words:
+            self.check(word)
+        return self.result
+
+    def check(self, word: str) -> bool:
+        """Check one word, accumulating its cost into self.result."""
+        result = self.result
+        result.words += 1
+        if self.common_table is not None and self.common_table.contains(word):
+            result.ram_words += 1
+            result.accepted += 1
+            return True
+        if self.recent.lookup(word):
+            result.ram_words += 1
+            result.accepted += self.recent_results[word]
+            return self.recent_results[word]
+
+        self._word_tracks = set()
+        self._angle = None
+        probes = self.filter.probes_for_word(word)
+        if self.remap is not None:
+            probes = sorted(((self.remap.physical(record), byte, mask)
+                             for record, byte, mask in probes),
+                            key=lambda probe: probe[0])
+        if self.access == ACCESS_DRIVE:
+            records, accepted = self._drive_check(probes)
+        else:
+            records, accepted = self._cached_check(probes)
+
+        result.records += len(records)
+        result.tracks += len(self._word_tracks)
+        result.accepted += accepted
+        self.recent.insert(word)
+        self.recent_results[word] = accepted
+        return accepted
+
+    def _read_block(self, track: int, sector: int):
+        """Move the head, wait for the sector and read it."""
+        timing = self.timing
+        sectors = self.geometry.sectors_per_track(track)
+        travel = abs(track - self.head)
+        self.head = track
+        self._word_tracks.add(track)
+        self.result.reads += 1
+        self.result.travel += travel
+        self.result.ms += timing.seek_ms(travel)
+
+        if travel or self._angle is None:
+            wait = timing.revolution_ms / 2
+        else:
+            wait = sector_wait_ms(sector, sectors, self._angle,
+                                  self.result.ms - self._angle_ms, timing)
+        self.result.ms += wait + timing.revolution_ms / sectors
+        self._angle = (sector + 1) / sectors
+        self._angle_ms = self.result.ms
+
+    def _cached_check(self, probes: List[Tuple[int, int, int]]
+                      ) -> Tuple[Set[int], bool]:
+        """Probe through the C64 record cache (rel, rel_byte, direct).
+
+        A binary fuse filter reads every probe before it can answer.
+        """
+        timing = self.timing
+        records = set()
+        for probe in probes:
+            record = probe[0]
+            records.add(record)
+            if self.cache.lookup(record):
+                self.result.hits += 1
+            else:
+                self.result.misses += 1
+                if self.access == ACCESS_REL_BYTE and not self.fast_serial:
+                    self._rel_position(record)
+                    self.result.ms += timing.bus_ms(1)
+                else:
+                    self._load_record(record)
+                    self.cache.insert(record)
+            self.result.ms += self.decode_ms
+            if (not self.filter.config.is_fuse and
+                    not self.filter.probe_hit(self.data, probe)):
+                return records, False
+        if self.filter.config.is_fuse:
+            return records, self.filter.probes_pass(self.data, probes)
+        return records, True
+
+    def _rel_position(self, record: int):
+        """Send a P command; the DOS reads side sector and block if needed."""
+        self.result.ms += (self.timing.bus_ms(P_COMMAND_BYTES) +
+                           self.timing.command_ms)
+        side = record // SIDE_SECTOR_ENTRIES
+        if side != self.rel_side:
+            self._read_block(*self.side_sectors[side])
+            self.rel_side = side
+        if record != self.rel_record:
+            self._read_block(*self.record_map[record])
+            self.rel_record = record
+
+    def _load_record(self, record: int):
+        """Read a whole record the way bloom_load_record() does."""
+        timing = self.timing
+        if self.access == ACCESS_DIRECT:
+            self.result.ms += timing.bus_ms(U1_COMMAND_BYTES) + timing.command_ms
+            self._read_block(*self.record_map[record])
+            self.result.ms += (timing.bus_ms(STATUS_BYTES) +
+                               timing.bus_ms(BP_COMMAND_BYTES) +
+                               timing.command_ms + timing.bus_ms(STATUS_BYTES))
+        else:
+            self._rel_position(record)
+            self.result.ms += timing.bus_ms(STATUS_BYTES)
+        self.result.ms += timing.bus_ms(RECORD_SIZE)
+
+    def _drive_check(self, probes: List[Tuple[int, int, int]]
+                     ) -> Tuple[Set[int], bool]:
+        """Test bits inside the drive, DRIVE_MAX_PROBES per request."""
+        timing = self.timing
+        records = set()
+        for start in range(0, len(probes), DRIVE_MAX_PROBES):
+            chunk = probes[start:start + DRIVE_MAX_PROBES]
+            self.result.ms += (
+                timing.bus_ms(MW_HEADER_BYTES + DRIVE_REQUEST_HEADER +
+                              DRIVE_PROBE_BYTES * len(chunk)) +
+                timing.bus_ms(ME_COMMAND_BYTES) + timing.command_ms)
+            done = self._drive_run(chunk, records)
+            self.result.ms += timing.bus_ms(MR_COMMAND_BYTES) + timing.bus_ms(1)
+            if not done:
+                return records, False
+        return records, True
+
+    def _drive_run(self, chunk: List[Tuple[int, int, int]],
+                   records: Set[int]) -> bool:
+        """The probe routine: read blocks not already in buffer 1, test bits."""
+        for probe in chunk:
+            record = probe[0]
+            records.add(record)
+            block = self.record_map[record]
+            if block != self.drive_block:
+                self.result.ms += self.timing.job_ms
+                self._read_block(*block)
+                self.drive_block = block
+            if not self.filter.probe_hit(self.data, probe):
+                return False
+        return True
@@ -6,10 +6,30 @@ https://github.com/johnwbyrd/bloomer
 
 SPDX-License-Identifier: BSD-3-Clause
 """
+import math
+import multiprocessing
+import os
 import random
 import string
-from typing import List
+from typing import List, Optional, Tuple
 from bloom_filter import BloomFilter
+from bloom_statistics import print_table
+
+SAMPLES_PER_CHUNK = 50000  # Random words generated and checked per task
+COST_SAMPLES = 2000        # Words and non-words timed for the comparison
+
+# The validator each worker process checks against
+_worker_validator: Optional['EmpiricalValidator'] = None
+
+
+def _init_worker(validator: 'EmpiricalValidator'):
+    global _worker_validator
+    _worker_validator = validator
+
+
+def _validate_chunk(seed: int, count: int,
+                    near_misses: bool) -> Tuple[int, int]:
+    return _worker_validator.validate_chunk(seed, count, near_misses)
 
 
 class EmpiricalValidator:
@@ -17,58 +37,172 @@ class EmpiricalValidator:
 
     def __init__(self, bloom_filter: BloomFilter, dictionary_words: List[str]):
         self.filter = bloom_filter
+        self.words = dictionary_words
         self.word_set = set(dictionary_words)
 
-    def run_validation(self, num_samples: int = 100000) -> dict:
-        """Run empirical validation and return results."""
-        false_positives = 0
-
-        for _ in range(num_samples):
-            random_str = self._generate_random_word()
-
-            # Skip if it happens to be a real word
-            if random_str in self.word_set:
-                continue
-
-            # Check if Bloom filter accepts it (false positive)
-            if self.filter.check(random_str):
-                false_positives += 1
+    def run_validation(self, num_samples: int = 100000,
+                       jobs: Optional[int] = None,
+                       seed: Optional[int] = None,
+                       near_misses: bool = False) -> dict:
+        """Run empirical validation and return results.
+
+        The samples are split into chunks, each drawn from its own seeded
+        generator and checked in one of jobs processes (None = one per
+        CPU), so a given seed gives the same result for any job count.
+        With near_misses the samples are dictionary words with one letter
+        changed instead of random strings.
+        """
+        if seed is None:
+            seed = random.randrange(1 << 32)
+        chunks = [(seed + index, min(SAMPLES_PER_CHUNK, num_samples - start),
+                   near_misses)
+                  for index, start in enumerate(range(0, num_samples,
+                                                      SAMPLES_PER_CHUNK))]
+        jobs = min(jobs or os.cpu_count() or 1, len(chunks))
+        if jobs <= 1:
+            results = [self.validate_chunk(*chunk) for chunk in chunks]
+        else:
+            with multiprocessing.Pool(jobs, _init_worker, (self,)) as pool:
+                results = pool.starmap(_validate_chunk, chunks)
 
-        empirical_rate = false_positives / num_samples
+        tested = sum(result[0] for result in results)
+        false_positives = sum(result[1] for result in results)
+        empirical_rate = false_positives / tested if tested else 0.0
 
         return {
             'samples': num_samples,
+            'tested': tested,
             'false_positives': false_positives,
             'empirical_rate': empirical_rate
         }
 
-    def _generate_random_word(self, min_len: int = 3, max_len: int = 15) -> str:
+    def validate_chunk(self, seed: int, count: int,
+                       near_misses: bool = False) -> Tuple[int, int]:
+        """Check count samples; returns (non-words tested, false positives)."""
+        rng = random.Random(seed)
+        generate = (self._generate_near_miss if near_misses
+                    else self._generate_random_word)
+        samples = [generate(rng) for _ in range(count)]
+
+        # Skip any that happen to be real words
+        samples = [sample for sample in samples if sample not in self.word_set]
+
+        # Every one the Bloom filter accepts is a false positive
+        return len(samples), sum(self.filter.check_words(samples))
+
+    def lookup_costs(self, samples: int = COST_SAMPLES,
+                     seed: int = 1) -> Tuple[float, float, float, float]:
+        """Mean probes and records per lookup, for words and for non-words.
+
+        Returns (word probes, word records, non-word probes, non-word
+        records), counted as the C64 tests them with lookup_cost().
+        """
+        rng = random.Random(seed)
+        words = rng.sample(self.words, min(samples, len(self.words)))
+        non_words = []
+        while len(non_words) < samples:
+            sample = self._generate_random_word(rng)
+            if sample not in self.word_set:
+                non_words.append(sample)
+        costs = []
+        for group in (words, non_words):
+            totals = [sum(column) for column in
+                      zip(*(self.filter.lookup_cost(word) for word in group))]
+            costs.extend(total / len(group) for total in totals)
+        return tuple(costs)
+
+    def _generate_random_word(self, rng: random.Random, min_len: int = 3,
+                              max_len: int = 15) -> str:
         """Generate a random uppercase string."""
-        length = random.randint(min_len, max_len)
-        return ''.join(random.choices(string.ascii_uppercase, k=length))
+        length = rng.randint(min_len, max_len)
+        return ''.join(rng.choices(string.ascii_uppercase, k=length))
+
+    def _generate_near_miss(self, rng: random.Random) -> str:
+        """A dictionary word with one letter changed, as a typo would.
+
+        Near misses share all but one character with a word in the
+        filter, which is where weak mixing in a hash would show.
+        """
+        word = rng.choice(self.words)
+        position = rng.randrange(len(word))
+        letter = rng.choice(string.ascii_uppercase.replace(word[position], ''))
+        return word[:position] + letter + word[position + 1:]
 
     def print_validation(self, theoretical_fp_rate: float,
-                        num_samples: int = 100000):
-        """Run and print empirical validation."""
+                        num_samples: int = 100000,
+                        jobs: Optional[int] = None,
+                        seed: Optional[int] = None) -> bool:
+        """Run and print empirical validation.
+
+        Random strings and near misses are each measured against the
+        theoretical rate; returns whether both are within 3 standard
+        errors of it.
+        """
         print("\n" + "=" * 80)
         print("EMPIRICAL VALIDATION")
         print("=" * 80)
-        print("Testing false positive rate with random non-words...")
-
-        results = self.run_validation(num_samples)
-
-        print(f"Random samples tested: {results['samples']:,}")
-        print(f"False positives: {results['false_positives']:,}")
-        print(f"Empirical FP rate: {results['empirical_rate'] * 100:.4f}%")
+        print("Testing false positive rate with random non-words "
+              "and near misses...")
+        print(f"Hash scheme: {self.filter.config.hash_scheme}, "
+              f"layout: {self.filter.config.layout}")
         print(f"Theoretical FP rate: {theoretical_fp_rate * 100:.4f}%")
 
-        diff = abs(results['empirical_rate'] - theoretical_fp_rate)
-        print(f"Difference: {diff * 100:.4f}%")
+        z_scores = []
+        for label, near_misses in (('Random', False), ('Near-miss', True)):
+            results = self.run_validation(num_samples, jobs, seed,
+                                          near_misses=near_misses)
+            z_scores.append(self._print_sample_rate(label, results,
+                                                    theoretical_fp_rate))
 
-        if diff < 0.002:
+        matches = max(z_scores) < 3
+        if matches:
             print("✓ Empirical rate matches theory!")
         else:
-            print("⚠ Empirical rate differs from theory "
-                  "(expected due to random sampling)")
+            print("✗ Empirical rate differs from theory by more than "
+                  "3 standard errors (check the hash scheme)")
+
+        print("=" * 80)
+        return matches
 
+    def _print_sample_rate(self, label: str, results: dict,
+                           theoretical_fp_rate: float) -> float:
+        """Print one kind of sample's measured rate; returns its z-score."""
+        print(f"{label} samples tested: {results['tested']:,}")
+        print(f"  False positives: {results['false_positives']:,}")
+        print(f"  Empirical FP rate: {results['empirical_rate'] * 100:.4f}%")
+
+        diff = abs(results['empirical_rate'] - theoretical_fp_rate)
+        print(f"  Difference: {diff * 100:.4f}%")
+
+        # Standard error of a binomial proportion over the tested samples
+        p = theoretical_fp_rate
+        std_err = math.sqrt(p * (1 - p) / max(results['tested'], 1))
+        z_score = diff / std_err if std_err else 0.0
+        print(f"  Standard error: {std_err * 100:.4f}% (z = {z_score:.2f})")
+        return z_score
+
+    def print_comparison(self, others: List['EmpiricalValidator'],
+                         num_samples: int = 100000,
+                         jobs: Optional[int] = None):
+        """Measure every format on the same random non-words, side by side."""
+        validators = [self] + others
+        seed = random.randrange(1 << 32)
+        results = [v.run_validation(num_samples, jobs, seed) for v in validators]
+        costs = [v.lookup_costs() for v in validators]
+
+        print("\n" + "=" * 80)
+        print("EMPIRICAL FORMAT COMPARISON")
+        print("=" * 80)
+        print(f"Random samples tested: {num_samples:,}")
+        print(f"Lookup costs: {COST_SAMPLES:,} words and {COST_SAMPLES:,} "
+              f"non-words, stopping where the C64 stops")
+        print_table([
+            ('Format', [v.filter.config.format_name for v in validators]),
+            ('False positives', [f"{r['empirical_rate'] * 100:.4f}%"
+                                 for r in results]),
+            ('Probes, word', [f"{c[0]:.2f}" for c in costs]),
+            ('Records, word', [f"{c[1]:.2f}" for c in costs]),
+            ('Probes, non-word', [f"{c[2]:.2f}" for c in costs]),
+            ('Records, non-word', [f"{c[3]:.2f}" for c in costs]),
+        ])
         print("=" * 80)
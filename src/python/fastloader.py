@@ -0,0 +1,313 @@
+"""
+BOOT: an autostart fastloader for the spell checker on 1541-type drives.
+
+Copyright (c) 2025 John Byrd
+https://github.com/johnwbyrd/bloomer
+
+SPDX-License-Identifier: BSD-3-Clause
+"""
+from typing import Tuple
+from prg_cruncher import BASIC_ENTRY, BASIC_LINE, BASIC_START, sys_address
+
+LOADER_ADDR = 0xC000     # Free RAM above BASIC that the program loads below
+DRIVE_CODE_ADDR = 0x0500  # Buffer 2, as the probe routine in spellcheck.c
+DRIVE_WRITE_CHUNK = 32   # Bytes per M-W while uploading
+LOAD_ADDRESS_SIZE = 2
+
+# At BASIC_ENTRY: copy the loader and the program name to LOADER_ADDR
+# and run it there, out of the way of the program it loads
+BOOT_STUB = bytes([
+    0xA2, 0x00,        # 080D          LDX #LENGTH
+    0xBD, 0x00, 0x00,  # 080F  copy:   LDA LOADER-1,X
+    0x9D, 0xFF, 0xBF,  # 0812          STA $C000-1,X
+    0xCA,              # 0815          DEX
+    0xD0, 0xF7,        # 0816          BNE copy
+    0x4C, 0x00, 0xC0,  # 0818          JMP $C000
+])
+STUB_LENGTH = 1
+STUB_SOURCE = 3
+
+# Runs at LOADER_ADDR. Opens the command channel, sends the M-W and M-E
+# commands that follow the loader in BOOT (still in place, since nothing
+# has loaded over them yet), then receives the program with interrupts
+# off. Each block is announced by the drive pulling DATA, then a count
+# byte (0 = end of file, $FF = read error) and that many bytes. The C64
+# toggles CLK for every bit and samples DATA DELAY loops later, which is
+# longer than the drive takes to answer, so no cycle-exact timing is
+# needed and badlines only slow it down. A read error falls back to a
+# stock LOAD of the program. PTR = $FB/$FC, COUNT = $02, CLOCK = $FD,
+# VALUE = $FE.
+LOADER = bytes([
+    0xA9, 0x0F,        # C000          LDA #$0F
+    0xA2, 0x00,        # C002          LDX #DEVICE
+    0xA0, 0x0F,        # C004          LDY #$0F
+    0x20, 0xBA, 0xFF,  # C006          JSR $FFBA       ; SETLFS 15,dev,15
+    0xA9, 0x00,        # C009          LDA #$00
+    0x20, 0xBD, 0xFF,  # C00B          JSR $FFBD       ; SETNAM: no name
+    0x20, 0xC0, 0xFF,  # C00E          JSR $FFC0       ; OPEN
+    0xA9, 0x00,        # C011          LDA #<COMMANDS
+    0x85, 0xFB,        # C013          STA PTR
+    0xA9, 0x00,        # C015          LDA #>COMMANDS
+    0x85, 0xFC,        # C017          STA PTR+1
+    0x20, 0xCA, 0xC0,  # C019  cmd:    JSR getp        ; Command length
+    0x85, 0x02,        # C01C          STA COUNT
+    0xAA,              # C01E          TAX
+    0xF0, 0x15,        # C01F          BEQ start
+    0xA2, 0x0F,        # C021          LDX #$0F
+    0x20, 0xC9, 0xFF,  # C023          JSR $FFC9       ; CHKOUT 15
+    0x20, 0xCA, 0xC0,  # C026  send:   JSR getp
+    0x20, 0xD2, 0xFF,  # C029          JSR $FFD2       ; BSOUT
+    0xC6, 0x02,        # C02C          DEC COUNT
+    0xD0, 0xF6,        # C02E          BNE send
+    0x20, 0xCC, 0xFF,  # C030          JSR $FFCC       ; CLRCHN: run it
+    0x4C, 0x19, 0xC0,  # C033          JMP cmd
+    0x78,              # C036  start:  SEI
+    0xAD, 0x00, 0xDD,  # C037          LDA $DD00
+    0x29, 0x07,        # C03A          AND #$07
+    0x85, 0xFD,        # C03C          STA CLOCK
+    0x8D, 0x00, 0xDD,  # C03E          STA $DD00       ; Release the bus
+    0xA9, 0x00,        # C041          LDA #<LOADADDR
+    0x85, 0xFB,        # C043          STA PTR
+    0xA9, 0x00,        # C045          LDA #>LOADADDR
+    0x85, 0xFC,        # C047          STA PTR+1
+    0x2C, 0x00, 0xDD,  # C049  block:  BIT $DD00
+    0x10, 0xFB,        # C04C          BPL block       ; DATA high: busy
+    0x2C, 0x00, 0xDD,  # C04E  ready:  BIT $DD00
+    0x30, 0xFB,        # C051          BMI ready       ; DATA low: ready
+    0x20, 0xAE, 0xC0,  # C053          JSR recv        ; Byte count
+    0xF0, 0x1D,        # C056          BEQ done        ; 0: end of file
+    0xC9, 0xFF,        # C058          CMP #$FF
+    0xF0, 0x1F,        # C05A          BEQ fail        ; $FF: read error
+    0x85, 0x02,        # C05C          STA COUNT
+    0x20, 0xAE, 0xC0,  # C05E  data:   JSR recv
+    0xA0, 0x00,        # C061          LDY #$00
+    0x91, 0xFB,        # C063          STA (PTR),Y
+    0xE6, 0xFB,        # C065          INC PTR
+    0xD0, 0x02,        # C067          BNE dnext
+    0xE6, 0xFC,        # C069          INC PTR+1
+    0xC6, 0x02,        # C06B  dnext:  DEC COUNT
+    0xD0, 0xEF,        # C06D          BNE data
+    0x20, 0xA4, 0xC0,  # C06F          JSR edge        ; Block taken
+    0x4C, 0x49, 0xC0,  # C072          JMP block
+    0x20, 0x9B, 0xC0,  # C075  done:   JSR close
+    0x4C, 0x00, 0x00,  # C078          JMP ENTRY
+    0x20, 0x9B, 0xC0,  # C07B  fail:   JSR close
+    0xA9, 0x01,        # C07E          LDA #$01
+    0xA2, 0x00,        # C080          LDX #DEVICE
+    0xA0, 0x01,        # C082          LDY #$01
+    0x20, 0xBA, 0xFF,  # C084          JSR $FFBA       ; SETLFS 1,dev,1
+    0xA9, 0x00,        # C087          LDA #NAMELEN
+    0xA2, 0xD5,        # C089          LDX #<name
+    0xA0, 0xC0,        # C08B          LDY #>name
+    0x20, 0xBD, 0xFF,  # C08D          JSR $FFBD
+    0xA9, 0x00,        # C090          LDA #$00
+    0x20, 0xD5, 0xFF,  # C092          JSR $FFD5       ; Stock LOAD
+    0xB0, 0x03,        # C095          BCS quit
+    0x4C, 0x00, 0x00,  # C097          JMP ENTRY
+    0x60,              # C09A  quit:   RTS
+    0x20, 0xA4, 0xC0,  # C09B  close:  JSR edge
+    0x58,              # C09E          CLI
+    0xA9, 0x0F,        # C09F          LDA #$0F
+    0x4C, 0xC3, 0xFF,  # C0A1          JMP $FFC3       ; CLOSE 15
+    0xA5, 0xFD,        # C0A4  edge:   LDA CLOCK
+    0x49, 0x10,        # C0A6          EOR #$10
+    0x85, 0xFD,        # C0A8          STA CLOCK
+    0x8D, 0x00, 0xDD,  # C0AA          STA $DD00       ; Toggle CLK
+    0x60,              # C0AD          RTS
+    0xA2, 0x08,        # C0AE  recv:   LDX #$08        ; Bit 0 first
+    0xA5, 0xFD,        # C0B0  rbit:   LDA CLOCK
+    0x49, 0x10,        # C0B2          EOR #$10
+    0x85, 0xFD,        # C0B4          STA CLOCK
+    0x8D, 0x00, 0xDD,  # C0B6          STA $DD00       ; Next bit, please
+    0xA0, 0x09,        # C0B9          LDY #DELAY
+    0x88,              # C0BB  wait:   DEY
+    0xD0, 0xFD,        # C0BC          BNE wait        ; Drive answers
+    0xAD, 0x00, 0xDD,  # C0BE          LDA $DD00
+    0x0A,              # C0C1          ASL             ; C = DATA
+    0x66, 0xFE,        # C0C2          ROR VALUE
+    0xCA,              # C0C4          DEX
+    0xD0, 0xE9,        # C0C5          BNE rbit
+    0xA5, 0xFE,        # C0C7          LDA VALUE
+    0x60,              # C0C9          RTS
+    0xA0, 0x00,        # C0CA  getp:   LDY #$00
+    0xB1, 0xFB,        # C0CC          LDA (PTR),Y
+    0xE6, 0xFB,        # C0CE          INC PTR
+    0xD0, 0x02,        # C0D0          BNE gret
+    0xE6, 0xFC,        # C0D2          INC PTR+1
+    0x60,              # C0D4  gret:   RTS
+])
+LOADER_DEVICE = (3, 129)
+LOADER_COMMANDS_LO = 18
+LOADER_COMMANDS_HI = 22
+LOADER_LOAD_LO = 66
+LOADER_LOAD_HI = 70
+LOADER_ENTRY = (121, 152)
+LOADER_NAME_LENGTH = 136
+
+# Runs in the drive at DRIVE_CODE_ADDR. Reads the program's blocks into
+# buffer 1 ($0400) with job queue READs, following the chain, and sends
+# each block's data bytes one bit per CLK edge: DATA released for 1,
+# pulled for 0. Interrupts are off while sending, so the drive always
+# answers an edge within about 35 microseconds. FIRST, LAST, CLOCK, VALUE
+# and OUTPUT are $05F8-$05FC; JOB, HDR_T and HDR_S are buffer 1's job code
+# ($01) and header track/sector ($08/$09).
+DRIVE_CODE = bytes([
+    0xA9, 0x00,        # 0500           LDA #$00
+    0x8D, 0x00, 0x18,  # 0502           STA $1800       ; Release the bus
+    0xA9, 0x00,        # 0505           LDA #TRACK
+    0x85, 0x08,        # 0507           STA HDR_T
+    0xA9, 0x00,        # 0509           LDA #SECTOR
+    0x85, 0x09,        # 050B           STA HDR_S       ; First block
+    0xA9, 0x04,        # 050D           LDA #$04
+    0x8D, 0xF8, 0x05,  # 050F           STA FIRST       ; Skip load address
+    0xA9, 0x80,        # 0512  read:    LDA #$80
+    0x85, 0x01,        # 0514           STA JOB         ; Queue a read job
+    0x58,              # 0516           CLI
+    0xA5, 0x01,        # 0517  wjob:    LDA JOB
+    0x30, 0xFC,        # 0519           BMI wjob
+    0x78,              # 051B           SEI
+    0xC9, 0x02,        # 051C           CMP #$02
+    0xB0, 0x44,        # 051E           BCS error       ; Job error code
+    0xA2, 0xFF,        # 0520           LDX #$FF
+    0xAD, 0x00, 0x04,  # 0522           LDA BUFFER
+    0xD0, 0x03,        # 0525           BNE full
+    0xAE, 0x01, 0x04,  # 0527           LDX BUFFER+1    ; Last block's end
+    0x8E, 0xF9, 0x05,  # 052A  full:    STX LAST
+    0x8A,              # 052D           TXA
+    0x38,              # 052E           SEC
+    0xED, 0xF8, 0x05,  # 052F           SBC FIRST
+    0x18,              # 0532           CLC
+    0x69, 0x01,        # 0533           ADC #$01
+    0x20, 0x6E, 0x05,  # 0535           JSR ready       ; Byte count
+    0xAC, 0xF8, 0x05,  # 0538           LDY FIRST
+    0xB9, 0x00, 0x04,  # 053B  byte:    LDA BUFFER,Y
+    0x20, 0x7D, 0x05,  # 053E           JSR send
+    0xCC, 0xF9, 0x05,  # 0541           CPY LAST
+    0xF0, 0x03,        # 0544           BEQ sent
+    0xC8,              # 0546           INY
+    0xD0, 0xF2,        # 0547           BNE byte
+    0x20, 0xA5, 0x05,  # 0549  sent:    JSR release
+    0xA9, 0x02,        # 054C           LDA #$02
+    0x8D, 0xF8, 0x05,  # 054E           STA FIRST
+    0xAD, 0x00, 0x04,  # 0551           LDA BUFFER
+    0xF0, 0x0A,        # 0554           BEQ eof
+    0x85, 0x08,        # 0556           STA HDR_T
+    0xAD, 0x01, 0x04,  # 0558           LDA BUFFER+1
+    0x85, 0x09,        # 055B           STA HDR_S       ; Follow the chain
+    0x4C, 0x12, 0x05,  # 055D           JMP read
+    0xA9, 0x00,        # 0560  eof:     LDA #$00
+    0xF0, 0x02,        # 0562           BEQ finish
+    0xA9, 0xFF,        # 0564  error:   LDA #$FF
+    0x20, 0x6E, 0x05,  # 0566  finish:  JSR ready
+    0x20, 0xA5, 0x05,  # 0569           JSR release
+    0x58,              # 056C           CLI
+    0x60,              # 056D           RTS
+    0x48,              # 056E  ready:   PHA
+    0xAD, 0x00, 0x18,  # 056F           LDA $1800
+    0x29, 0x04,        # 0572           AND #$04
+    0x8D, 0xFA, 0x05,  # 0574           STA CLOCK
+    0xA9, 0x02,        # 0577           LDA #$02
+    0x8D, 0x00, 0x18,  # 0579           STA $1800       ; DATA low: ready
+    0x68,              # 057C           PLA
+    0x8D, 0xFB, 0x05,  # 057D  send:    STA VALUE       ; Bit 0 first
+    0xA2, 0x08,        # 0580           LDX #$08
+    0xA9, 0x02,        # 0582  sbit:    LDA #$02
+    0x4E, 0xFB, 0x05,  # 0584           LSR VALUE
+    0x90, 0x02,        # 0587           BCC sedge       ; 0: DATA pulled
+    0xA9, 0x00,        # 0589           LDA #$00        ; 1: DATA released
+    0x8D, 0xFC, 0x05,  # 058B  sedge:   STA OUTPUT
+    0xAD, 0x00, 0x18,  # 058E  swait:   LDA $1800
+    0x29, 0x04,        # 0591           AND #$04
+    0xCD, 0xFA, 0x05,  # 0593           CMP CLOCK
+    0xF0, 0xF6,        # 0596           BEQ swait
+    0x8D, 0xFA, 0x05,  # 0598           STA CLOCK
+    0xAD, 0xFC, 0x05,  # 059B           LDA OUTPUT
+    0x8D, 0x00, 0x18,  # 059E           STA $1800
+    0xCA,              # 05A1           DEX
+    0xD0, 0xDE,        # 05A2           BNE sbit
+    0x60,              # 05A4           RTS
+    0xAD, 0x00, 0x18,  # 05A5  release: LDA $1800
+    0x29, 0x04,        # 05A8           AND #$04
+    0xCD, 0xFA, 0x05,  # 05AA           CMP CLOCK
+    0xF0, 0xF6,        # 05AD           BEQ release     ; Closing CLK edge
+    0x8D, 0xFA, 0x05,  # 05AF           STA CLOCK
+    0xA9, 0x00,        # 05B2           LDA #$00
+    0x8D, 0x00, 0x18,  # 05B4           STA $1800       ; DATA high: busy
+    0x60,              # 05B7           RTS
+])
+DRIVE_TRACK = 6
+DRIVE_SECTOR = 10
+
+
+class Fastloader:
+    """Build BOOT, which loads a program several times faster than LOAD.
+
+    BOOT is a short PRG meant to be the first file on the disk, so that
+    LOAD"*",8 and RUN (or an emulator's autostart) start it. It uploads
+    DRIVE_CODE, streams the program's blocks in with a one-bit clocked
+    protocol and jumps to the program's own SYS address, as RUN would.
+    It needs a drive with the 1541's job queue and VIA layout; any other
+    drive can still LOAD the program itself.
+    """
+
+    def __init__(self, device: int):
+        self.device = device
+
+    def boot_program(self, program: bytes, first_block: Tuple[int, int],
+                     name: bytes) -> bytes:
+        """The BOOT PRG for a program whose chain starts at first_block."""
+        load = program[0] | program[1] << 8
+        end = load + len(program) - LOAD_ADDRESS_SIZE
+        if end > LOADER_ADDR:
+            raise ValueError(f"Program ends at ${end:04X}, over the loader")
+        entry = sys_address(program)
+
+        commands = self._commands(first_block)
+
+        loader = bytearray(LOADER)
+        source = BASIC_ENTRY + len(BOOT_STUB)
+        command_addr = source + len(LOADER) + len(name)
+        for offset in LOADER_DEVICE:
+            loader[offset] = self.device
+        loader[LOADER_COMMANDS_LO] = command_addr & 0xFF
+        loader[LOADER_COMMANDS_HI] = command_addr >> 8
+        loader[LOADER_LOAD_LO] = load & 0xFF
+        loader[LOADER_LOAD_HI] = load >> 8
+        for offset in LOADER_ENTRY:
+            loader[offset:offset + 2] = bytes((entry & 0xFF, entry >> 8))
+        loader[LOADER_NAME_LENGTH] = len(name)
+
+        stub = bytearray(BOOT_STUB)
+        stub[STUB_LENGTH] = len(LOADER) + len(name)
+        stub[STUB_SOURCE:STUB_SOURCE + 2] = bytes(((source - 1) & 0xFF,
+                                                   (source - 1) >> 8))
+        return (bytes((BASIC_START & 0xFF, BASIC_START >> 8)) + BASIC_LINE +
+                bytes(stub) + bytes(loader) + name + commands)
+
+    @classmethod
+    def boot_size(cls, name: bytes) -> int:
+        """Length of BOOT for a program called name, whatever the program."""
+        return (LOAD_ADDRESS_SIZE + len(BASIC_LINE) + len(BOOT_STUB) +
+                len(LOADER) + len(name) + len(cls._commands((0, 0))))
+
+    @classmethod
+    def _commands(cls, first_block: Tuple[int, int]) -> bytes:
+        """The M-W commands that upload DRIVE_CODE, M-E, then a zero."""
+        drive = bytearray(DRIVE_CODE)
+        drive[DRIVE_TRACK], drive[DRIVE_SECTOR] = first_block
+        commands = bytearray()
+        for offset in range(0, len(drive), DRIVE_WRITE_CHUNK):
+            chunk = drive[offset:offset + DRIVE_WRITE_CHUNK]
+            address = DRIVE_CODE_ADDR + offset
+            commands += cls._command(b'M-W' + bytes((address & 0xFF,
+                                                     address >> 8,
+                                                     len(chunk))) + chunk)
+        commands += cls._command(b'M-E' + bytes((DRIVE_CODE_ADDR & 0xFF,
+                                                 DRIVE_CODE_ADDR >> 8)))
+        commands.append(0)
+        return bytes(commands)
+
+    @staticmethod
+    def _command(text: bytes) -> bytes:
+        """A command as the loader sends it: its length, then the text."""
+        return bytes((len(text),)) + text
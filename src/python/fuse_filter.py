@@ -0,0 +1,144 @@
+"""
+Binary fuse filter: three fingerprint bytes per word instead of Bloom bits.
+
+Copyright (c) 2025 John Byrd
+https://github.com/johnwbyrd/bloomer
+
+SPDX-License-Identifier: BSD-3-Clause
+"""
+from typing import Callable, List, Optional, Sequence, Tuple
+
+FINGERPRINT_BITS = 8
+
+# Slots per word the smallest attempt starts from, and the growth per size
+MIN_SLOTS_PER_WORD = 1.2
+GROWTH_PERCENT = 1
+# Remixes of the words' hashes tried at each size before growing
+SEEDS_PER_SIZE = 4
+
+FuseKeys = Tuple[List[Sequence[int]], Sequence[int]]
+
+
+class BinaryFuseFilter:
+    """FINGERPRINT_BITS-bit fingerprints in REL records, XORed three at a time.
+
+    Every word has three slots, one byte in each of three consecutive
+    records (its segment), and a fingerprint; the build fills the slots
+    so that the three bytes XOR to the fingerprint. A non-word passes
+    only if its three bytes happen to XOR to its own fingerprint, about
+    1 in 256, and the filter needs a little over one byte per word.
+
+    Segments of one record each keep a lookup to three neighbouring
+    records on disk. Binary fuse filters (Graf and Lemire) usually size
+    segments for the word count; with the REL record as the segment the
+    filter needs some 20% more slots than words to build, and short
+    segments make it likely that two words share all three slots; the
+    build tries a few remixes of the hashes at each record count, upward
+    from the minimum.
+    """
+
+    def __init__(self, data: bytes, num_records: int, record_size: int,
+                 words: int, seed: int):
+        self.data = data
+        self.num_records = num_records
+        self.record_size = record_size
+        self.words = words
+        self.seed = seed
+
+    @classmethod
+    def build(cls, keys: Callable[[int, int], FuseKeys], words: int,
+              record_size: int, max_records: int,
+              multiple: int = 1) -> 'BinaryFuseFilter':
+        """Build the filter in as few records as it will fit.
+
+        keys(records, seed) gives every word's slots and fingerprint for
+        a filter of that many records and remix seed. The record count
+        is a multiple of the number of drives, as for a Golomb-coded set.
+        """
+        count = int(words * MIN_SLOTS_PER_WORD / record_size) + 3
+        count = -(-count // multiple) * multiple
+        while count <= max_records:
+            for seed in range(SEEDS_PER_SIZE):
+                slots, fingerprints = keys(count, seed)
+                data = cls._assign(slots, fingerprints, count * record_size)
+                if data is not None:
+                    return cls(bytes(data), count, record_size, words, seed)
+            step = max(1, count * GROWTH_PERCENT // 100)
+            count += -(-step // multiple) * multiple
+        raise ValueError(f"{words:,} words need more than {max_records} "
+                         f"records as a binary fuse filter")
+
+    @staticmethod
+    def _assign(slots: List[Sequence[int]], fingerprints: Sequence[int],
+                size: int) -> Optional[bytearray]:
+        """Peel the words off their slots and fill in the fingerprints.
+
+        A slot holding exactly one word is that word's to set, which
+        frees the word's other slots; repeating that orders every word,
+        unless some group of words shares all its slots. The bytes are
+        then filled in the reverse order. Returns None if peeling stalls.
+        Words with the same slots and fingerprint need only one entry.
+        """
+        keys = sorted(set(zip(*[_ints(column) for column in slots],
+                              _ints(fingerprints))))
+        count = [0] * size
+        mixed = [0] * size  # XOR of the indices of the keys on each slot
+        for index, key in enumerate(keys):
+            for slot in key[:-1]:
+                count[slot] += 1
+                mixed[slot] ^= index
+
+        stack = [slot for slot in range(size) if count[slot] == 1]
+        order = []
+        while stack:
+            slot = stack.pop()
+            if count[slot] != 1:
+                continue
+            index = mixed[slot]
+            order.append((index, slot))
+            for other in keys[index][:-1]:
+                count[other] -= 1
+                mixed[other] ^= index
+                if count[other] == 1:
+                    stack.append(other)
+        if len(order) != len(keys):
+            return None
+
+        data = bytearray(size)
+        for index, slot in reversed(order):
+            value = keys[index][-1]
+            for other in keys[index][:-1]:
+                value ^= data[other]
+            data[slot] = value  # data[slot] was 0, so XOR leaves it out
+        return data
+
+    def verify(self, slots: List[Sequence[int]], fingerprints: Sequence[int]):
+        """Check that every word's bytes XOR to its fingerprint."""
+        for key in zip(*[_ints(column) for column in slots],
+                       _ints(fingerprints)):
+            value = key[-1]
+            for slot in key[:-1]:
+                value ^= self.data[slot]
+            if value:
+                raise RuntimeError(f"Binary fuse filter slots {key[:-1]} do "
+                                   f"not XOR to their fingerprint")
+
+    @property
+    def false_positive_rate(self) -> float:
+        """Chance that a random non-word's bytes XOR to its fingerprint."""
+        return 1 / (1 << FINGERPRINT_BITS)
+
+    def print_summary(self, bloom_bytes: int):
+        """Print the size and fill of the filter."""
+        size = self.num_records * self.record_size
+        print(f"Slots: {size:,} bytes for {self.words:,} words "
+              f"({size / self.words:.3f} per word, "
+              f"{size * 8 / self.words:.2f} bits)")
+        print(f"Size: {self.num_records} records = {size:,} bytes, "
+              f"{size / bloom_bytes * 100:.1f}% of the {bloom_bytes:,}-byte "
+              f"Bloom filter the disk holds")
+
+
+def _ints(column: Sequence[int]) -> List[int]:
+    """A hash column as Python ints."""
+    return column.tolist() if hasattr(column, 'tolist') else list(column)
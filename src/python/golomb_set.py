@@ -0,0 +1,269 @@
+"""
+Golomb-coded set: the compressed alternative to the Bloom filter bits.
+
+Copyright (c) 2025 John Byrd
+https://github.com/johnwbyrd/bloomer
+
+SPDX-License-Identifier: BSD-3-Clause
+"""
+import random
+from bisect import bisect_right
+from typing import List, Optional, Sequence, Tuple
+
+MIN_HASH_BITS = 16
+MAX_HASH_BITS = 24         # Record bases fit the C64's 3-byte index entries
+MAX_RECORD_SPAN = 1 << 16  # Keys within a record are 16-bit on the C64
+
+# Estimated 6502 cycles for gcs_locate() and each step of gcs_contains()
+LOCATE_CYCLES_PER_STEP = 70
+CYCLES_PER_ENTRY = 45
+CYCLES_PER_QUOTIENT_BIT = 24
+CYCLES_PER_REMAINDER_BIT = 30
+COST_SAMPLES = 4000
+C64_CYCLES_PER_MS = 985  # PAL
+
+
+def rice_bits(value: int, parameter: int) -> int:
+    """Length of value's Rice code: a unary quotient, its stop bit, remainder."""
+    return (value >> parameter) + 1 + parameter
+
+
+class GolombCodedSet:
+    """Sorted word hashes, Rice coded into fixed-size REL records.
+
+    Each word contributes one hash value in [0, 2^hash_bits). False
+    positives happen only when a non-word's value equals a stored one,
+    so the rate is about (distinct values) / 2^hash_bits, and each value
+    costs roughly the Rice parameter plus 1.5 bits instead of the Bloom
+    filter's 1.44 bits per bit of log2(1/rate).
+
+    Record r holds the values in [base[r], base[r + 1]). A C64 RAM index
+    of the bases picks the record for a value; inside the record every
+    value is coded as its gap from the one before (the first from the
+    base): gap >> P zero bits, a one, then the low P bits, MSB first.
+    Zero padding can never complete a code, so a record simply ends.
+    """
+
+    def __init__(self, bases: List[int], records: List[List[int]],
+                 hash_bits: int, parameter: int, record_size: int):
+        self.bases = bases
+        self.records = records
+        self.hash_bits = hash_bits
+        self.parameter = parameter
+        self.record_size = record_size
+        self.data = b''.join(self._encode(r) for r in range(len(records)))
+
+    @classmethod
+    def build(cls, values: Sequence[int], hash_bits: int, record_size: int,
+              max_records: int, multiple: int = 1) -> 'GolombCodedSet':
+        """Pack sorted distinct values into as few records as possible.
+
+        Every Rice parameter near the optimum for the mean gap is tried.
+        The record count is rounded up to a multiple (the number of drives
+        the set is striped across) and the values are then split evenly,
+        so every record costs about the same to decode.
+        """
+        values = sorted(set(values))
+        mean_gap = max(1, (1 << hash_bits) // max(1, len(values)))
+        centre = max(0, mean_gap.bit_length() - 1)
+        best = None
+        for parameter in range(max(0, centre - 2), centre + 3):
+            count = cls._greedy_records(values, hash_bits, parameter,
+                                        record_size * 8)
+            if best is None or count < best[0]:
+                best = (count, parameter)
+        count, parameter = best
+
+        count = -(-count // multiple) * multiple
+        while count <= max_records:
+            split = cls._even_split(values, hash_bits, parameter,
+                                    record_size * 8, count)
+            if split:
+                return cls(split[0], split[1], hash_bits, parameter,
+                           record_size)
+            count += multiple
+        raise ValueError(f"{len(values):,} hashes of {hash_bits} bits need "
+                         f"more than {max_records} records; lower "
+                         f"gcs_hash_bits")
+
+    @staticmethod
+    def _greedy_records(values: Sequence[int], hash_bits: int,
+                        parameter: int, capacity: int) -> int:
+        """Records needed when each is filled as far as it goes."""
+        count = 1
+        base, previous, used = 0, 0, 0
+        for value in values:
+            bits = rice_bits(value - previous, parameter)
+            if used + bits > capacity or value - base >= MAX_RECORD_SPAN:
+                count += 1
+                base, previous = value, value
+                bits = rice_bits(0, parameter)
+                used = 0
+            used += bits
+            previous = value
+        return count + ((1 << hash_bits) - base > MAX_RECORD_SPAN)
+
+    @staticmethod
+    def _even_split(values: Sequence[int], hash_bits: int, parameter: int,
+                    capacity: int, count: int
+                    ) -> Optional[Tuple[List[int], List[List[int]]]]:
+        """Split values into count records of near-equal size, if they fit.
+
+        A record's base is just past the last value of the record before,
+        so the records cover the whole hash range without gaps.
+        """
+        bases, records = [], []
+        base = 0
+        for r in range(count):
+            chunk = list(values[len(values) * r // count:
+                                len(values) * (r + 1) // count])
+            used = 0
+            previous = base
+            for value in chunk:
+                used += rice_bits(value - previous, parameter)
+                previous = value
+            if used > capacity:
+                return None
+            bases.append(base)
+            records.append(chunk)
+            if chunk:
+                base = chunk[-1] + 1
+        ends = bases[1:] + [1 << hash_bits]
+        if any(end - base > MAX_RECORD_SPAN for base, end in zip(bases, ends)):
+            return None
+        return bases, records
+
+    def _encode(self, record: int) -> bytes:
+        """Rice code one record's gaps, zero padded to the record size."""
+        bits = []
+        previous = self.bases[record]
+        for value in self.records[record]:
+            gap = value - previous
+            bits.extend([0] * (gap >> self.parameter) + [1])
+            bits.extend((gap >> shift) & 1
+                        for shift in reversed(range(self.parameter)))
+            previous = value
+        bits.extend([0] * (-len(bits) % 8))
+        packed = bytes(int(''.join(map(str, bits[i:i + 8])), 2)
+                       for i in range(0, len(bits), 8))
+        return packed.ljust(self.record_size, b'\0')
+
+    def __len__(self) -> int:
+        return sum(len(values) for values in self.records)
+
+    @property
+    def num_records(self) -> int:
+        return len(self.records)
+
+    def locate(self, value: int) -> Tuple[int, int]:
+        """Record holding value's range, and value's key within it."""
+        record = bisect_right(self.bases, value) - 1
+        return record, value - self.bases[record]
+
+    def decode(self, data: bytes, key: int) -> Tuple[bool, int, int, int]:
+        """Look a key up in one record's bytes, as gcs_contains() does.
+
+        Returns (found, entries, quotient bits, remainder bits) decoded.
+        """
+        entries = quotient_bits = remainder_bits = 0
+        position, end = 0, len(data) * 8
+        value = 0
+        while position < end:
+            gap = 0
+            while (position < end and
+                   not data[position >> 3] & (0x80 >> (position & 7))):
+                gap += 1 << self.parameter
+                position += 1
+                quotient_bits += 1
+            position += 1
+            quotient_bits += 1
+            if position + self.parameter > end:
+                break
+            remainder = 0
+            for _ in range(self.parameter):
+                remainder = (remainder << 1 |
+                             data[position >> 3] >> (7 - (position & 7)) & 1)
+                position += 1
+            gap += remainder
+            remainder_bits += self.parameter
+            entries += 1
+            value += gap
+            if value >= key:
+                return value == key, entries, quotient_bits, remainder_bits
+        return False, entries, quotient_bits, remainder_bits
+
+    def record_data(self, record: int) -> bytes:
+        return self.data[record * self.record_size:(record + 1) * self.record_size]
+
+    def decode_all(self, data: bytes) -> List[int]:
+        """Every key coded in one record's bytes, in one pass."""
+        keys = []
+        position, end = 0, len(data) * 8
+        value = 0
+        while position < end:
+            gap = 0
+            while (position < end and
+                   not data[position >> 3] & (0x80 >> (position & 7))):
+                gap += 1 << self.parameter
+                position += 1
+            position += 1
+            if position + self.parameter > end:
+                break
+            for shift in reversed(range(self.parameter)):
+                gap += (data[position >> 3] >> (7 - (position & 7)) & 1) << shift
+                position += 1
+            value += gap
+            keys.append(value)
+        return keys
+
+    def verify(self):
+        """Decode every stored value back out of the encoded records."""
+        for record, values in enumerate(self.records):
+            base = self.bases[record]
+            if self.decode_all(self.record_data(record)) != [value - base
+                                                             for value in values]:
+                raise RuntimeError(f"Golomb-coded record {record} does not "
+                                   f"decode to its values")
+
+    @property
+    def index_bytes(self) -> int:
+        """C64 RAM used by the record base index (three bytes per record)."""
+        return 3 * self.num_records
+
+    @property
+    def false_positive_rate(self) -> float:
+        """Chance that a random non-word's hash is one of the stored values."""
+        return len(self) / (1 << self.hash_bits)
+
+    def probe_cycles(self, samples: int = COST_SAMPLES) -> float:
+        """Estimated 6502 cycles to locate and decode one random probe."""
+        rng = random.Random(1)
+        steps = max(1, (self.num_records - 1).bit_length())
+        total = 0
+        for _ in range(samples):
+            record, key = self.locate(rng.randrange(1 << self.hash_bits))
+            _, entries, quotient, remainder = self.decode(
+                self.record_data(record), key)
+            total += (entries * CYCLES_PER_ENTRY +
+                      quotient * CYCLES_PER_QUOTIENT_BIT +
+                      remainder * CYCLES_PER_REMAINDER_BIT)
+        return steps * LOCATE_CYCLES_PER_STEP + total / samples
+
+    def print_summary(self, word_count: int, bloom_bytes: int):
+        """Print the compressed size, decode cost and false positive rate."""
+        size = self.num_records * self.record_size
+        encoded = sum(rice_bits(value - previous, self.parameter)
+                      for r, values in enumerate(self.records)
+                      for previous, value in zip([self.bases[r]] + values[:-1],
+                                                 values))
+        cycles = self.probe_cycles()
+        print(f"Distinct {self.hash_bits}-bit hashes: {len(self):,} "
+              f"({word_count - len(self):,} words share one)")
+        print(f"Rice parameter: {self.parameter} "
+              f"({encoded / len(self):.2f} bits per word coded)")
+        print(f"Compressed size: {self.num_records} records = {size:,} bytes, "
+              f"{size / bloom_bytes * 100:.1f}% of the {bloom_bytes:,}-byte "
+              f"Bloom filter the disk holds")
+        print(f"RAM index: {self.index_bytes:,} bytes")
+        print(f"Decode: ~{cycles:,.0f} cycles per probe "
+              f"(~{cycles / C64_CYCLES_PER_MS:.1f} ms, estimated)")
@@ -40,10 +40,7 @@ def hash_jenkins(word: str, seed: int = 0) -> int:
         hash_val += ord(char)
         hash_val = (hash_val + (hash_val << 10)) & 0xFFFFFFFF
         hash_val ^= (hash_val >> 6)
-    hash_val = (hash_val + (hash_val << 3)) & 0xFFFFFFFF
-    hash_val ^= (hash_val >> 11)
-    hash_val = (hash_val + (hash_val << 15)) & 0xFFFFFFFF
-    return hash_val
+    return jenkins_final(hash_val)
 
 
 def hash_murmur(word: str, seed: int = 0) -> int:
@@ -56,6 +53,104 @@ def hash_murmur(word: str, seed: int = 0) -> int:
     return hash_val
 
 
+def hash_pair(word: str):
+    """Compute two 32-bit hashes in a single pass over the word.
+
+    h1 is Jenkins one-at-a-time and h2 is DJB2; both use only shifts and
+    adds per character. h2 gets the Jenkins final avalanche too, and is
+    forced odd so that successive double hashes never repeat mod 2^32.
+    """
+    h1 = 0
+    h2 = 5381
+    for char in word:
+        c = ord(char)
+        h1 = (h1 + c) & 0xFFFFFFFF
+        h1 = (h1 + (h1 << 10)) & 0xFFFFFFFF
+        h1 ^= (h1 >> 6)
+        h2 = ((h2 << 5) + h2 + c) & 0xFFFFFFFF
+    return jenkins_final(h1), jenkins_final(h2) | 1
+
+
+def jenkins_final(hash_val: int) -> int:
+    """Final avalanche step of the Jenkins one-at-a-time hash."""
+    hash_val = (hash_val + (hash_val << 3)) & 0xFFFFFFFF
+    hash_val ^= (hash_val >> 11)
+    hash_val = (hash_val + (hash_val << 15)) & 0xFFFFFFFF
+    return hash_val
+
+
+def _pearson_table() -> bytes:
+    """A permutation of 0-255, shuffled by Fisher-Yates from a fixed LCG.
+
+    Any permutation works; this one is reproducible. header_generator.py
+    writes it into bloom_config.h as pearson_table for the C side.
+    """
+    table = list(range(256))
+    state = 1
+    for i in range(255, 0, -1):
+        state = (state * 1664525 + 1013904223) & 0xFFFFFFFF
+        j = (state >> 16) % (i + 1)
+        table[i], table[j] = table[j], table[i]
+    return bytes(table)
+
+
+PEARSON_TABLE = _pearson_table()
+PEARSON_LANES = 4       # Bytes of one Pearson hash, each its own table walk
+PEARSON_LANE_KEY = 32   # Lane n of seed s XORs (4s + n) × 32 into characters
+
+
+def pearson_key(seed: int, lane: int) -> int:
+    """What lane of the hash with this seed XORs into each character."""
+    return ((seed * PEARSON_LANES + lane) * PEARSON_LANE_KEY) & 0xFF
+
+
+def hash_pearson(word: str, seed: int = 0) -> int:
+    """Pearson hash widened to 32 bits: four byte lanes, one lookup each.
+
+    Every lane walks PEARSON_TABLE from 0 with its own key XORed into
+    the characters, so a character costs four XORs and four indexed
+    loads on the 6502: no shifts, adds or multiplies across bytes. The
+    keys are multiples of 32, so the letters of different lanes index
+    disjoint 32-byte stretches of the table; lane 0 is the low byte.
+    """
+    lanes = [0] * PEARSON_LANES
+    for char in word:
+        c = ord(char)
+        for lane in range(PEARSON_LANES):
+            lanes[lane] = PEARSON_TABLE[lanes[lane] ^ c ^
+                                        pearson_key(seed, lane)]
+    return sum(value << (8 * lane) for lane, value in enumerate(lanes))
+
+
+def pearson_pair(word: str):
+    """h1 and h2 from two Pearson hashes, h2 forced odd as in hash_pair()."""
+    return hash_pearson(word, 0), hash_pearson(word, 1) | 1
+
+
+def double_hash_values(word: str, count: int, pair=hash_pair):
+    """Kirsch-Mitzenmacher double hashing: g_i = h1 + i × h2 (mod 2^32)."""
+    h1, h2 = pair(word)
+    return [(h1 + i * h2) & 0xFFFFFFFF for i in range(count)]
+
+
+FUSE_MIX_STEP = 0x9E3779B9  # Added index times to the hash before remixing
+
+
+def fuse_mix(hash_val: int, index: int) -> int:
+    """A binary fuse filter hash value, remixed from a word's first hash.
+
+    The MurmurHash3 finalizer of hash_val + index × FUSE_MIX_STEP. Lookup
+    slots must look independent, which the shift-and-add hashes are not;
+    BloomConfig.fuse_value_index() numbers the values.
+    """
+    hash_val = (hash_val + index * FUSE_MIX_STEP) & 0xFFFFFFFF
+    hash_val ^= hash_val >> 16
+    hash_val = (hash_val * 0x85EBCA6B) & 0xFFFFFFFF
+    hash_val ^= hash_val >> 13
+    hash_val = (hash_val * 0xC2B2AE35) & 0xFFFFFFFF
+    return hash_val ^ (hash_val >> 16)
+
+
 ALL_HASH_FUNCTIONS = [
     hash_fnv1a,
     hash_djb2,
@@ -7,30 +7,81 @@ https://github.com/johnwbyrd/bloomer
 SPDX-License-Identifier: BSD-3-Clause
 """
 from pathlib import Path
-from typing import Dict
-from bloom_config import BloomConfig
+from typing import Dict, Optional, Sequence
+from bloom_config import BloomConfig, HASH_PEARSON, HASH_SCHEMES, LAYOUTS
+from common_words import CommonWordTable, INDEX_ENTRIES
+from golomb_set import GolombCodedSet
+from hash_functions import PEARSON_TABLE
+from record_remap import RecordRemap
+from runtime_config import ACCESS_MODES, RuntimeConfig
 
 
 class CHeaderGenerator:
     """Generate C header files with Bloom filter configuration."""
 
-    def generate(self, config: BloomConfig, word_count: int,
+    def generate(self, config: BloomConfig, runtime: RuntimeConfig,
+                word_count: int,
                 fp_rate: float, scowl_config: Dict[str, any],
-                output_path: Path):
+                output_path: Path, preload_records: Sequence[int] = (),
+                minimal_preload_records: Sequence[int] = (),
+                common_table: Optional[CommonWordTable] = None,
+                remap: Optional[RecordRemap] = None,
+                gcs: Optional[GolombCodedSet] = None):
         """Generate and write C header file."""
         output_path.parent.mkdir(parents=True, exist_ok=True)
 
         spelling_str = ', '.join(scowl_config['spelling'])
         dict_desc = f"SCOWL size {scowl_config['max_size']} ({spelling_str})"
+        layout_defines = '\n'.join(
+            f"#define BLOOM_LAYOUT_{name.upper()} {i}"
+            for i, name in enumerate(LAYOUTS))
+        hash_defines = '\n'.join(
+            f"#define BLOOM_HASH_{name.upper()} {i}"
+            for i, name in enumerate(HASH_SCHEMES))
+        access_defines = '\n'.join(
+            f"#define BLOOM_ACCESS_{name.upper()} {i}"
+            for i, name in enumerate(ACCESS_MODES))
+        disk_defines = self._disk_defines(config)
+        cache_defines = self._cache_defines(config, runtime, preload_records,
+                                            minimal_preload_records)
+        common_word_table = self._common_word_table(common_table)
+        remap_table = self._remap_table(remap)
+        gcs_index = self._gcs_index(gcs)
+        pearson_table = self._pearson_table(config)
 
         header_content = f"""/* Auto-generated Bloom filter configuration */
 #ifndef BLOOM_CONFIG_H
 #define BLOOM_CONFIG_H
 
+#include <stdint.h>
+
 #define BLOOM_SIZE_BYTES {config.size_bytes}UL
 #define BLOOM_SIZE_BITS {config.size_bits}UL
 #define NUM_HASH_FUNCTIONS {config.num_hash_functions}
 #define NUM_RECORDS {config.num_records}
+
+{disk_defines}
+{layout_defines}
+#define BLOOM_LAYOUT BLOOM_LAYOUT_{config.layout.upper()}
+#define NUM_BIT_PROBES {config.probes_per_word}
+
+{hash_defines}
+#define BLOOM_HASH_SCHEME BLOOM_HASH_{config.hash_scheme.upper()}
+{pearson_table}
+{access_defines}
+#define BLOOM_ACCESS BLOOM_ACCESS_{runtime.access.upper()}
+
+#define BLOOM_BATCH_WORDS {runtime.batch_words}
+#define BLOOM_RECENT_WORDS {runtime.recent_words}
+#define BLOOM_PROFILE {int(runtime.profile)}
+#define BLOOM_REU {int(runtime.uses_reu)}
+#define BLOOM_TYPE_AHEAD {int(runtime.type_ahead)}
+#define BLOOM_SUGGEST {int(runtime.suggest)}
+#define BLOOM_FAST_SERIAL {int(runtime.uses_fast_serial)}
+{cache_defines}
+{common_word_table}
+{remap_table}
+{gcs_index}
 #define DICT_INFO "Commodore 64 Bloom filter spell checker\\n\\n" \\
               "https://www.github.com/johnwbyrd/bloomer\\n\\n" \\
               "Dictionary: {word_count} words\\n" \\
@@ -47,3 +98,116 @@ class CHeaderGenerator:
             f.write(header_content)
 
         print(f"Generated configuration header: {output_path}")
+
+    def _disk_defines(self, config: BloomConfig) -> str:
+        """Format the drive model, directory location and device list."""
+        geometry = config.geometry
+        devices = ', '.join(str(device) for device in config.devices)
+        return f"""#define BLOOM_DRIVE {geometry.drive}
+#define BLOOM_DIR_TRACK {geometry.directory_track}
+#define BLOOM_DIR_SECTOR {geometry.directory_sector}
+#define BLOOM_DEVICE {config.devices[0]}
+#define BLOOM_DEVICE_COUNT {config.num_devices}
+#define BLOOM_DEVICES {{{devices}}}
+#define BLOOM_STRIPED {int(config.is_striped)}
+"""
+
+    def _cache_defines(self, config: BloomConfig, runtime: RuntimeConfig,
+                       preload_records: Sequence[int],
+                       minimal_preload_records: Sequence[int]) -> str:
+        """Format the record cache size and preload of both programs.
+
+        spellcheck_min, built with BLOOM_MINIMAL_RUNTIME, has more RAM to
+        cache records in than spellcheck.
+        """
+        minimal = runtime.minimal()
+        return f"""#if BLOOM_MINIMAL_RUNTIME
+#define BLOOM_CACHE_SLOTS {minimal.record_cache_slots(config)}
+{self._preload_table(minimal_preload_records)}#else
+#define BLOOM_CACHE_SLOTS {runtime.record_cache_slots(config)}
+{self._preload_table(preload_records)}#endif
+"""
+
+    def _preload_table(self, records: Sequence[int]) -> str:
+        """Format the hot record list streamed into the cache at startup."""
+        lines = [f"#define BLOOM_PRELOAD_COUNT {len(records)}"]
+        if records:
+            lines.append("/* Hottest records by word frequency, in ascending "
+                         "order for streaming */")
+            lines.append("static const uint16_t bloom_preload_records"
+                         "[BLOOM_PRELOAD_COUNT] = {")
+            lines.extend(self._format_values(records))
+            lines.append("};")
+        return '\n'.join(lines) + '\n'
+
+    def _common_word_table(self, table: Optional[CommonWordTable]) -> str:
+        """Format the common-word fingerprint index and keys."""
+        count = len(table) if table else 0
+        lines = [f"#define COMMON_WORD_COUNT {count}"]
+        if count:
+            lines.append("/* Start of each fingerprint bucket (top 8 bits) "
+                         "in common_word_keys */")
+            lines.append(f"static const uint16_t common_word_index"
+                         f"[{INDEX_ENTRIES}] = {{")
+            lines.extend(self._format_values(table.index))
+            lines.append("};")
+            lines.append("/* Low 16 fingerprint bits, sorted within each "
+                         "bucket */")
+            lines.append("static const uint16_t common_word_keys"
+                         "[COMMON_WORD_COUNT] = {")
+            lines.extend(self._format_values(table.keys))
+            lines.append("};")
+        return '\n'.join(lines) + '\n'
+
+    def _remap_table(self, remap: Optional[RecordRemap]) -> str:
+        """Format the packed logical-to-physical record table."""
+        enabled = remap is not None and not remap.is_identity
+        lines = [f"#define BLOOM_REMAP {int(enabled)}"]
+        if enabled:
+            low, high = remap.packed()
+            bits = remap.high_bits
+            lines.append(f"#define BLOOM_REMAP_HIGH_BITS {bits}")
+            lines.append(f"/* Physical record of each logical record: low "
+                         f"bytes, then the bits above them {8 // bits} "
+                         f"to a byte */")
+            lines.append("static const uint8_t record_remap_lo"
+                         "[NUM_RECORDS] = {")
+            lines.extend(self._format_values(low))
+            lines.append("};")
+            lines.append("static const uint8_t record_remap_hi"
+                         "[(NUM_RECORDS * BLOOM_REMAP_HIGH_BITS + 7) / 8] = {")
+            lines.extend(self._format_values(high))
+            lines.append("};")
+        return '\n'.join(lines) + '\n'
+
+    def _pearson_table(self, config: BloomConfig) -> str:
+        """Format the permutation the Pearson hashes look characters up in."""
+        if config.hash_scheme != HASH_PEARSON:
+            return ''
+        lines = ["/* PEARSON_TABLE of hash_functions.py */",
+                 "static const uint8_t pearson_table[256] = {"]
+        lines.extend(self._format_values(PEARSON_TABLE))
+        lines.append("};")
+        return '\n'.join(lines) + '\n'
+
+    def _gcs_index(self, gcs: Optional[GolombCodedSet]) -> str:
+        """Format the Golomb-coded set parameters and record base index."""
+        if gcs is None:
+            return ''
+        lines = [f"#define GCS_HASH_BITS {gcs.hash_bits}",
+                 f"#define GCS_RICE_BITS {gcs.parameter}",
+                 "/* Lowest hash value each record covers: low 16 bits, "
+                 "then the top 8 */",
+                 "static const uint16_t gcs_base_lo[NUM_RECORDS] = {"]
+        lines.extend(self._format_values([b & 0xFFFF for b in gcs.bases]))
+        lines.append("};")
+        lines.append("static const uint8_t gcs_base_hi[NUM_RECORDS] = {")
+        lines.extend(self._format_values([b >> 16 for b in gcs.bases]))
+        lines.append("};")
+        return '\n'.join(lines) + '\n'
+
+    def _format_values(self, values: Sequence[int], per_line: int = 12):
+        """Format integer values as comma-separated C initializer lines."""
+        for i in range(0, len(values), per_line):
+            chunk = values[i:i + per_line]
+            yield '    ' + ', '.join(str(v) for v in chunk) + ','
@@ -0,0 +1,75 @@
+"""
+Hot record selection for the C64 startup preload.
+
+Copyright (c) 2025 John Byrd
+https://github.com/johnwbyrd/bloomer
+
+SPDX-License-Identifier: BSD-3-Clause
+"""
+from collections import defaultdict
+from typing import Dict, List, Tuple
+from bloom_filter import BloomFilter
+
+
+class HotRecordSelector:
+    """Rank REL records by how often common words touch them."""
+
+    def __init__(self, bloom_filter: BloomFilter,
+                 weighted_words: List[Tuple[str, float]]):
+        self.filter = bloom_filter
+        self.weighted_words = weighted_words
+        self.heat = self._record_heat()
+
+    def _record_heat(self) -> Dict[int, float]:
+        """Sum word weights over every record each word probes."""
+        heat = defaultdict(float)
+        for word, weight in self.weighted_words:
+            for record in self.filter.records_for_word(word):
+                heat[record] += weight
+        return heat
+
+    def ranked(self) -> List[int]:
+        """Return records ordered from hottest to coldest."""
+        return sorted(self.heat, key=lambda record: (-self.heat[record], record))
+
+    def select(self, count: int) -> List[int]:
+        """Return the hottest records in ascending order, for streaming."""
+        return sorted(self.ranked()[:count])
+
+    def heat_share(self, count: int) -> float:
+        """Fraction of all record heat carried by the count hottest records."""
+        total = sum(self.heat.values())
+        top = sum(self.heat[record] for record in self.ranked()[:count])
+        return top / total if total else 0.0
+
+    def print_placement(self):
+        """Print how concentrated record accesses are, for heat ordering."""
+        num_records = self.filter.config.num_records
+        print("\n=== HEAT-ORDERED PLACEMENT ===")
+        print(f"Records ranked: {len(self.heat)} / {num_records}, "
+              f"hottest first in BLOOM.DAT")
+        for percent in (5, 10, 25, 50):
+            count = num_records * percent // 100
+            print(f"  Hottest {percent}% ({count} records): "
+                  f"{self.heat_share(count) * 100:.1f}% of record accesses")
+
+    def coverage(self, records: List[int]) -> float:
+        """Fraction of weighted lookups served entirely from the given records."""
+        chosen = set(records)
+        total = covered = 0.0
+        for word, weight in self.weighted_words:
+            total += weight
+            if chosen.issuperset(self.filter.records_for_word(word)):
+                covered += weight
+        return covered / total if total else 0.0
+
+    def print_selection(self, records: List[int]):
+        """Print preload selection summary."""
+        size = self.filter.config.geometry.rel_record_size
+        print("\n=== HOT RECORD PRELOAD ===")
+        print(f"Frequency words: {len(self.weighted_words):,}")
+        print(f"Records preloaded: {len(records)} / "
+              f"{self.filter.config.num_records} "
+              f"({len(records) * size:,} bytes)")
+        print(f"Weighted lookups served from RAM: "
+              f"{self.coverage(records) * 100:.1f}%")
@@ -0,0 +1,496 @@
+"""
+C lookup kernel generator for the Bloom filter.
+
+Copyright (c) 2025 John Byrd
+https://github.com/johnwbyrd/bloomer
+
+SPDX-License-Identifier: BSD-3-Clause
+"""
+from pathlib import Path
+from typing import List, Tuple
+from bloom_config import (BloomConfig, DOUBLE_HASHED, FUSE_ARITY,
+                          FUSE_HASH_VALUES, HASH_DOUBLE, HASH_PEARSON,
+                          RANGE_MULTIPLY_SHIFT)
+from hash_functions import FUSE_MIX_STEP, PEARSON_LANES
+
+# Per-character folds of the independent hash functions in bloom_core.h,
+# in ALL_HASH_FUNCTIONS order, and whether each ends with jenkins_final()
+HASH_FOLDS = (('fnv1a', False), ('djb2', False), ('sdbm', False),
+              ('jenkins', True), ('murmur', False))
+
+# Estimated 6502 cycles of each fold's step as LLVM-MOS compiles it, and
+# of finishing a value. A 32-bit multiply is a libcall of some thirty
+# shift-and-add rounds, a 32-bit shift costs about 20 cycles per bit
+# beyond whole bytes, and a Pearson lane is an XOR and an indexed load.
+STEP_CYCLES = {'fnv1a': 1100, 'djb2': 150, 'sdbm': 210, 'jenkins': 240,
+               'murmur': 1300, 'pearson': PEARSON_LANES * 20}
+FINAL_CYCLES = 220          # jenkins_final()
+PEARSON_VALUE_CYCLES = 30   # pearson_value(): the lanes are its bytes
+
+# Hashing a whole word is the same fold, one character after another
+KERNEL_PROBES = """
+/* Compute the probes for a word */
+static void bloom_kernel_probes(const char *word, bloom_probe_t *probes) {
+  bloom_hash_state_t state;
+
+  bloom_kernel_init(&state);
+  while (*word) {
+    bloom_kernel_step(&state, (uint8_t)*word);
+    word++;
+  }
+  bloom_kernel_finish(&state, probes);
+}
+"""
+
+
+class LookupKernelGenerator:
+    """Generate a lookup routine specialized for one filter configuration.
+
+    The kernel turns a word into its bit probes with every hash call,
+    loop and constant resolved at build time: no function pointers, and
+    with multiply-shift range reduction, no division. Multiplies by the
+    record count and record size become shift-and-add chains.
+
+    The hashes run as one set of states advanced a character at a time
+    (bloom_kernel_step()), so the line editor can hash a word as it is
+    typed and leave only bloom_kernel_finish() for RETURN.
+    """
+
+    def generate(self, config: BloomConfig, output_path: Path,
+                 remap: bool = False):
+        """Generate and write the lookup kernel header.
+
+        With remap, every record index is translated to its physical
+        position in BLOOM.DAT by remap_record() before it is stored.
+        """
+        output_path.parent.mkdir(parents=True, exist_ok=True)
+        if config.is_gcs:
+            self._write(output_path, self._gcs_kernel(config, remap))
+            return
+        if config.is_fuse:
+            self._write(output_path, self._fuse_kernel(config, remap))
+            return
+
+        if config.range_reduction == RANGE_MULTIPLY_SHIFT:
+            reduction = self._multiply_shift_helpers(config)
+        else:
+            reduction = self._modulo_helpers()
+
+        remark = ', and remap_record()' if remap else ''
+        kernel_content = f"""/* Auto-generated Bloom filter lookup kernel */
+#ifndef BLOOM_KERNEL_H
+#define BLOOM_KERNEL_H
+
+/*
+ * Specialized for {config.num_hash_functions} {config.hash_scheme} hashes, \
+{config.layout} layout,
+ * {config.range_reduction} range reduction, {config.num_records} records \
+of {config.record_bits} bits.
+ * Requires bloom_probe_t and the hash functions from bloom_core.h{remark}.
+ */
+
+{self._hash_states(config)}
+{reduction}
+/* Store a probe for a bit offset within a record */
+static inline void kernel_set_probe(bloom_probe_t *probe, uint16_t record,
+                                    uint16_t offset) {{
+  probe->record = record;
+  probe->byte = offset >> 3;
+  probe->mask = 1 << (offset & 7);
+}}
+
+/* Finish the hashes and compute the NUM_BIT_PROBES probes */
+static void bloom_kernel_finish(const bloom_hash_state_t *state,
+                                bloom_probe_t *probes) {{
+{self._kernel_body(config, remap)}}}
+{KERNEL_PROBES}
+#endif /* BLOOM_KERNEL_H */
+"""
+        self._write(output_path, kernel_content)
+
+    def _write(self, output_path: Path, kernel_content: str):
+        with open(output_path, 'w') as f:
+            f.write(kernel_content)
+
+        print(f"Generated lookup kernel: {output_path}")
+
+    def _gcs_kernel(self, config: BloomConfig, remap: bool) -> str:
+        """Emit the one-probe kernel of a Golomb-coded set.
+
+        The top GCS_HASH_BITS of the first hash are the word's value;
+        gcs_locate() finds the record whose range holds it and returns
+        the value's key relative to that record's base.
+        """
+        remark = ', and remap_record()' if remap else ''
+        lines = ['  uint16_t record;', '']
+        lines.append(f'  probes[0].key = gcs_locate({self._hash_value(config, 0)}'
+                     f' >> (32 - GCS_HASH_BITS), &record);')
+        if remap:
+            lines.append('  record = remap_record(record);')
+        lines.append('  probes[0].record = record;')
+        body = '\n'.join(lines) + '\n'
+        return f"""/* Auto-generated Bloom filter lookup kernel */
+#ifndef BLOOM_KERNEL_H
+#define BLOOM_KERNEL_H
+
+/*
+ * Specialized for a Golomb-coded set of {config.gcs_hash_bits}-bit \
+{config.hash_scheme} hashes
+ * in {config.num_records} records.
+ * Requires bloom_probe_t, gcs_locate() and the hash functions from
+ * bloom_core.h{remark}.
+ */
+
+{self._hash_states(config)}
+/* Finish the hash and compute the probe */
+static void bloom_kernel_finish(const bloom_hash_state_t *state,
+                                bloom_probe_t *probes) {{
+{body}}}
+{KERNEL_PROBES}
+#endif /* BLOOM_KERNEL_H */
+"""
+
+    def _fuse_kernel(self, config: BloomConfig, remap: bool) -> str:
+        """Emit the kernel of a binary fuse filter.
+
+        The first hash is remixed by fuse_mix() into one value for the
+        segment and fingerprint and one per record for the byte within
+        it, exactly as BloomFilter._fuse_slots() does; the fingerprint
+        rides in the first probe's mask.
+        """
+        if config.range_reduction == RANGE_MULTIPLY_SHIFT:
+            reduction = self._fuse_multiply_shift_helpers(config)
+        else:
+            reduction = self._fuse_modulo_helpers()
+        remark = ', and remap_record()' if remap else ''
+        translate = 'remap_record(segment + {i})' if remap else 'segment + {i}'
+        offsets = [config.fuse_value_index(i) * FUSE_MIX_STEP & 0xFFFFFFFF
+                   for i in range(FUSE_HASH_VALUES)]
+        mixed = [f'fuse_mix(h + 0x{offset:08X}UL)' for offset in offsets]
+        lines = [f'  uint32_t h = {self._hash_value(config, 0)};',
+                 '  uint16_t segment;',
+                 '  uint8_t fingerprint;',
+                 '',
+                 f'  fingerprint = kernel_reduce_segment({mixed[0]}, &segment);']
+        for i in range(FUSE_ARITY):
+            mask = 'fingerprint' if i == 0 else '0'
+            lines.append(f'  probes[{i}].record = {translate.format(i=i)};')
+            lines.append(f'  probes[{i}].byte = '
+                         f'kernel_reduce_byte({mixed[i + 1]});')
+            lines.append(f'  probes[{i}].mask = {mask};')
+        body = '\n'.join(lines) + '\n'
+        return f"""/* Auto-generated Bloom filter lookup kernel */
+#ifndef BLOOM_KERNEL_H
+#define BLOOM_KERNEL_H
+
+/*
+ * Specialized for a binary fuse filter of {config.hash_scheme} hashes \
+(remix seed {config.fuse_seed}),
+ * {config.range_reduction} range reduction, {config.num_records} records \
+of {config.geometry.rel_record_size} fingerprints.
+ * Requires bloom_probe_t, fuse_mix() and the hash functions from
+ * bloom_core.h{remark}.
+ */
+
+/* A word's segment starts at any record but the last {FUSE_ARITY - 1} */
+#define FUSE_SEGMENTS {config.fuse_segments}
+
+{self._hash_states(config)}
+{reduction}
+/* Finish the hash and compute the NUM_BIT_PROBES probes; the bytes they
+ * select XOR to the fingerprint for a word in the set */
+static void bloom_kernel_finish(const bloom_hash_state_t *state,
+                                bloom_probe_t *probes) {{
+{body}}}
+{KERNEL_PROBES}
+#endif /* BLOOM_KERNEL_H */
+"""
+
+    def _fuse_multiply_shift_helpers(self, config: BloomConfig) -> str:
+        """Emit the multiply-shift reductions of a binary fuse filter."""
+        segments = config.fuse_segments
+        size = config.geometry.rel_record_size
+        return f"""/* x * {segments} */
+static inline uint32_t kernel_mul_segments(uint16_t x) {{
+  return {self._constant_multiply('x', segments)};
+}}
+
+/* x * {size} */
+static inline uint32_t kernel_mul_record_size(uint16_t x) {{
+  return {self._constant_multiply('x', size)};
+}}
+
+/* segment = (h * FUSE_SEGMENTS) >> 32; returns the top byte of the low
+ * 32 bits of the product, the fingerprint */
+static inline uint8_t kernel_reduce_segment(uint32_t h, uint16_t *segment) {{
+  uint32_t lo = kernel_mul_segments((uint16_t)h);
+  uint32_t hi = kernel_mul_segments((uint16_t)(h >> 16)) + (lo >> 16);
+
+  *segment = (uint16_t)(hi >> 16);
+  return (uint8_t)(hi >> 8);
+}}
+
+/* byte = (h * RECORD_SIZE) >> 32 */
+static inline uint8_t kernel_reduce_byte(uint32_t h) {{
+  uint32_t hi = kernel_mul_record_size((uint16_t)(h >> 16)) +
+                (kernel_mul_record_size((uint16_t)h) >> 16);
+
+  return (uint8_t)(hi >> 16);
+}}
+"""
+
+    def _fuse_modulo_helpers(self) -> str:
+        """Emit the modulo reductions of a binary fuse filter."""
+        return """/* segment = h % FUSE_SEGMENTS; returns the low byte of the quotient,
+ * the fingerprint */
+static inline uint8_t kernel_reduce_segment(uint32_t h, uint16_t *segment) {
+  *segment = (uint16_t)(h % FUSE_SEGMENTS);
+  return (uint8_t)(h / FUSE_SEGMENTS);
+}
+
+/* byte = h % RECORD_SIZE */
+static inline uint8_t kernel_reduce_byte(uint32_t h) {
+  return (uint8_t)(h % RECORD_SIZE);
+}
+"""
+
+    def _folds(self, config: BloomConfig) -> List[Tuple[str, int]]:
+        """The (fold, seed) of every running hash state, in state order.
+
+        Double hashing needs a Jenkins and a DJB2 state, Pearson hashing
+        two Pearson hashes; independent hashing one state per hash
+        function. A Golomb-coded set and a binary fuse filter use only
+        the first hash.
+        """
+        if config.hash_scheme == HASH_DOUBLE:
+            folds = [('jenkins', 0), ('djb2', 0)]
+        elif config.hash_scheme == HASH_PEARSON:
+            folds = [('pearson', 0), ('pearson', 1)]
+        else:
+            folds = [(HASH_FOLDS[i][0], i)
+                     for i in range(config.num_hash_functions)]
+        return folds[:config.running_hashes]
+
+    def _hash_states(self, config: BloomConfig) -> str:
+        """Emit the running hash state type and its functions.
+
+        Besides init and step, bloom_kernel_fingerprint() finishes the
+        first hash alone, for the C64's cache of recently checked words.
+        """
+        folds = self._folds(config)
+        if config.hash_scheme == HASH_PEARSON:
+            # Every lane is a byte of its own, keyed by hash and lane
+            lanes = [(i, seed, j) for i, (_, seed) in enumerate(folds)
+                     for j in range(PEARSON_LANES)]
+            fields = 'uint8_t lane[KERNEL_HASH_STATES][PEARSON_LANES];'
+            init = '\n'.join(f'  state->lane[{i}][{j}] = 0;'
+                             for i, _, j in lanes)
+            step = '\n'.join(f'  state->lane[{i}][{j}] = pearson_step('
+                             f'state->lane[{i}][{j}], c ^ pearson_key({seed}, {j}));'
+                             for i, seed, j in lanes)
+        else:
+            fields = 'uint32_t h[KERNEL_HASH_STATES];'
+            init = '\n'.join(f'  state->h[{i}] = {fold}_init({seed});'
+                             for i, (fold, seed) in enumerate(folds))
+            step = '\n'.join(f'  state->h[{i}] = {fold}_step(state->h[{i}], c);'
+                             for i, (fold, _) in enumerate(folds))
+        return f"""/* Running hash states of a word, advanced one character at a time */
+#define KERNEL_HASH_STATES {len(folds)}
+typedef struct {{
+  {fields}
+}} bloom_hash_state_t;
+
+/* Start the hashes of an empty word */
+static inline void bloom_kernel_init(bloom_hash_state_t *state) {{
+{init}
+}}
+
+/* Hash one more character */
+static void bloom_kernel_step(bloom_hash_state_t *state, uint8_t c) {{
+{step}
+}}
+
+/* The word's first finished hash, a 32-bit fingerprint of it */
+static inline uint32_t
+bloom_kernel_fingerprint(const bloom_hash_state_t *state) {{
+  return {self._hash_value(config, 0)};
+}}
+"""
+
+    def _hash_value(self, config: BloomConfig, index: int) -> str:
+        """C expression for the finished value of running hash index."""
+        if config.hash_scheme == HASH_DOUBLE:
+            # h1 is Jenkins one-at-a-time, h2 is DJB2 with the Jenkins
+            # avalanche, forced odd
+            if index == 0:
+                return 'jenkins_final(state->h[0])'
+            return 'jenkins_final(state->h[1]) | 1'
+        if config.hash_scheme == HASH_PEARSON:
+            value = f'pearson_value(state->lane[{index}])'
+            return value if index == 0 else f'{value} | 1'
+        if HASH_FOLDS[index][1] or config.avalanches(index):
+            return f'jenkins_final(state->h[{index}])'
+        return f'state->h[{index}]'
+
+    def hash_cycles(self, config: BloomConfig, length: int,
+                    common_words: bool = False) -> float:
+        """Estimated 6502 cycles to hash a word of length characters.
+
+        Steps every running state per character and finishes the values
+        the probes are derived from. With common_words, the common-word
+        table's Jenkins fold is charged too, which Pearson hashing has
+        no need of.
+        """
+        folds = self._folds(config)
+        cycles = length * sum(STEP_CYCLES[fold] for fold, _ in folds)
+        for index, (fold, _) in enumerate(folds):
+            if fold == 'pearson':
+                cycles += PEARSON_VALUE_CYCLES
+            elif (config.hash_scheme == HASH_DOUBLE or HASH_FOLDS[index][1] or
+                  config.avalanches(index)):
+                cycles += FINAL_CYCLES
+        if common_words and config.hash_scheme != HASH_PEARSON:
+            cycles += length * STEP_CYCLES['jenkins'] + FINAL_CYCLES
+        return cycles
+
+    def _multiply_shift_helpers(self, config: BloomConfig) -> str:
+        """Emit (h * n) >> 32 reductions built from 16-bit constant multiplies.
+
+        A record index is the high word of h * NUM_RECORDS; the low 32 bits
+        left over select the bit offset within the record. Together they
+        equal (h * BLOOM_SIZE_BITS) >> 32 exactly.
+        """
+        records = config.num_records
+        record_bits = config.record_bits
+        return f"""/* x * {records} */
+static inline uint32_t kernel_mul_records(uint16_t x) {{
+  return {self._constant_multiply('x', records)};
+}}
+
+/* x * {record_bits} */
+static inline uint32_t kernel_mul_record_bits(uint16_t x) {{
+  return {self._constant_multiply('x', record_bits)};
+}}
+
+/* record = (h * NUM_RECORDS) >> 32; returns the low 32 bits of the product */
+static inline uint32_t kernel_reduce_record(uint32_t h, uint16_t *record) {{
+  uint32_t lo = kernel_mul_records((uint16_t)h);
+  uint32_t hi = kernel_mul_records((uint16_t)(h >> 16)) + (lo >> 16);
+
+  *record = (uint16_t)(hi >> 16);
+  return (hi << 16) | (uint16_t)lo;
+}}
+
+/* offset = (h * RECORD_BITS) >> 32 */
+static inline uint16_t kernel_reduce_offset(uint32_t h) {{
+  uint32_t hi = kernel_mul_record_bits((uint16_t)(h >> 16)) +
+                (kernel_mul_record_bits((uint16_t)h) >> 16);
+
+  return (uint16_t)(hi >> 16);
+}}
+"""
+
+    def _modulo_helpers(self) -> str:
+        """Emit the classic modulo reductions, for filters built that way."""
+        return """/* record = h % NUM_RECORDS; returns h */
+static inline uint32_t kernel_reduce_record(uint32_t h, uint16_t *record) {
+  *record = (uint16_t)(h % NUM_RECORDS);
+  return h;
+}
+
+/* offset = h % RECORD_BITS */
+static inline uint16_t kernel_reduce_offset(uint32_t h) {
+  return (uint16_t)(h % RECORD_BITS);
+}
+
+/* Locate a global bit position */
+static inline void kernel_reduce_bit(uint32_t h, uint16_t *record,
+                                     uint16_t *offset) {
+  uint32_t bit = h % BLOOM_SIZE_BITS;
+
+  *record = (uint16_t)(bit / RECORD_BITS);
+  *offset = (uint16_t)(bit % RECORD_BITS);
+}
+"""
+
+    def _kernel_body(self, config: BloomConfig, remap: bool) -> str:
+        """Emit the unrolled statements that fill probes[]."""
+        double = config.hash_scheme in DOUBLE_HASHED
+        multiply_shift = config.range_reduction == RANGE_MULTIPLY_SHIFT
+        lines = []
+        if double:
+            lines.append(f'  uint32_t h1 = {self._hash_value(config, 0)};')
+            lines.append(f'  uint32_t h2 = {self._hash_value(config, 1)};')
+        if multiply_shift:
+            # Blocked: what the record's reduction leaves, for the offsets
+            lines.append('  uint32_t rest;' if config.is_blocked
+                         else '  uint32_t h;')
+        lines.append('  uint16_t record;')
+        if not multiply_shift and not config.is_blocked:
+            lines.append('  uint16_t offset;')
+        lines.append('')
+
+        for i in range(config.num_hash_functions):
+            if double:
+                value = 'h1'
+                if i > 0:
+                    lines.append('  h1 += h2;')
+            else:
+                value = self._hash_value(config, i)
+            lines.extend(self._probe_statements(config, i, value, remap))
+        return '\n'.join(lines) + '\n'
+
+    def _probe_statements(self, config: BloomConfig, index: int,
+                          value: str, remap: bool) -> List[str]:
+        """Emit the statements that turn hash number index into a probe."""
+        translate = ['  record = remap_record(record);'] if remap else []
+        if config.is_blocked:
+            multiply_shift = config.range_reduction == RANGE_MULTIPLY_SHIFT
+            if index == 0:
+                keep = 'rest = ' if multiply_shift else ''
+                return ([f'  {keep}kernel_reduce_record({value}, &record);'] +
+                        translate)
+            if multiply_shift:
+                value = f'{value} + rest'
+            return [f'  kernel_set_probe(&probes[{index - 1}], record, '
+                    f'kernel_reduce_offset({value}));']
+        if config.range_reduction == RANGE_MULTIPLY_SHIFT:
+            return ([f'  h = kernel_reduce_record({value}, &record);'] +
+                    translate +
+                    [f'  kernel_set_probe(&probes[{index}], record, '
+                     f'kernel_reduce_offset(h));'])
+        return ([f'  kernel_reduce_bit({value}, &record, &offset);'] +
+                translate +
+                [f'  kernel_set_probe(&probes[{index}], record, offset);'])
+
+    def _constant_multiply(self, name: str, constant: int) -> str:
+        """Emit name * constant as a sum of shifts, in uint32_t arithmetic."""
+        terms = min(self._binary_terms(constant), self._naf_terms(constant),
+                    key=len)
+        terms.sort(key=lambda term: (-term[0], -term[1]))
+        expression = ''
+        for sign, shift in terms:
+            operand = f'((uint32_t){name} << {shift})' if shift else f'(uint32_t){name}'
+            if not expression:
+                expression = operand
+            else:
+                expression += f' {"+" if sign > 0 else "-"} {operand}'
+        return expression
+
+    def _binary_terms(self, constant: int) -> List[Tuple[int, int]]:
+        """Shift terms from the set bits of constant."""
+        return [(1, bit) for bit in range(constant.bit_length())
+                if constant >> bit & 1]
+
+    def _naf_terms(self, constant: int) -> List[Tuple[int, int]]:
+        """Shift terms from the non-adjacent form (signed digits) of constant."""
+        terms = []
+        shift = 0
+        while constant:
+            if constant & 1:
+                digit = 2 - (constant & 3)
+                constant -= digit
+                terms.append((digit, shift))
+            constant >>= 1
+            shift += 1
+        return terms
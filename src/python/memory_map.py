@@ -0,0 +1,63 @@
+"""
+C64 memory map calculations for sizing RAM-resident buffers.
+
+Copyright (c) 2025 John Byrd
+https://github.com/johnwbyrd/bloomer
+
+SPDX-License-Identifier: BSD-3-Clause
+"""
+from dataclasses import dataclass, replace
+
+
+@dataclass(frozen=True)
+class MemoryMap:
+    """Immutable C64 RAM layout as seen by an LLVM-MOS program.
+
+    The program reserve sizes the disk too: build_bloom.py keeps room in
+    the image for a PRG that large.
+    """
+
+    ram_start: int = 0x0801       # BASIC start, where the PRG loads
+    ram_end: int = 0xD000         # BASIC ROM banked out, I/O at $D000
+    program_reserve: int = 16384  # Code, rodata, data and non-cache bss
+    minimal_program_reserve: int = 12288  # The same on the KERNAL-only runtime
+    stack_reserve: int = 2048     # LLVM-MOS soft stack below ram_end
+    record_size: int = 254
+    slot_overhead: int = 3        # Per-slot record number and CLOCK bit
+    max_slots: int = 255          # Slot numbers are bytes; 0xFF = empty
+
+    @property
+    def ram_bytes(self) -> int:
+        """Calculate total program-visible RAM."""
+        return self.ram_end - self.ram_start
+
+    @property
+    def available_bytes(self) -> int:
+        """Calculate RAM left over for the record cache."""
+        return self.ram_bytes - self.program_reserve - self.stack_reserve
+
+    def minimal(self) -> 'MemoryMap':
+        """The map of spellcheck_min, which leaves printf and stdio out."""
+        return replace(self, program_reserve=self.minimal_program_reserve)
+
+    def cache_slots(self, num_records: int, table_bytes: int = 0) -> int:
+        """Calculate how many records fit in the free RAM.
+
+        The cache also needs a one-byte record-to-slot table covering
+        every record in the filter, plus whatever other tables
+        (table_bytes) the configured features keep in RAM.
+        """
+        usable = self.available_bytes - num_records - table_bytes
+        slots = usable // (self.record_size + self.slot_overhead)
+        return max(1, min(slots, num_records, self.max_slots - 1))
+
+    def print_summary(self):
+        """Print memory map summary."""
+        print("=" * 80)
+        print("C64 MEMORY MAP")
+        print("=" * 80)
+        print(f"Program RAM: ${self.ram_start:04X}-${self.ram_end - 1:04X} "
+              f"({self.ram_bytes:,} bytes)")
+        print(f"  - Program reserve: {self.program_reserve:,} bytes")
+        print(f"  - Soft stack: {self.stack_reserve:,} bytes")
+        print(f"  = Available: {self.available_bytes:,} bytes")
@@ -0,0 +1,303 @@
+"""
+Self-unpacking PRG: LZ-compress the spell checker behind a 6502 unpacker.
+
+Copyright (c) 2025 John Byrd
+https://github.com/johnwbyrd/bloomer
+
+SPDX-License-Identifier: BSD-3-Clause
+"""
+import re
+from dataclasses import dataclass
+from typing import Dict, List, Tuple
+
+BASIC_START = 0x0801       # Where a C64 BASIC program, and the PRG, loads
+PACKED_TOP = 0xD000        # Packed data is moved up to end here, below I/O
+PAGE = 256
+SYS_TOKEN = 0x9E
+
+# Packed stream tokens: $00-$7F is 1-128 literal bytes, $80-$FE copies
+# 3-129 bytes from a 16-bit distance back in the output, $FF ends it
+LITERAL_MAX = 128
+MATCH_MIN = 3
+MATCH_MAX = 129
+MATCH_FLAG = 0x80
+END_OF_DATA = 0xFF
+HASH_CHAIN_LIMIT = 64      # Earlier positions tried per match search
+
+# Unpacker cycles per token, per output byte and per byte moved, for
+# load time estimates
+LITERAL_TOKEN_CYCLES = 35
+LITERAL_CYCLES = 56
+MATCH_TOKEN_CYCLES = 119
+MATCH_CYCLES = 44
+MOVE_CYCLES = 18
+
+# "10 SYS2061": the BASIC line in front of the unpacker, as in the program
+BASIC_LINE = bytes([0x0B, 0x08, 0x0A, 0x00, SYS_TOKEN]) + b'2061' + bytes(3)
+BASIC_ENTRY = BASIC_START + len(BASIC_LINE)
+
+# At BASIC_ENTRY: copy the unpacker into the cassette buffer and run it.
+# Its length and address are patched in.
+COPY_STUB = bytes([
+    0xA2, 0x00,        # 080D          LDX #LENGTH
+    0xBD, 0x00, 0x00,  # 080F  copy:   LDA UNPACKER-1,X
+    0x9D, 0x3B, 0x03,  # 0812          STA $033C-1,X
+    0xCA,              # 0815          DEX
+    0xD0, 0xF7,        # 0816          BNE copy
+    0x4C, 0x3C, 0x03,  # 0818          JMP $033C
+])
+STUB_LENGTH = 1
+STUB_SOURCE = 3
+
+# Runs in the cassette buffer ($033C) with BASIC banked out. Moves the
+# packed data up by whole pages so it ends at or below PACKED_TOP, then
+# unpacks forward from $0801 over the PRG it came in. The output never
+# overtakes the input; PrgCruncher checks that. IN = $FB/$FC, OUT =
+# $FD/$FE, REF = $22/$23, TMP = $02.
+UNPACKER = bytes([
+    0xA9, 0x36,        # 033C          LDA #$36
+    0x85, 0x01,        # 033E          STA $01        ; RAM up to $CFFF
+    0xA9, 0x00,        # 0340          LDA #$00
+    0x85, 0xFB,        # 0342          STA IN
+    0x85, 0xFD,        # 0344          STA OUT
+    0xA9, 0x00,        # 0346          LDA #TOP
+    0x85, 0xFC,        # 0348          STA IN+1       ; Page above the data
+    0xA9, 0x00,        # 034A          LDA #MOVED
+    0x85, 0xFE,        # 034C          STA OUT+1      ; The same, moved
+    0xA2, 0x00,        # 034E          LDX #PAGES
+    0xC6, 0xFC,        # 0350  page:   DEC IN+1
+    0xC6, 0xFE,        # 0352          DEC OUT+1
+    0xA0, 0x00,        # 0354          LDY #$00
+    0x88,              # 0356  byte:   DEY
+    0xB1, 0xFB,        # 0357          LDA (IN),Y
+    0x91, 0xFD,        # 0359          STA (OUT),Y
+    0x98,              # 035B          TYA
+    0xD0, 0xF8,        # 035C          BNE byte
+    0xCA,              # 035E          DEX
+    0xD0, 0xEF,        # 035F          BNE page
+    0xA9, 0x00,        # 0361          LDA #<DATA
+    0x85, 0xFB,        # 0363          STA IN
+    0xA9, 0x00,        # 0365          LDA #>DATA
+    0x85, 0xFC,        # 0367          STA IN+1       ; Moved packed data
+    0xA9, 0x01,        # 0369          LDA #$01
+    0x85, 0xFD,        # 036B          STA OUT
+    0xA9, 0x08,        # 036D          LDA #$08
+    0x85, 0xFE,        # 036F          STA OUT+1      ; Unpack to $0801
+    0x20, 0xBA, 0x03,  # 0371  next:   JSR getb
+    0xAA,              # 0374          TAX
+    0x10, 0x30,        # 0375          BPL lit        ; 1-128 literals
+    0xE8,              # 0377          INX
+    0xF0, 0x39,        # 0378          BEQ done       ; $FF: end of data
+    0x29, 0x7F,        # 037A          AND #$7F
+    0x18,              # 037C          CLC
+    0x69, 0x03,        # 037D          ADC #$03
+    0xAA,              # 037F          TAX            ; Copy 3-129 bytes
+    0x20, 0xBA, 0x03,  # 0380          JSR getb
+    0x85, 0x02,        # 0383          STA TMP
+    0xA5, 0xFD,        # 0385          LDA OUT
+    0x38,              # 0387          SEC
+    0xE5, 0x02,        # 0388          SBC TMP
+    0x85, 0x22,        # 038A          STA REF
+    0x20, 0xBA, 0x03,  # 038C          JSR getb       ; Keeps the borrow
+    0x85, 0x02,        # 038F          STA TMP
+    0xA5, 0xFE,        # 0391          LDA OUT+1
+    0xE5, 0x02,        # 0393          SBC TMP
+    0x85, 0x23,        # 0395          STA REF+1      ; OUT - distance
+    0xB1, 0x22,        # 0397  match:  LDA (REF),Y
+    0x20, 0xC3, 0x03,  # 0399          JSR putb
+    0xE6, 0x22,        # 039C          INC REF
+    0xD0, 0x02,        # 039E          BNE mnext
+    0xE6, 0x23,        # 03A0          INC REF+1
+    0xCA,              # 03A2  mnext:  DEX
+    0xD0, 0xF2,        # 03A3          BNE match
+    0xF0, 0xCA,        # 03A5          BEQ next
+    0xE8,              # 03A7  lit:    INX
+    0x20, 0xBA, 0x03,  # 03A8  lnext:  JSR getb
+    0x20, 0xC3, 0x03,  # 03AB          JSR putb
+    0xCA,              # 03AE          DEX
+    0xD0, 0xF7,        # 03AF          BNE lnext
+    0xF0, 0xBE,        # 03B1          BEQ next
+    0xA9, 0x37,        # 03B3  done:   LDA #$37
+    0x85, 0x01,        # 03B5          STA $01
+    0x4C, 0x00, 0x00,  # 03B7          JMP ENTRY
+    0xB1, 0xFB,        # 03BA  getb:   LDA (IN),Y
+    0xE6, 0xFB,        # 03BC          INC IN
+    0xD0, 0x02,        # 03BE          BNE gret
+    0xE6, 0xFC,        # 03C0          INC IN+1
+    0x60,              # 03C2  gret:   RTS
+    0x91, 0xFD,        # 03C3  putb:   STA (OUT),Y
+    0xE6, 0xFD,        # 03C5          INC OUT
+    0xD0, 0x02,        # 03C7          BNE pret
+    0xE6, 0xFE,        # 03C9          INC OUT+1
+    0x60,              # 03CB  pret:   RTS
+])
+UNPACKER_TOP = 11
+UNPACKER_MOVED = 15
+UNPACKER_PAGES = 19
+UNPACKER_DATA_LO = 38
+UNPACKER_DATA_HI = 42
+UNPACKER_ENTRY = 124
+
+HEADER = BASIC_LINE + COPY_STUB + UNPACKER
+
+
+def sys_address(prg: bytes) -> int:
+    """Machine code entry of a PRG that starts with a BASIC SYS line."""
+    if prg[0] | prg[1] << 8 != BASIC_START:
+        raise ValueError("Program does not load at $0801")
+    line = prg[6:prg.index(0, 6)]
+    match = re.fullmatch(rb'\x9e ?\(?(\d+)\)?', line)
+    if not match:
+        raise ValueError("Program does not start with a SYS line")
+    return int(match.group(1))
+
+
+def compress(data: bytes) -> bytes:
+    """Greedy LZ over a hash chain of 3-byte prefixes."""
+    out = bytearray()
+    literals = bytearray()
+    chains: Dict[bytes, List[int]] = {}
+
+    def flush():
+        for start in range(0, len(literals), LITERAL_MAX):
+            run = literals[start:start + LITERAL_MAX]
+            out.append(len(run) - 1)
+            out.extend(run)
+        literals.clear()
+
+    pos = 0
+    while pos < len(data):
+        best_len, best_dist = 0, 0
+        key = data[pos:pos + MATCH_MIN]
+        for earlier in reversed(chains.get(key, [])[-HASH_CHAIN_LIMIT:]):
+            length = MATCH_MIN
+            while (length < MATCH_MAX and pos + length < len(data) and
+                   data[earlier + length] == data[pos + length]):
+                length += 1
+            if length > best_len:
+                best_len, best_dist = length, pos - earlier
+                if length == MATCH_MAX:
+                    break
+        step = best_len if best_len >= MATCH_MIN else 1
+        for i in range(pos, min(pos + step, len(data) - MATCH_MIN + 1)):
+            chains.setdefault(data[i:i + MATCH_MIN], []).append(i)
+        if best_len >= MATCH_MIN:
+            flush()
+            out += bytes((MATCH_FLAG | (best_len - MATCH_MIN),
+                          best_dist & 0xFF, best_dist >> 8))
+        else:
+            literals.append(data[pos])
+        pos += step
+    flush()
+    out.append(END_OF_DATA)
+    return bytes(out)
+
+
+def decompress(packed: bytes) -> Tuple[bytes, int]:
+    """Unpack as the 6502 routine does; returns the data and its cycles.
+
+    The cycle count covers the unpack loop only, not the page move.
+    """
+    out = bytearray()
+    pos = cycles = 0
+    while packed[pos] != END_OF_DATA:
+        token = packed[pos]
+        if token < MATCH_FLAG:
+            out += packed[pos + 1:pos + 2 + token]
+            pos += token + 2
+            cycles += LITERAL_TOKEN_CYCLES + (token + 1) * LITERAL_CYCLES
+        else:
+            length = (token & ~MATCH_FLAG) + MATCH_MIN
+            start = len(out) - (packed[pos + 1] | packed[pos + 2] << 8)
+            for i in range(length):
+                out.append(out[start + i])
+            pos += 3
+            cycles += MATCH_TOKEN_CYCLES + length * MATCH_CYCLES
+    return bytes(out), cycles
+
+
+def is_crunched(prg: bytes) -> bool:
+    """True for a PRG that PrgCruncher produced."""
+    offset = 2 + len(BASIC_LINE) + len(COPY_STUB)
+    return prg[offset:offset + UNPACKER_TOP] == UNPACKER[:UNPACKER_TOP]
+
+
+def unpack_cycles(prg: bytes) -> int:
+    """C64 cycles a PRG from PrgCruncher takes to unpack itself."""
+    unpacker = 2 + len(BASIC_LINE) + len(COPY_STUB)
+    _, cycles = decompress(prg[unpacker + len(UNPACKER):])
+    return prg[unpacker + UNPACKER_PAGES] * PAGE * MOVE_CYCLES + cycles
+
+
+@dataclass
+class CrunchedProgram:
+    """A self-unpacking PRG and what it costs to unpack."""
+
+    prg: bytes
+    original_size: int
+    unpack_cycles: int  # Page move plus unpack loop
+
+    @property
+    def ratio(self) -> float:
+        return len(self.prg) / self.original_size
+
+
+class PrgCruncher:
+    """Pack a PRG that starts with "SYS 2061" into one that unpacks itself.
+
+    The packed PRG loads at $0801 like the original and starts with the
+    same BASIC line, so LOAD and RUN work as before. Its stub copies the
+    unpacker into the cassette buffer; the unpacker moves the packed data
+    to the top of RAM, rebuilds the original program from $0801 and jumps
+    to the original entry point.
+    """
+
+    def crunch(self, prg: bytes) -> CrunchedProgram:
+        entry = sys_address(prg)
+        body = prg[2:]
+        packed = compress(body)
+        unpacked, _ = decompress(packed)
+        if unpacked != body:
+            raise RuntimeError("Packed program does not unpack to the original")
+
+        data = BASIC_START + len(HEADER)       # Packed data as loaded
+        end = data + len(packed)
+        top_page = -(-end // PAGE)
+        shift = PACKED_TOP // PAGE - top_page  # Pages the data moves up
+        pages = top_page - data // PAGE
+        if shift < 0 or pages > 0xFF:
+            raise ValueError("Packed program does not fit below $D000")
+        moved = data + shift * PAGE
+        self._check_in_place(packed, moved)
+
+        stub = bytearray(COPY_STUB)
+        stub[STUB_LENGTH] = len(UNPACKER)
+        source = BASIC_ENTRY + len(COPY_STUB) - 1
+        stub[STUB_SOURCE:STUB_SOURCE + 2] = bytes((source & 0xFF, source >> 8))
+        unpacker = bytearray(UNPACKER)
+        unpacker[UNPACKER_TOP] = top_page
+        unpacker[UNPACKER_MOVED] = top_page + shift
+        unpacker[UNPACKER_PAGES] = pages
+        unpacker[UNPACKER_DATA_LO] = moved & 0xFF
+        unpacker[UNPACKER_DATA_HI] = moved >> 8
+        unpacker[UNPACKER_ENTRY:UNPACKER_ENTRY + 2] = bytes((entry & 0xFF,
+                                                             entry >> 8))
+        out = (bytes((BASIC_START & 0xFF, BASIC_START >> 8)) + BASIC_LINE +
+               bytes(stub) + bytes(unpacker) + packed)
+        return CrunchedProgram(out, len(prg), unpack_cycles(out))
+
+    @staticmethod
+    def _check_in_place(packed: bytes, moved: int):
+        """Fail if unpacking at $0801 would overwrite unread packed bytes."""
+        out, pos = BASIC_START, 0
+        while packed[pos] != END_OF_DATA:
+            token = packed[pos]
+            if token < MATCH_FLAG:
+                out += token + 1
+                pos += token + 2
+            else:
+                out += (token & ~MATCH_FLAG) + MATCH_MIN
+                pos += 3
+            if out > moved + pos:
+                raise ValueError("Packed program would overwrite itself "
+                                 "while unpacking")
@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+"""
+Report from a linker map how much C64 RAM the record cache could use.
+
+Copyright (c) 2025 John Byrd
+https://github.com/johnwbyrd/bloomer
+
+SPDX-License-Identifier: BSD-3-Clause
+"""
+import argparse
+import re
+import sys
+from dataclasses import dataclass
+from pathlib import Path
+from typing import Dict, List, Optional, Tuple
+
+from memory_map import MemoryMap
+
+# Arrays sized by BLOOM_CACHE_SLOTS: the records and their slot bookkeeping
+CACHE_SYMBOLS = ('record_cache', 'cache_slot_record', 'cache_referenced')
+STACK_SYMBOL = '__stack'
+
+# An lld map row: VMA, LMA, size and alignment in hex, then the name,
+# indented by 0 (output section or assignment), 8 (input section) or 16
+# (symbol) spaces
+MAP_ROW = re.compile(r'^\s*([0-9a-fA-F]+)\s+([0-9a-fA-F]+)\s+([0-9a-fA-F]+)'
+                     r'\s+(\d+) (\s*)(\S.*)$')
+SYMBOL_INDENT = 16
+
+
+@dataclass
+class LinkerMap:
+    """The output sections and symbols of an LLVM-MOS lld map file."""
+
+    sections: List[Tuple[str, int, int]]  # Name, address, size
+    symbols: Dict[str, Tuple[int, int]]   # Name: address, size
+
+    @classmethod
+    def load(cls, path: Path) -> 'LinkerMap':
+        sections = []
+        symbols = {}
+        for line in path.read_text().splitlines():
+            match = MAP_ROW.match(line)
+            if not match:
+                continue
+            vma, _, size, _, indent, name = match.groups()
+            vma, size = int(vma, 16), int(size, 16)
+            if '=' in name:  # Assignment: "__stack = 0xd000"
+                symbols[name.split('=')[0].strip()] = (vma, 0)
+            elif not indent:
+                sections.append((name, vma, size))
+            elif len(indent) >= SYMBOL_INDENT:
+                symbols[name] = (vma, size)
+        return cls(sections, symbols)
+
+    def ram_sections(self, memory: MemoryMap) -> List[Tuple[str, int, int]]:
+        """Sections that take up program RAM, in address order."""
+        return sorted((section for section in self.sections
+                       if section[2] and
+                       memory.ram_start <= section[1] < memory.ram_end),
+                      key=lambda section: section[1])
+
+    def program_end(self, memory: MemoryMap) -> int:
+        """First address above everything the program loads or clears."""
+        return max((address + size
+                    for _, address, size in self.ram_sections(memory)),
+                   default=memory.ram_start)
+
+    @property
+    def cache_bytes(self) -> int:
+        """RAM taken by the record cache and its per-slot tables."""
+        return sum(self.symbols.get(name, (0, 0))[1] for name in CACHE_SYMBOLS)
+
+    def program_bytes(self, memory: MemoryMap) -> int:
+        """RAM the program takes besides the record cache."""
+        return (self.program_end(memory) - memory.ram_start -
+                self.cache_bytes)
+
+
+def report(path: Path, memory: MemoryMap, baseline: Optional[Path]) -> int:
+    """Print where the program ends and what is left for the cache.
+
+    Returns the free RAM left above the stack reserve; negative when the
+    record cache runs into it.
+    """
+    linker_map = LinkerMap.load(path)
+    end = linker_map.program_end(memory)
+    stack = linker_map.symbols.get(STACK_SYMBOL, (memory.ram_end, 0))[0]
+    free = stack - memory.stack_reserve - end
+    slot_bytes = memory.record_size + memory.slot_overhead
+
+    print("=" * 80)
+    print(f"RAM REPORT ({path.name})")
+    print("=" * 80)
+    for name, address, size in linker_map.ram_sections(memory):
+        print(f"{name:<16} ${address:04X}-${address + size - 1:04X} "
+              f"{size:>7,} bytes")
+    print(f"Program end: ${end:04X}; soft stack from ${stack:04X} down, "
+          f"{memory.stack_reserve:,} bytes kept for it")
+    cache = linker_map.symbols.get('record_cache', (0, 0))[1]
+    print(f"Record cache: {cache // memory.record_size} slots = "
+          f"{cache:,} bytes")
+    print(f"Program without the cache: "
+          f"{linker_map.program_bytes(memory):,} bytes")
+    if free >= 0:
+        print(f"Free RAM: {free:,} bytes, room for {free // slot_bytes} "
+              f"more slots")
+    else:
+        print(f"Over the stack reserve by {-free:,} bytes")
+    print(f"RAM for the record cache: {linker_map.cache_bytes + free:,} bytes")
+    print(f"Program reserve: {memory.program_reserve - free:,} bytes would "
+          f"do; memory_map.py assumes {memory.program_reserve:,}")
+
+    if baseline:
+        saved = (LinkerMap.load(baseline).program_bytes(memory) -
+                 linker_map.program_bytes(memory))
+        print(f"Against {baseline.name}: {saved:,} bytes freed for the "
+              f"cache, {saved // slot_bytes} more records that never need "
+              f"a seek")
+    return free
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('map', type=Path, help="lld map file of the program")
+    parser.add_argument('--minimal', action='store_true',
+                        help="the map is spellcheck_min's, built without "
+                             "printf and stdio")
+    parser.add_argument('--baseline', type=Path,
+                        help="map of another build of the program to "
+                             "compare against")
+    parser.add_argument('--check', action='store_true',
+                        help="exit with an error if the program and its "
+                             "record cache reach into the stack reserve")
+    args = parser.parse_args()
+
+    memory = MemoryMap()
+    if args.minimal:
+        memory = memory.minimal()
+    baseline = args.baseline if args.baseline and args.baseline.exists() else None
+    free = report(args.map, memory, baseline)
+    if args.check and free < 0:
+        reserve = ('minimal_program_reserve' if args.minimal
+                   else 'program_reserve')
+        print(f"{args.map.name}: the record cache overlaps the soft stack by "
+              f"{-free:,} bytes; raise {reserve} in memory_map.py to at "
+              f"least {memory.program_reserve - free:,} and rebuild")
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
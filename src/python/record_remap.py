@@ -0,0 +1,106 @@
+"""
+Heat-ordered placement of Bloom filter records in BLOOM.DAT.
+
+Copyright (c) 2025 John Byrd
+https://github.com/johnwbyrd/bloomer
+
+SPDX-License-Identifier: BSD-3-Clause
+"""
+from typing import Iterable, List, Sequence, Tuple
+
+# Bits above the low byte of each physical record number are packed into
+# 2, 4 or 8-bit fields: 2 bits reach 1024 records, a 1541's 571 or a 1571's
+# 720; 4 bits reach a 1581 or a striped pair of drives.
+REMAP_HIGH_BITS = (2, 4, 8)
+MAX_REMAP_RECORDS = 1 << (8 + REMAP_HIGH_BITS[-1])
+
+
+def remap_high_bits(num_records: int) -> int:
+    """Width of the packed high part of each record number."""
+    for bits in REMAP_HIGH_BITS:
+        if num_records <= 1 << (8 + bits):
+            return bits
+    raise ValueError(f"Record remap supports at most {MAX_REMAP_RECORDS} "
+                     f"records")
+
+
+def remap_table_bytes(num_records: int) -> int:
+    """Size of the packed remap table for num_records records."""
+    per_byte = 8 // remap_high_bits(num_records)
+    return num_records + -(-num_records // per_byte)
+
+
+class RecordRemap:
+    """Logical-to-physical record permutation.
+
+    Logical records are what the hashes select; physical records are block
+    positions in BLOOM.DAT. Putting the hottest logical records first makes
+    them the first blocks the disk creator allocates, on adjacent tracks
+    next to the directory.
+    """
+
+    def __init__(self, physical_of: Sequence[int]):
+        if sorted(physical_of) != list(range(len(physical_of))):
+            raise ValueError("Record remap is not a permutation")
+        if len(physical_of) > MAX_REMAP_RECORDS:
+            raise ValueError(f"Record remap supports at most "
+                             f"{MAX_REMAP_RECORDS} records")
+        self.physical_of = list(physical_of)
+
+    @classmethod
+    def identity(cls, num_records: int) -> 'RecordRemap':
+        """The layout with every record in its own place."""
+        return cls(range(num_records))
+
+    @classmethod
+    def from_ranking(cls, ranked: Iterable[int],
+                     num_records: int) -> 'RecordRemap':
+        """Place ranked records first, then the rest in ascending order."""
+        order = list(dict.fromkeys(ranked))
+        chosen = set(order)
+        order.extend(r for r in range(num_records) if r not in chosen)
+        physical_of = [0] * num_records
+        for physical, logical in enumerate(order):
+            physical_of[logical] = physical
+        return cls(physical_of)
+
+    def __len__(self) -> int:
+        return len(self.physical_of)
+
+    def physical(self, logical: int) -> int:
+        """Block position of a logical record."""
+        return self.physical_of[logical]
+
+    @property
+    def is_identity(self) -> bool:
+        """True if no record moves."""
+        return all(p == r for r, p in enumerate(self.physical_of))
+
+    def apply(self, data: bytes, record_size: int) -> bytes:
+        """Reorder filter data from logical into physical record order."""
+        out = bytearray(len(data))
+        for logical, physical in enumerate(self.physical_of):
+            out[physical * record_size:(physical + 1) * record_size] = \
+                data[logical * record_size:(logical + 1) * record_size]
+        return bytes(out)
+
+    @property
+    def high_bits(self) -> int:
+        """Width of each packed high part."""
+        return remap_high_bits(len(self))
+
+    def packed(self) -> Tuple[List[int], List[int]]:
+        """Low bytes, and the high parts packed 8 // high_bits to a byte."""
+        bits = self.high_bits
+        per_byte = 8 // bits
+        low = [p & 0xFF for p in self.physical_of]
+        high = [0] * (-(-len(self) // per_byte))
+        for logical, physical in enumerate(self.physical_of):
+            shift = (logical % per_byte) * bits
+            high[logical // per_byte] |= (physical >> 8) << shift
+        return low, high
+
+    @property
+    def size_bytes(self) -> int:
+        """C64 RAM used by the packed table."""
+        return remap_table_bytes(len(self))
@@ -0,0 +1,279 @@
+"""
+Rotation-aware placement of BLOOM.DAT's and the program's blocks.
+
+Copyright (c) 2025 John Byrd
+https://github.com/johnwbyrd/bloomer
+
+SPDX-License-Identifier: BSD-3-Clause
+"""
+import math
+from dataclasses import dataclass
+from typing import Iterable, List, Optional, Set, Tuple
+from d64_image import (D64Image, ENTRIES_PER_SECTOR, ENTRY_SIZE, FILENAME_PAD,
+                       FILE_TYPE_PRG, FILE_TYPE_REL, SIDE_SECTOR_DATA_OFFSET,
+                       SIDE_SECTOR_NUMBER, SUPER_SIDE_SECTOR)
+from disk_geometry import DiskGeometry, SIDE_SECTOR_ENTRIES, SIDE_SECTOR_GROUP
+
+FILE_CLOSED = 0x80        # Directory file type bit: properly closed
+SIDE_SECTOR_LIST_OFFSET = 4  # T/S of the side sectors in this side sector's group
+SUPER_SIDE_LIST_OFFSET = 3   # T/S of each group's first side sector
+
+
+@dataclass(frozen=True)
+class Interleave:
+    """Sector gap between consecutive blocks of the file.
+
+    A fixed gap is used on every track. Otherwise the gap is one sector
+    for the block itself plus the sectors that pass under the head while
+    the C64 consumes it, so the next block arrives just as the next read
+    is issued. Zones with more sectors per track get a larger gap for the
+    same time.
+    """
+
+    sectors: Optional[int] = None   # Fixed gap on every track
+    consume_ms: float = 0.0         # C64 time from one block read to the next
+    revolution_ms: float = 200.0
+
+    def gap(self, sectors_per_track: int) -> int:
+        """Sectors to skip after a block on a track of the given size."""
+        if self.sectors is not None:
+            return self.sectors
+        return 1 + math.ceil(self.consume_ms * sectors_per_track /
+                             self.revolution_ms)
+
+    def describe(self) -> str:
+        """Short human-readable form for build output."""
+        if self.sectors is not None:
+            return f"{self.sectors} sectors"
+        return f"{self.consume_ms:.0f}ms per block"
+
+
+def track_order(geometry: DiskGeometry) -> List[int]:
+    """Tracks outward from the directory: inward side first, then outward.
+
+    Filling 17 down to 1 and then 19 up to 35 keeps the first records next
+    to the directory while ascending record numbers still only move the
+    head in one direction per side. Tracks the DOS reserves are skipped.
+    """
+    inner = range(geometry.directory_track - 1, 0, -1)
+    outer = range(geometry.directory_track + 1, geometry.tracks + 1)
+    return [track for track in list(inner) + list(outer)
+            if geometry.is_data_track(track)]
+
+
+class BlockAllocator:
+    """Hand out free blocks along track_order() with a per-track interleave."""
+
+    def __init__(self, geometry: DiskGeometry,
+                 free_blocks: Iterable[Tuple[int, int]]):
+        self.geometry = geometry
+        self.free: Set[Tuple[int, int]] = set(free_blocks)
+
+    def allocate(self, count: int,
+                 interleave: Interleave) -> List[Tuple[int, int]]:
+        """Allocate count blocks in chain order.
+
+        Each block goes gap sectors after the previous one on the same
+        track, or the next free sector after that. A new track starts at
+        its lowest free sector, since the rotational position of sector 0
+        differs from track to track.
+        """
+        blocks = []
+        for track in track_order(self.geometry):
+            sectors = self.geometry.sectors_per_track(track)
+            free = sorted(s for s in range(sectors) if (track, s) in self.free)
+            if not free:
+                continue
+            gap = interleave.gap(sectors)
+            sector = free[0]
+            while free and len(blocks) < count:
+                while sector not in free:
+                    sector = (sector + 1) % sectors
+                free.remove(sector)
+                self.free.discard((track, sector))
+                blocks.append((track, sector))
+                sector = (sector + gap) % sectors
+            if len(blocks) == count:
+                return blocks
+        raise RuntimeError(f"Disk full: {count - len(blocks)} blocks short")
+
+
+def plan_rel_blocks(geometry: DiskGeometry,
+                    free_blocks: Iterable[Tuple[int, int]], num_records: int,
+                    interleave: Interleave
+                    ) -> Tuple[List[Tuple[int, int]], List[Tuple[int, int]]]:
+    """Choose (side sectors, data blocks) for a REL file of block-sized records.
+
+    Side sector N is placed in the chain just ahead of the 120 data blocks
+    it lists, so the DOS finds it near them.
+    """
+    num_sides = -(-num_records // SIDE_SECTOR_ENTRIES)
+    if num_sides > geometry.max_side_sectors:
+        raise ValueError(f"{num_records} records need more than "
+                         f"{geometry.max_side_sectors} side sectors")
+
+    chain = BlockAllocator(geometry, free_blocks).allocate(
+        num_records + num_sides, interleave)
+    sides, blocks = [], []
+    for index, block in enumerate(chain):
+        if index % (SIDE_SECTOR_ENTRIES + 1) == 0:
+            sides.append(block)
+        else:
+            blocks.append(block)
+    return sides, blocks
+
+
+class RelFileWriter:
+    """Write REL and program files into a raw .d64 image with chosen block
+    placement."""
+
+    def __init__(self, image: bytearray, geometry: DiskGeometry = DiskGeometry()):
+        self.image = image
+        self.geometry = geometry
+
+    def free_blocks(self) -> List[Tuple[int, int]]:
+        """Blocks the BAM marks free, excluding the DOS's own tracks."""
+        blocks = []
+        for track in range(1, self.geometry.tracks + 1):
+            if not self.geometry.is_data_track(track):
+                continue
+            _, _, bitmap, offset = self.geometry.bam_location(track)
+            bits = self._block_offset(*bitmap) + offset
+            for sector in range(self.geometry.sectors_per_track(track)):
+                if self.image[bits + sector // 8] & (1 << (sector % 8)):
+                    blocks.append((track, sector))
+        return blocks
+
+    def write(self, name: bytes, data: bytes, interleave: Interleave,
+              record_len: int = 254) -> List[Tuple[int, int]]:
+        """Store data as a REL file; returns the data blocks in record order."""
+        if record_len != self.geometry.rel_record_size:
+            raise ValueError("Only block-sized REL records are supported")
+
+        num_records = -(-len(data) // record_len)
+        free = self.free_blocks()
+        super_side = None
+        if self.geometry.super_side_sector:
+            super_side = BlockAllocator(self.geometry, free).allocate(
+                1, interleave)[0]
+            free.remove(super_side)
+        sides, blocks = plan_rel_blocks(self.geometry, free, num_records,
+                                        interleave)
+
+        padded = data.ljust(num_records * record_len, b'\x00')
+        for record, (track, sector) in enumerate(blocks):
+            if record + 1 < len(blocks):
+                link = blocks[record + 1]
+            else:
+                link = (0, record_len + 1)  # Offset of the last byte used
+            payload = padded[record * record_len:(record + 1) * record_len]
+            self._put_block(track, sector, bytes(link) + payload)
+
+        for index, (track, sector) in enumerate(sides):
+            entries = blocks[index * SIDE_SECTOR_ENTRIES:
+                             (index + 1) * SIDE_SECTOR_ENTRIES]
+            if index + 1 < len(sides):
+                link = sides[index + 1]
+            else:
+                link = (0, SIDE_SECTOR_DATA_OFFSET + 2 * len(entries) - 1)
+            group = index - index % SIDE_SECTOR_GROUP
+            side = bytearray(self.geometry.bytes_per_sector)
+            side[0:2] = bytes(link)
+            side[SIDE_SECTOR_NUMBER] = index % SIDE_SECTOR_GROUP
+            side[3] = record_len
+            for i, (t, s) in enumerate(sides[group:group + SIDE_SECTOR_GROUP]):
+                side[SIDE_SECTOR_LIST_OFFSET + 2 * i:
+                     SIDE_SECTOR_LIST_OFFSET + 2 * i + 2] = bytes((t, s))
+            for i, (t, s) in enumerate(entries):
+                side[SIDE_SECTOR_DATA_OFFSET + 2 * i:
+                     SIDE_SECTOR_DATA_OFFSET + 2 * i + 2] = bytes((t, s))
+            self._put_block(track, sector, bytes(side))
+
+        used = sides + blocks
+        if super_side:
+            self._put_super_side_sector(super_side, sides)
+            used.append(super_side)
+        for block in used:
+            self._mark_used(*block)
+        self._add_directory_entry(name, FILE_TYPE_REL, blocks[0], len(used),
+                                  super_side or sides[0], record_len)
+        return blocks
+
+    def write_program(self, name: bytes, data: bytes, interleave: Interleave,
+                      directory: bool = True) -> List[Tuple[int, int]]:
+        """Store a PRG (load address first) as a chain; returns its blocks.
+
+        Without directory, the blocks are allocated but the file is only
+        listed by a later add_program_entry(), so that a file written
+        after it can take an earlier directory slot.
+        """
+        size = self.geometry.rel_record_size
+        chunks = [data[i:i + size] for i in range(0, len(data), size)]
+        blocks = BlockAllocator(self.geometry, self.free_blocks()).allocate(
+            len(chunks), interleave)
+        for index, (block, chunk) in enumerate(zip(blocks, chunks)):
+            if index + 1 < len(blocks):
+                link = blocks[index + 1]
+            else:
+                link = (0, len(chunk) + 1)  # Offset of the last byte used
+            self._put_block(*block, bytes(link) + chunk)
+            self._mark_used(*block)
+        if directory:
+            self.add_program_entry(name, blocks)
+        return blocks
+
+    def add_program_entry(self, name: bytes, blocks: List[Tuple[int, int]]):
+        """List a program written by write_program()."""
+        self._add_directory_entry(name, FILE_TYPE_PRG, blocks[0], len(blocks))
+
+    def _put_super_side_sector(self, block: Tuple[int, int],
+                               sides: List[Tuple[int, int]]):
+        """Link a 1581 super side sector to the first side sector of each group."""
+        content = bytearray(self.geometry.bytes_per_sector)
+        content[0:2] = bytes(sides[0])
+        content[SIDE_SECTOR_NUMBER] = SUPER_SIDE_SECTOR
+        for i, (t, s) in enumerate(sides[::SIDE_SECTOR_GROUP]):
+            content[SUPER_SIDE_LIST_OFFSET + 2 * i:
+                    SUPER_SIDE_LIST_OFFSET + 2 * i + 2] = bytes((t, s))
+        self._put_block(*block, bytes(content))
+
+    def _block_offset(self, track: int, sector: int) -> int:
+        return self.geometry.sector_index(track, sector) * self.geometry.bytes_per_sector
+
+    def _put_block(self, track: int, sector: int, content: bytes):
+        offset = self._block_offset(track, sector)
+        size = self.geometry.bytes_per_sector
+        self.image[offset:offset + size] = content.ljust(size, b'\x00')
+
+    def _mark_used(self, track: int, sector: int):
+        """Clear a block's BAM bit and decrement the track's free count."""
+        count, count_offset, bitmap, offset = self.geometry.bam_location(track)
+        bits = self._block_offset(*bitmap) + offset + sector // 8
+        bit = 1 << (sector % 8)
+        if not self.image[bits] & bit:
+            raise RuntimeError(f"Block {track}/{sector} is already in use")
+        self.image[bits] &= ~bit & 0xFF
+        self.image[self._block_offset(*count) + count_offset] -= 1
+
+    def _add_directory_entry(self, name: bytes, file_type: int,
+                             first: Tuple[int, int], blocks: int,
+                             side: Tuple[int, int] = (0, 0),
+                             record_len: int = 0):
+        """Fill the first unused slot in the existing directory sectors."""
+        directory = D64Image(bytes(self.image), self.geometry)
+        for track, sector, block in directory.chain(self.geometry.directory_track,
+                                                    self.geometry.directory_sector):
+            for i in range(ENTRIES_PER_SECTOR):
+                if block[i * ENTRY_SIZE + 2] != 0:
+                    continue
+                entry = self._block_offset(track, sector) + i * ENTRY_SIZE
+                self.image[entry + 2] = FILE_CLOSED | file_type
+                self.image[entry + 3:entry + 5] = bytes(first)
+                self.image[entry + 5:entry + 21] = name.ljust(16, bytes([FILENAME_PAD]))
+                self.image[entry + 21:entry + 23] = bytes(side)
+                self.image[entry + 23] = record_len
+                self.image[entry + 24:entry + 30] = bytes(6)
+                self.image[entry + 30] = blocks & 0xFF
+                self.image[entry + 31] = blocks >> 8
+                return
+        raise RuntimeError("Directory is full")
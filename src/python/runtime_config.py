@@ -0,0 +1,348 @@
+"""
+C64 runtime configuration.
+
+Copyright (c) 2025 John Byrd
+https://github.com/johnwbyrd/bloomer
+
+SPDX-License-Identifier: BSD-3-Clause
+"""
+from dataclasses import dataclass, replace
+from typing import Optional, Tuple
+from bloom_config import BloomConfig, HASH_PEARSON
+from common_words import INDEX_ENTRIES, MAX_COMMON_WORDS
+from hash_functions import PEARSON_TABLE
+from memory_map import MemoryMap
+from record_remap import remap_table_bytes
+
+# Disk access modes. 'rel' positions the REL channel with P commands and
+# reads whole records into the cache; 'rel_byte' positions to the byte a
+# probe needs and reads only that, caching just the preloaded records
+# (or every record it reads, when it finds JiffyDOS at startup).
+# 'direct' reads BLOOM.DAT's side sectors once at startup and then
+# fetches records with U1 block reads on a direct access channel. 'drive'
+# uses the same map but uploads a probe routine into the 1541, which reads
+# the blocks and tests the bits itself, so records never cross the bus.
+# A filter striped across drives is read like 'direct', except that blocks
+# are read through each drive's job queue, so all drives seek at once.
+ACCESS_REL = 'rel'
+ACCESS_REL_BYTE = 'rel_byte'
+ACCESS_DIRECT = 'direct'
+ACCESS_DRIVE = 'drive'
+ACCESS_MODES = (ACCESS_REL, ACCESS_REL_BYTE, ACCESS_DIRECT, ACCESS_DRIVE)
+
+# Batch mode RAM per word: text pool, line number, alive flag, hash chain
+BATCH_BYTES_PER_WORD = 8 + 2 + 1 + 1
+BATCH_BYTES_PER_PROBE = 5  # Record, byte, mask and owning word
+BATCH_BUCKETS = 64
+BATCH_TEXT_SLACK = 64      # Room for one maximum-length word
+MAX_BATCH_WORDS = 255      # Word indices are bytes
+
+# Suggestions: the edits behind the corrections found, kept for printing.
+# Candidates share batch mode's sweep, batch_words at a time.
+SUGGEST_MAX = 10
+SUGGEST_BYTES_PER_WORD = 3  # Position, kind of edit and letter
+
+# Recently checked words: a 32-bit fingerprint, a hash chain link and the
+# result with its CLOCK reference bit. Batch mode keeps each queued word's
+# fingerprint so its result can be remembered after the sweep.
+RECENT_BYTES_PER_WORD = 4 + 1 + 1
+RECENT_BUCKETS = 64
+MAX_RECENT_WORDS = 255      # Entry indices are bytes
+FINGERPRINT_BYTES = 4
+
+REU_RECORDS_PER_BANK = 256  # One record per 256-byte REU page
+PRG_LOAD_ADDRESS_BYTES = 2
+
+# Type-ahead RAM: the line being typed, its queue of words (start, end,
+# state) and the probes of the word being checked in the background
+TYPE_AHEAD_LINE = 64
+TYPE_AHEAD_WORDS = 16
+TYPE_AHEAD_BYTES_PER_WORD = 3
+TYPE_AHEAD_BYTES_PER_PROBE = 4
+TYPE_AHEAD_HASH_DEPTH = 16  # Letters of a word hashed as it is typed
+
+
+@dataclass
+class RuntimeConfig:
+    """Spell checker runtime options that size RAM structures on the C64."""
+
+    memory: MemoryMap
+    cache_slots: Optional[int] = None  # None = as many as the memory map allows
+    preload_hot_records: bool = True
+    preload_sizes: Tuple[int, ...] = (10, 20, 35)  # SCOWL sizes as frequency proxy
+    preload_count: Optional[int] = None  # None = fill the whole cache
+    preload_seconds: Optional[float] = 5.0  # Startup time budget; None = no limit
+    access: str = ACCESS_REL
+    batch_words: int = 128             # Words per document sweep; 0 = no batch mode
+    common_words: int = 2048           # Words in the RAM common-word table
+    common_words_corpus: Optional[str] = None  # Text file to measure hits on
+    recent_words: int = 255            # Results of recently checked words kept
+    profile: bool = False              # Per-phase CIA timer breakdown per word
+    interleave: Optional[int] = None   # BLOOM.DAT sector gap; None = match access
+    heat_order: bool = True            # Place hot records first in BLOOM.DAT
+    heat_corpus: Optional[str] = None  # Text file to rank records by; None = SCOWL
+    reu: bool = True                   # Load the filter into a 17xx REU if present
+    type_ahead: bool = True            # Check words while the user types
+    suggest: bool = True               # '?WORD' lists one-edit corrections
+    fast_serial: bool = True           # Look for JiffyDOS at startup
+
+    def __post_init__(self):
+        if self.access not in ACCESS_MODES:
+            raise ValueError(f"Unknown disk access mode: {self.access}")
+        if not 0 <= self.batch_words <= MAX_BATCH_WORDS:
+            raise ValueError(f"batch_words must be between 0 and {MAX_BATCH_WORDS}")
+        if self.suggest and not self.batch_words:
+            raise ValueError("suggest sweeps its candidates through batch "
+                             "mode's buffers; it needs batch_words")
+        if not 0 <= self.common_words <= MAX_COMMON_WORDS:
+            raise ValueError(f"common_words must be between 0 and {MAX_COMMON_WORDS}")
+        if not 0 <= self.recent_words <= MAX_RECENT_WORDS:
+            raise ValueError(f"recent_words must be between 0 and "
+                             f"{MAX_RECENT_WORDS}")
+        if self.preload_seconds is not None and self.preload_seconds < 0:
+            raise ValueError("preload_seconds cannot be negative")
+        if self.interleave is not None and self.interleave < 1:
+            raise ValueError("interleave must be at least 1 sector")
+
+    def validate(self, config: BloomConfig):
+        """Check the options against the filter's drives."""
+        geometry = config.geometry
+        if config.is_gcs and self.access in (ACCESS_REL_BYTE, ACCESS_DRIVE):
+            raise ValueError(f"The gcs layout decodes whole records in C64 "
+                             f"RAM; {self.access} access cannot serve them")
+        if config.is_fuse and self.access == ACCESS_DRIVE:
+            raise ValueError("The fuse layout XORs bytes from three records; "
+                             "the drive code only tests bits")
+        if self.access == ACCESS_DRIVE and not geometry.job_queue:
+            raise ValueError(f"drive access needs a 1541-compatible job "
+                             f"queue, which the {geometry.drive} lacks")
+        if config.is_striped:
+            if self.access != ACCESS_DIRECT:
+                raise ValueError(f"A striped filter needs {ACCESS_DIRECT} "
+                                 f"access")
+            if not geometry.job_queue:
+                raise ValueError(f"Striping needs a 1541-compatible job "
+                                 f"queue, which the {geometry.drive} lacks")
+
+    @property
+    def common_word_bytes(self) -> int:
+        """Upper bound on RAM used by the common-word table."""
+        if not self.common_words:
+            return 0
+        return 2 * INDEX_ENTRIES + 2 * self.common_words
+
+    def batch_bytes(self, config: BloomConfig) -> int:
+        """RAM used by batch document mode."""
+        if not self.batch_words:
+            return 0
+        # A fuse filter also folds each word's bytes into one XOR byte
+        per_word = BATCH_BYTES_PER_WORD + int(config.is_fuse)
+        return (self.batch_words * per_word +
+                self.batch_words * config.probes_per_word * BATCH_BYTES_PER_PROBE +
+                BATCH_BUCKETS + BATCH_TEXT_SLACK)
+
+    @property
+    def recent_bytes(self) -> int:
+        """RAM used by the results of recently checked words."""
+        if not self.recent_words:
+            return 0
+        return (self.recent_words * RECENT_BYTES_PER_WORD + RECENT_BUCKETS +
+                self.batch_words * FINGERPRINT_BYTES)
+
+    @property
+    def suggest_bytes(self) -> int:
+        """RAM used by suggestions beyond the batch mode sweep they share."""
+        return SUGGEST_MAX * SUGGEST_BYTES_PER_WORD if self.suggest else 0
+
+    @property
+    def uses_record_map(self) -> bool:
+        """True if records are located through a RAM track/sector map."""
+        return self.access in (ACCESS_DIRECT, ACCESS_DRIVE)
+
+    @property
+    def uses_record_cache(self) -> bool:
+        """True if records are read into C64 RAM (not in drive mode)."""
+        return self.access != ACCESS_DRIVE
+
+    @property
+    def uses_reu(self) -> bool:
+        """True if the program loads the filter into an REU when it finds one.
+
+        Drive mode never reads records into the C64, so it has nothing to
+        copy into an REU.
+        """
+        return self.reu and self.uses_record_cache
+
+    @property
+    def uses_fast_serial(self) -> bool:
+        """True if the program looks for JiffyDOS when it starts.
+
+        Every mode's bus reads go through the KERNAL, so a JiffyDOS KERNAL
+        and drive speed them all up. Only rel_byte changes what it reads:
+        with whole records that cheap, it caches them as rel does.
+        """
+        return self.fast_serial and self.access == ACCESS_REL_BYTE
+
+    def type_ahead_bytes(self, config: BloomConfig) -> int:
+        """RAM used by the type-ahead line editor."""
+        if not self.type_ahead:
+            return 0
+        # Running hashes: one set per typed letter, plus a copy per word.
+        # The common-word table has a Jenkins state of its own, except
+        # under Pearson hashing, which keys it on the kernel's first hash.
+        own_common = (self.common_words and
+                      config.hash_scheme != HASH_PEARSON)
+        hash_bytes = 4 * config.running_hashes + (4 if own_common else 0)
+        return (TYPE_AHEAD_LINE +
+                TYPE_AHEAD_WORDS * (TYPE_AHEAD_BYTES_PER_WORD + 1 + hash_bytes) +
+                (TYPE_AHEAD_HASH_DEPTH + 1) * hash_bytes +
+                config.probes_per_word * TYPE_AHEAD_BYTES_PER_PROBE)
+
+    def table_bytes(self, config: BloomConfig) -> int:
+        """RAM used by fixed tables that compete with the record cache."""
+        total = (self.batch_bytes(config) + self.common_word_bytes +
+                 self.recent_bytes + self.type_ahead_bytes(config) +
+                 self.suggest_bytes)
+        if self.heat_order:
+            total += remap_table_bytes(config.num_records)
+        if self.uses_record_map:
+            total += 2 * config.num_records + 256  # Track/sector map, block buffer
+        if config.is_gcs:
+            total += 3 * config.num_records  # Record base index
+        if config.hash_scheme == HASH_PEARSON:
+            total += len(PEARSON_TABLE)
+        return total
+
+    def program_file_bytes(self, config: BloomConfig) -> int:
+        """Largest spellcheck.prg the memory map allows, load address included.
+
+        The program reserve covers code, rodata, data and bss; of the
+        tables beyond it, the ones bloom_config.h initializes are in the
+        file too. The disk keeps this much room for the program.
+        """
+        total = PRG_LOAD_ADDRESS_BYTES + self.memory.program_reserve
+        total += self.common_word_bytes
+        if self.heat_order:
+            total += remap_table_bytes(config.num_records)
+        if config.is_gcs:
+            total += 3 * config.num_records
+        if config.hash_scheme == HASH_PEARSON:
+            total += len(PEARSON_TABLE)
+        return total
+
+    def record_cache_slots(self, config: BloomConfig) -> int:
+        """Number of record cache slots to compile into the program."""
+        if not self.uses_record_cache:
+            return 0
+        limit = self.memory.cache_slots(config.num_records,
+                                        self.table_bytes(config))
+        if self.cache_slots is None:
+            return limit
+        if not 1 <= self.cache_slots <= limit:
+            raise ValueError(f"cache_slots must be between 1 and {limit}")
+        return self.cache_slots
+
+    def minimal(self) -> 'RuntimeConfig':
+        """The same options for spellcheck_min, the KERNAL-only program.
+
+        Its record cache and preload are sized for the RAM that leaving
+        printf and stdio out of the PRG frees.
+        """
+        return replace(self, memory=self.memory.minimal())
+
+    def preload_record_count(self, config: BloomConfig, record_ms: float) -> int:
+        """Number of hot records to stream into the cache at startup.
+
+        record_ms is the time one preloaded record takes to read. The
+        preload stops at preload_seconds, since every record it reads
+        delays the prompt.
+        """
+        if not self.preload_hot_records or not self.uses_record_cache:
+            return 0
+        count = self.record_cache_slots(config)
+        if self.preload_count is not None:
+            count = min(self.preload_count, count)
+        if self.preload_seconds is not None:
+            count = min(int(self.preload_seconds * 1000 / record_ms), count)
+        return count
+
+    def print_summary(self, config: BloomConfig, record_ms: float):
+        """Print runtime configuration summary.
+
+        record_ms is the time one preloaded record takes to read.
+        """
+        self.memory.print_summary()
+        num_records = config.num_records
+        slots = self.record_cache_slots(config)
+        print()
+        if config.is_striped:
+            print(f"Disk access: {self.access}, through the job queue of "
+                  f"{config.num_devices} drives at once")
+        else:
+            print(f"Disk access: {self.access}")
+        if slots:
+            print(f"Record cache: {slots} slots × {self.memory.record_size} bytes = "
+                  f"{slots * self.memory.record_size:,} bytes "
+                  f"({slots / num_records * 100:.1f}% of the filter)")
+            minimal = self.minimal().record_cache_slots(config)
+            print(f"Record cache, spellcheck_min: {minimal} slots "
+                  f"({minimal - slots:+} without printf and stdio)")
+        else:
+            print("Record cache: off (bits are tested in the drive)")
+        preload = self.preload_record_count(config, record_ms)
+        if preload:
+            sizes = ', '.join(str(size) for size in self.preload_sizes)
+            print(f"Startup preload: {preload} hot records, about "
+                  f"{preload * record_ms / 1000:.1f} s at startup "
+                  f"(SCOWL sizes {sizes})")
+        else:
+            print("Startup preload: off")
+        if self.batch_words:
+            print(f"Batch mode: {self.batch_words} words per sweep "
+                  f"({self.batch_bytes(config):,} bytes)")
+        else:
+            print("Batch mode: off")
+        if self.suggest:
+            print(f"Suggestions: one-edit corrections, {self.batch_words} "
+                  f"candidates per sweep")
+        else:
+            print("Suggestions: off")
+        if self.common_words:
+            print(f"Common words in RAM: {self.common_words:,} "
+                  f"({self.common_word_bytes:,} bytes)")
+        else:
+            print("Common words in RAM: off")
+        if self.recent_words:
+            print(f"Recent words: results of the last {self.recent_words} "
+                  f"distinct words kept ({self.recent_bytes:,} bytes)")
+        else:
+            print("Recent words: off")
+        if self.type_ahead:
+            print(f"Type-ahead: up to {TYPE_AHEAD_WORDS} words per line "
+                  f"checked while typing ({self.type_ahead_bytes(config)} "
+                  f"bytes)")
+        else:
+            print("Type-ahead: off")
+        if self.uses_fast_serial:
+            print("JiffyDOS: detected at startup; records are then cached whole")
+        elif self.access == ACCESS_REL_BYTE:
+            print("JiffyDOS: not looked for")
+        print(f"Profiling: {'on' if self.profile else 'off'}")
+        if self.heat_order:
+            source = self.heat_corpus or 'SCOWL frequency proxy'
+            print(f"Heat-ordered records: on, ranked by {source} "
+                  f"({remap_table_bytes(num_records):,} byte remap table)")
+        else:
+            print("Heat-ordered records: off")
+        if self.uses_reu:
+            banks = -(-num_records // REU_RECORDS_PER_BANK)
+            print(f"REU: whole filter loaded at startup when an REU of "
+                  f"{banks * 64} KB or more is present")
+        else:
+            print("REU: off")
+        if self.interleave is None:
+            print(f"BLOOM.DAT interleave: matched to {self.access} access")
+        else:
+            print(f"BLOOM.DAT interleave: {self.interleave} sectors")
+        print("=" * 80)
+        print()
@@ -0,0 +1,301 @@
+#!/usr/bin/env python3
+"""
+Run the lookup benchmark PRG in VICE and report what its lookups cost.
+
+Copyright (c) 2025 John Byrd
+https://github.com/johnwbyrd/bloomer
+
+SPDX-License-Identifier: BSD-3-Clause
+"""
+import argparse
+import csv
+import os
+import shutil
+import statistics
+import subprocess
+import sys
+from dataclasses import dataclass
+from pathlib import Path
+from typing import Dict, List, Optional, Sequence, Tuple
+
+import d64
+from bench_words import bench_device
+from bloom_config import FIRST_DISK_DEVICE
+from d64_image import D64Image
+from disk_creator import DiskImageCreator
+from disk_geometry import DiskGeometry
+from golomb_set import C64_CYCLES_PER_MS
+from rel_layout import Interleave, RelFileWriter
+from build_bloom import ARTIFACTS_DIR, DISK_CONFIG
+
+BENCH_PROGRAM = b'SPELLBENCH'
+RESULTS_FILE = b'BENCH'
+PETSCII_RETURN = 0x0D
+
+# Columns of a BENCH line, as spellcheck.c's bench_run() writes them
+PHASES = ('hash', 'command', 'status', 'transfer', 'other')
+COUNTERS = ('reads', 'cache_hits', 'common_hits', 'recent_hits')
+FIELDS = ('word', 'expected', 'found') + PHASES + COUNTERS
+
+# C64 time VICE may run before giving up: boot, load and every lookup
+LIMIT_SECONDS = 900
+VICE_EXIT_WRONG = 1  # BENCH_EXIT_WRONG: the PRG got some answers wrong
+LAST_VICE_DEVICE = 11  # VICE emulates drives 8-11
+
+
+@dataclass
+class BenchLookup:
+    """One word of the benchmark: its answer, phase cycles and counters."""
+
+    word: str
+    expected: bool
+    found: bool
+    phases: Tuple[int, ...]  # Cycles, in the order of PHASES
+    reads: int               # Records (drive requests in drive mode) read
+    cache_hits: int
+    common_hits: int
+    recent_hits: int
+
+    @classmethod
+    def from_fields(cls, fields: Sequence[str]) -> 'BenchLookup':
+        values = [int(field) for field in fields[1:]]
+        phases = tuple(values[2:2 + len(PHASES)])
+        return cls(fields[0], bool(values[0]), bool(values[1]), phases,
+                   *values[2 + len(PHASES):])
+
+    def fields(self) -> List[str]:
+        return ([self.word, str(int(self.expected)), str(int(self.found))] +
+                [str(cycles) for cycles in self.phases] +
+                [str(self.reads), str(self.cache_hits),
+                 str(self.common_hits), str(self.recent_hits)])
+
+    @property
+    def ms(self) -> float:
+        return sum(self.phases) / C64_CYCLES_PER_MS
+
+
+class BenchResults:
+    """The lookups of one benchmark run, from BENCH or a saved CSV."""
+
+    def __init__(self, lookups: List[BenchLookup]):
+        self.lookups = lookups
+
+    @classmethod
+    def from_results_file(cls, data: bytes) -> 'BenchResults':
+        """Parse BENCH: one comma-separated line per word, ending in RETURN."""
+        lines = data.decode('latin-1').split(chr(PETSCII_RETURN))
+        return cls([BenchLookup.from_fields(line.split(','))
+                    for line in lines if line])
+
+    @classmethod
+    def load(cls, path: Path) -> 'BenchResults':
+        with open(path, newline='') as f:
+            rows = list(csv.reader(f))[1:]
+        return cls([BenchLookup.from_fields(row) for row in rows])
+
+    def save(self, path: Path):
+        path.parent.mkdir(parents=True, exist_ok=True)
+        with open(path, 'w', newline='') as f:
+            writer = csv.writer(f)
+            writer.writerow(FIELDS)
+            writer.writerows(lookup.fields() for lookup in self.lookups)
+
+    @property
+    def wrong(self) -> List[BenchLookup]:
+        return [lookup for lookup in self.lookups
+                if lookup.found != lookup.expected]
+
+    def summary(self) -> Dict[str, float]:
+        """Latency, disk traffic and hit rates over all words."""
+        count = len(self.lookups)
+        ms = sorted(lookup.ms for lookup in self.lookups)
+        reads = sum(lookup.reads for lookup in self.lookups)
+        cache_hits = sum(lookup.cache_hits for lookup in self.lookups)
+        summary = {
+            'words': count,
+            'wrong answers': len(self.wrong),
+            'mean ms': statistics.mean(ms),
+            'median ms': statistics.median(ms),
+            '90th percentile ms': ms[int(0.9 * (count - 1))],
+            'max ms': ms[-1],
+        }
+        for index, phase in enumerate(PHASES):
+            cycles = sum(lookup.phases[index] for lookup in self.lookups)
+            summary[f'  {phase} ms'] = cycles / count / C64_CYCLES_PER_MS
+        # The hash scheme's whole cost, to compare schemes by
+        summary['hash cycles per word'] = sum(
+            lookup.phases[PHASES.index('hash')]
+            for lookup in self.lookups) / count
+        summary.update({
+            'reads per word': reads / count,
+            'words reading the disk': sum(1 for lookup in self.lookups
+                                          if lookup.reads) / count,
+            'record cache hit rate': (cache_hits / (cache_hits + reads)
+                                      if cache_hits + reads else 0.0),
+            'common-word hits': sum(lookup.common_hits
+                                    for lookup in self.lookups) / count,
+            'recent-word hits': sum(lookup.recent_hits
+                                    for lookup in self.lookups) / count,
+        })
+        return summary
+
+
+def format_value(name: str, value: float) -> str:
+    if name in ('words', 'wrong answers'):
+        return f"{value:,.0f}"
+    if 'cycles' in name:
+        return f"{value:,.0f}"
+    if 'ms' in name or name == 'reads per word':
+        return f"{value:,.2f}"
+    return f"{value:.1%}"
+
+
+def print_report(results: BenchResults, baseline: Optional[BenchResults]):
+    """Print the run's summary, next to the baseline's if there is one."""
+    summary = results.summary()
+    before = baseline.summary() if baseline else {}
+
+    print("=" * 60)
+    print("LOOKUP BENCHMARK")
+    print("=" * 60)
+    header = f"{'':<24}{'this run':>12}"
+    if baseline:
+        header += f"{'baseline':>12}{'change':>12}"
+    print(header)
+    for name, value in summary.items():
+        line = f"{name:<24}{format_value(name, value):>12}"
+        if name in before:
+            line += f"{format_value(name, before[name]):>12}"
+            if before[name] and ('ms' in name or 'cycles' in name):
+                line += f"{value / before[name] - 1:>+12.1%}"
+        print(line)
+    for lookup in results.wrong:
+        print(f"Wrong answer: {lookup.word} "
+              f"{'passed' if lookup.found else 'failed'}")
+
+
+def bench_image(prg_path: Path, geometry: DiskGeometry) -> Path:
+    """Make the disk of the bench drive: SPELLBENCH on an empty image.
+
+    The filter disks have no room for the program or for BENCH, so both go
+    on a drive of their own, and every run starts from an empty disk.
+    """
+    image = ARTIFACTS_DIR / f'bench.{geometry.image_type}'
+    image.parent.mkdir(parents=True, exist_ok=True)
+    d64.DiskImage.create(geometry.image_type, image, BENCH_PROGRAM, b'SB')
+    data = bytearray(image.read_bytes())
+    RelFileWriter(data, geometry).write_program(BENCH_PROGRAM,
+                                                prg_path.read_bytes(),
+                                                Interleave(sectors=10))
+    image.write_bytes(data)
+    return image
+
+
+def vice_command(vice: str, prg_path: Path, drives: Dict[int, Path],
+                 bench: int, drive: str, extra: Sequence[str]) -> List[str]:
+    """x64sc's command line: PAL, warp, true drive emulation, debug exit.
+
+    The filter drives are attached read-only and the bench drive writable.
+    The PRG is injected into memory, since autostarting from a disk would
+    put that disk in drive 8. Warp leaves the measurements alone, since the
+    PRG counts C64 cycles.
+    """
+    command = [vice, '-default', '-pal', '-warp', '-debugcart',
+               '-limitcycles', str(LIMIT_SECONDS * C64_CYCLES_PER_MS * 1000),
+               '-sounddev', 'dummy', '+autostart-handle-tde']
+    for device, image in drives.items():
+        access = 'rw' if device == bench else 'ro'
+        command += [f'-drive{device}type', drive, f'-drive{device}truedrive',
+                    f'-attach{device}{access}', f'-{device}', str(image)]
+    command += list(extra)
+    command += ['-autostartprgmode', '1', '-autostart', str(prg_path)]
+    return command
+
+
+def parse_args() -> argparse.Namespace:
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    geometry = DiskGeometry.for_drive(DISK_CONFIG['drive'])
+    parser.add_argument('--prg', type=Path,
+                        default=ARTIFACTS_DIR / 'spellcheck_bench.prg',
+                        help="benchmark program (the spellcheck_bench target)")
+    parser.add_argument('--d64', type=Path,
+                        default=ARTIFACTS_DIR /
+                        f'spellcheck.{geometry.image_type}',
+                        help="filter disk image built for the program")
+    parser.add_argument('--vice', default='x64sc',
+                        help="VICE C64 emulator; a headless build runs "
+                             "without a window")
+    parser.add_argument('--vice-arg', action='append', default=[],
+                        help="extra option passed to VICE")
+    parser.add_argument('--from-image', type=Path,
+                        help="read BENCH from this image instead of running "
+                             "VICE, e.g. one imaged from a real bench disk")
+    parser.add_argument('--output', type=Path,
+                        default=ARTIFACTS_DIR / 'bench.csv',
+                        help="CSV of every lookup")
+    parser.add_argument('--baseline', type=Path,
+                        help="CSV of an earlier run to compare against")
+    return parser.parse_args()
+
+
+def main():
+    args = parse_args()
+
+    # Run from the project directory, like build_bloom.py
+    script_dir = Path(__file__).parent
+    if script_dir.name == 'python':
+        os.chdir(script_dir.parent.parent)
+
+    geometry = DiskGeometry.for_drive(DISK_CONFIG['drive'])
+    image = args.from_image
+    if not image:
+        for path in (args.prg, args.d64):
+            if not path.exists():
+                print(f"{path} not found; build the spellcheck and "
+                      f"spellcheck_bench targets first")
+                sys.exit(1)
+        # Made first, so that a real bench drive can be given the disk
+        image = bench_image(args.prg, geometry)
+        print(f"Bench disk written to {image}")
+        if not shutil.which(args.vice):
+            print(f"{args.vice} not found; install VICE or pass --vice")
+            sys.exit(1)
+        devices = DISK_CONFIG['devices']
+        bench = bench_device(devices)
+        if bench > LAST_VICE_DEVICE:
+            print(f"The bench drive would be device {bench}, but VICE "
+                  f"emulates drives {FIRST_DISK_DEVICE}-{LAST_VICE_DEVICE}; "
+                  f"stripe the filter across fewer drives")
+            sys.exit(1)
+        drives = dict(zip(devices, DiskImageCreator(geometry).image_paths(
+            args.d64, devices)))
+        drives[bench] = image
+        command = vice_command(args.vice, args.prg, drives, bench,
+                               geometry.drive, args.vice_arg)
+        print(' '.join(command))
+        status = subprocess.run(command).returncode
+        if status not in (0, VICE_EXIT_WRONG):
+            print(f"VICE exited with {status} before the benchmark finished")
+            sys.exit(1)
+
+    disk = D64Image.load(image, geometry)
+    if not disk.find_file(RESULTS_FILE):
+        print(f"No {RESULTS_FILE.decode()} file in {image}")
+        sys.exit(1)
+    results = BenchResults.from_results_file(disk.read_file(RESULTS_FILE))
+    if not results.lookups:
+        print(f"{RESULTS_FILE.decode()} in {image} is empty")
+        sys.exit(1)
+    results.save(args.output)
+
+    baseline = None
+    if args.baseline and args.baseline.exists():
+        baseline = BenchResults.load(args.baseline)
+    print_report(results, baseline)
+    print(f"Lookups written to {args.output}")
+    if results.wrong:
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,47 @@
+"""
+Word frequency estimates from SCOWL size levels.
+
+Copyright (c) 2025 John Byrd
+https://github.com/johnwbyrd/bloomer
+
+SPDX-License-Identifier: BSD-3-Clause
+"""
+from pathlib import Path
+from typing import Dict, List, Tuple
+from scowl_downloader import SCOWLDownloader
+from scowl_parser import SCOWLParser
+
+
+class WordFrequency:
+    """Approximate word frequencies using SCOWL size levels as a proxy.
+
+    SCOWL sizes are nested: size 10 holds the most common words, size 20
+    adds the next most common, and so on. Each word is given a Zipf weight
+    of 1/rank, where rank is the midpoint of the band that first includes it.
+    """
+
+    def __init__(self, downloader: SCOWLDownloader, scowl_config: Dict[str, any],
+                 cache_dir: Path):
+        self.downloader = downloader
+        self.scowl_config = scowl_config
+        self.cache_dir = cache_dir
+
+    def load(self, sizes: List[int]) -> List[Tuple[str, float]]:
+        """Return (word, weight) pairs for every word up to the largest size."""
+        parser = SCOWLParser()
+        seen = set()
+        weighted = []
+
+        for size in sorted(sizes):
+            config = dict(self.scowl_config, max_size=size)
+            cache_file = self.cache_dir / f'scowl_wordlist_{size}.txt'
+            words = parser.parse(self.downloader.download(config, cache_file))
+
+            band = [word for word in dict.fromkeys(words) if word not in seen]
+            rank = len(seen) + (len(band) + 1) / 2
+            weighted.extend((word, 1.0 / rank) for word in band)
+            seen.update(band)
+            print(f"  SCOWL size {size}: {len(band):,} new words, "
+                  f"weight 1/{rank:,.0f}")
+
+        return weighted
@@ -0,0 +1,410 @@
+"""
+Bulk hashing of word lists, vectorized with NumPy when it is installed.
+
+Copyright (c) 2025 John Byrd
+https://github.com/johnwbyrd/bloomer
+
+SPDX-License-Identifier: BSD-3-Clause
+"""
+import hashlib
+import json
+import multiprocessing
+import os
+from array import array
+from pathlib import Path
+from typing import Dict, List, Optional, Sequence, Tuple
+
+from bloom_config import (BloomConfig, DOUBLE_HASHED, FUSE_FINGERPRINT_BITS,
+                          FUSE_HASH_VALUES, HASH_DOUBLE, HASH_PEARSON,
+                          RANGE_MULTIPLY_SHIFT)
+from hash_functions import (ALL_HASH_FUNCTIONS, FUSE_MIX_STEP, PEARSON_LANES,
+                            PEARSON_TABLE, fuse_mix, hash_pair, jenkins_final,
+                            pearson_key, pearson_pair)
+
+try:
+    import numpy as np
+except ImportError:  # The pure Python path computes the same values, slower
+    np = None
+
+HASH_CACHE_VERSION = 1
+PARALLEL_MIN_WORDS = 20000  # Fewer words hash faster than workers start
+MASK32 = 0xFFFFFFFF
+
+
+def vectorized() -> bool:
+    """True if NumPy is available for the bulk paths."""
+    return np is not None
+
+
+def base_hash_count(scheme: str) -> int:
+    """Raw hashes kept per word: h1 and h2, or every independent function."""
+    return 2 if scheme in DOUBLE_HASHED else len(ALL_HASH_FUNCTIONS)
+
+
+def _python_hashes(words: Sequence[str], scheme: str) -> List[array]:
+    """Raw hashes of words, one column per hash, one word at a time."""
+    columns = [array('I') for _ in range(base_hash_count(scheme))]
+    for word in words:
+        if scheme == HASH_DOUBLE:
+            values = hash_pair(word)
+        elif scheme == HASH_PEARSON:
+            values = pearson_pair(word)
+        else:
+            values = [hash_func(word, seed=i)
+                      for i, hash_func in enumerate(ALL_HASH_FUNCTIONS)]
+        for column, value in zip(columns, values):
+            column.append(value)
+    return columns
+
+
+def _numpy_hashes(words: Sequence[str], scheme: str) -> List['np.ndarray']:
+    """Raw hashes of words, one column per hash, all words at once.
+
+    Words are padded into a character matrix and every hash folds one
+    character column at a time; words that have ended keep their value.
+    uint32 arithmetic wraps exactly like the & 0xFFFFFFFF in
+    hash_functions.py.
+    """
+    u32 = np.uint32
+    encoded = [word.encode('latin-1') for word in words]
+    lengths = np.fromiter(map(len, encoded), dtype=np.int64, count=len(encoded))
+    width = int(lengths.max()) if len(encoded) else 0
+    chars = np.frombuffer(b''.join(text.ljust(width, b'\0') for text in encoded),
+                          dtype=np.uint8).reshape(len(encoded), width)
+
+    def start(value: int) -> 'np.ndarray':
+        return np.full(len(encoded), value, dtype=np.uint32)
+
+    def jenkins_step(h, c):
+        h = h + c
+        h = h + (h << u32(10))
+        return h ^ (h >> u32(6))
+
+    def djb2_step(h, c):
+        return (h << u32(5)) + h + c
+
+    if scheme == HASH_PEARSON:
+        return _numpy_pearson(chars, lengths)
+
+    steps = [
+        lambda h, c: (h ^ c) * u32(16777619),
+        djb2_step,
+        lambda h, c: c + (h << u32(6)) + (h << u32(16)) - h,
+        jenkins_step,
+        lambda h, c: (lambda m: m ^ (m >> u32(15)))((h ^ c) * u32(0x5bd1e995)),
+    ]
+    if scheme == HASH_DOUBLE:
+        steps = [jenkins_step, djb2_step]
+        states = [start(0), start(5381)]
+    else:
+        states = [start(2166136261), start(5381 + 1), start(2),
+                  start(3), start(4 + 0x9747b28c)]
+
+    for position in range(width):
+        active = lengths > position
+        c = chars[:, position].astype(np.uint32)
+        states = [np.where(active, step(h, c), h)
+                  for step, h in zip(steps, states)]
+
+    if scheme == HASH_DOUBLE:
+        return [_numpy_jenkins_final(states[0]),
+                _numpy_jenkins_final(states[1]) | u32(1)]
+    states[3] = _numpy_jenkins_final(states[3])
+    return states
+
+
+def _numpy_jenkins_final(h: 'np.ndarray') -> 'np.ndarray':
+    """jenkins_final() of every value of a uint32 column."""
+    u32 = np.uint32
+    h = h + (h << u32(3))
+    h = h ^ (h >> u32(11))
+    return h + (h << u32(15))
+
+
+def _numpy_pearson(chars: 'np.ndarray', lengths: 'np.ndarray'
+                   ) -> List['np.ndarray']:
+    """h1 and h2 of pearson_pair() for a padded character matrix."""
+    table = np.frombuffer(PEARSON_TABLE, dtype=np.uint8)
+    columns = []
+    for seed in range(2):
+        value = np.zeros(len(lengths), dtype=np.uint32)
+        for lane in range(PEARSON_LANES):
+            h = np.zeros(len(lengths), dtype=np.uint8)
+            key = np.uint8(pearson_key(seed, lane))
+            for position in range(chars.shape[1]):
+                h = np.where(lengths > position,
+                             table[h ^ chars[:, position] ^ key], h)
+            value |= h.astype(np.uint32) << np.uint32(8 * lane)
+        columns.append(value)
+    columns[1] |= np.uint32(1)
+    return columns
+
+
+class WordHashes:
+    """The raw 32-bit hashes of every word of a list, one column per hash.
+
+    Independent hashing keeps the value of every function in
+    ALL_HASH_FUNCTIONS, seeded as BloomFilter seeds them; double and
+    Pearson hashing keep h1 and h2. A filter's size, k, layout and range reduction only
+    change what is derived from them, so one list hashed once serves
+    every filter built from it.
+    """
+
+    def __init__(self, scheme: str, columns: List[Sequence[int]]):
+        self.scheme = scheme
+        self.columns = columns
+
+    def __len__(self) -> int:
+        return len(self.columns[0])
+
+    @classmethod
+    def compute(cls, words: Sequence[str], scheme: str,
+                jobs: Optional[int] = 1) -> 'WordHashes':
+        """Hash a word list, with NumPy or else across jobs processes.
+
+        jobs None means one process per CPU.
+        """
+        if np is not None:
+            return cls(scheme, _numpy_hashes(words, scheme))
+        jobs = jobs or os.cpu_count() or 1
+        if jobs == 1 or len(words) < PARALLEL_MIN_WORDS:
+            return cls(scheme, _python_hashes(words, scheme))
+        chunk = -(-len(words) // jobs)
+        with multiprocessing.Pool(jobs) as pool:
+            parts = pool.starmap(_python_hashes,
+                                 [(words[i:i + chunk], scheme)
+                                  for i in range(0, len(words), chunk)])
+        columns = [array('I') for _ in range(base_hash_count(scheme))]
+        for part in parts:
+            for column, values in zip(columns, part):
+                column.extend(values)
+        return cls(scheme, columns)
+
+    @classmethod
+    def cached(cls, words: Sequence[str], scheme: str,
+               scowl_config: Dict[str, any], cache_dir: Path,
+               jobs: Optional[int] = None) -> 'WordHashes':
+        """Load a word list's hashes from the cache, or compute and store them.
+
+        The file is named after the SCOWL config and hash scheme, and
+        starts with a digest of the words, so a changed list is rehashed.
+        """
+        key = hashlib.sha1(json.dumps([HASH_CACHE_VERSION, scheme, scowl_config],
+                                      sort_keys=True).encode()).hexdigest()[:16]
+        path = cache_dir / f'word_hashes_{key}.bin'
+        digest = hashlib.sha256('\n'.join(words).encode()).digest()
+        count = base_hash_count(scheme)
+
+        if path.exists():
+            data = path.read_bytes()
+            if (data[:len(digest)] == digest and
+                    len(data) == len(digest) + 4 * count * len(words)):
+                print(f"Using cached word hashes: {path}")
+                return cls._from_bytes(scheme, data[len(digest):], count)
+
+        hashes = cls.compute(words, scheme, jobs)
+        path.parent.mkdir(parents=True, exist_ok=True)
+        path.write_bytes(digest + hashes._to_bytes())
+        print(f"Word hashes cached to {path}")
+        return hashes
+
+    @classmethod
+    def _from_bytes(cls, scheme: str, data: bytes, count: int) -> 'WordHashes':
+        size = len(data) // count
+        if np is not None:
+            values = np.frombuffer(data, dtype=np.uint32)
+            step = size // 4
+            return cls(scheme, [values[i * step:(i + 1) * step]
+                                for i in range(count)])
+        columns = []
+        for i in range(count):
+            column = array('I')
+            column.frombytes(data[i * size:(i + 1) * size])
+            columns.append(column)
+        return cls(scheme, columns)
+
+    def _to_bytes(self) -> bytes:
+        if np is not None:
+            return b''.join(np.asarray(column, dtype=np.uint32).tobytes()
+                            for column in self.columns)
+        return b''.join(array('I', column).tobytes() for column in self.columns)
+
+    def values(self, config: BloomConfig) -> List[Sequence[int]]:
+        """The config's num_hash_functions hash values of every word.
+
+        Double and Pearson hashing derive g_i = h1 + i * h2 (mod 2^32)
+        from the stored pair, as double_hash_values() does. Independent
+        hashes get the avalanche BloomConfig.avalanches() calls for.
+        """
+        k = config.num_hash_functions
+        if self.scheme not in DOUBLE_HASHED:
+            return [self._avalanche(column) if config.avalanches(i)
+                    else column for i, column in enumerate(self.columns[:k])]
+        h1, h2 = self.columns
+        if np is not None:
+            return [h1 + np.uint32(i) * h2 for i in range(k)]
+        return [array('I', [(a + i * b) & MASK32 for a, b in zip(h1, h2)])
+                for i in range(k)]
+
+    def _avalanche(self, column: Sequence[int]) -> Sequence[int]:
+        """jenkins_final() of a column, for BloomConfig.avalanches()."""
+        if np is not None:
+            return _numpy_jenkins_final(np.asarray(column, dtype=np.uint32))
+        return array('I', map(jenkins_final, column))
+
+    def gcs_values(self, config: BloomConfig) -> Sequence[int]:
+        """Every word's value in a Golomb-coded set, from its first hash."""
+        shift = 32 - config.gcs_hash_bits
+        first = self.values(config)[0]
+        if np is not None:
+            return first >> np.uint32(shift)
+        return [value >> shift for value in first]
+
+    def bit_positions(self, config: BloomConfig) -> List[Sequence[int]]:
+        """The filter bits every word sets: one column per probe.
+
+        Matches BloomFilter._get_bit_positions() word for word.
+        """
+        values = self.values(config)
+        if config.is_blocked:
+            records = _reduce(config, values[0], config.num_records)
+            rest = _rest(config, values[0], config.num_records)
+            if np is not None:
+                base = records * config.record_bits
+                return [base + _reduce(config, column + rest,
+                                       config.record_bits)
+                        for column in values[1:]]
+            return [[record * config.record_bits + offset for record, offset in
+                     zip(records, _reduce(config, [(value + r) & MASK32
+                                                   for value, r in
+                                                   zip(column, rest)],
+                                          config.record_bits))]
+                    for column in values[1:]]
+        return [_reduce(config, column, config.size_bits) for column in values]
+
+    def fuse_keys(self, config: BloomConfig
+                  ) -> Tuple[List[Sequence[int]], Sequence[int]]:
+        """Every word's binary fuse filter slots and fingerprint."""
+        return fuse_keys(config, self.values(config)[0])
+
+
+def fuse_keys(config: BloomConfig, first: Sequence[int]
+              ) -> Tuple[List[Sequence[int]], Sequence[int]]:
+    """Binary fuse filter slots and fingerprints from every word's first hash.
+
+    The hash is remixed into FUSE_HASH_VALUES values: value 0 picks the
+    word's segment, and what its reduction leaves over is the
+    fingerprint; values 1-3 pick a byte in each of the segment's records.
+    Slots are byte offsets into the filter, one column per record.
+    Matches BloomFilter._fuse_slots() word for word.
+    """
+    values = [_fuse_mix(first, config.fuse_value_index(i))
+              for i in range(FUSE_HASH_VALUES)]
+    segments = _reduce(config, values[0], config.fuse_segments)
+    fingerprints = _leftover(config, values[0], config.fuse_segments)
+    size = config.geometry.rel_record_size
+    offsets = [_reduce(config, column, size) for column in values[1:]]
+    if np is not None:
+        return ([(segments + i) * size + offset
+                 for i, offset in enumerate(offsets)], fingerprints)
+    return ([[(segment + i) * size + offset
+              for segment, offset in zip(segments, column)]
+             for i, column in enumerate(offsets)], fingerprints)
+
+
+def _fuse_mix(values: Sequence[int], index: int) -> Sequence[int]:
+    """fuse_mix() over a whole column."""
+    if np is None:
+        return [fuse_mix(value, index) for value in values]
+    u32 = np.uint32
+    h = np.asarray(values, dtype=np.uint32) + u32(index * FUSE_MIX_STEP & MASK32)
+    h ^= h >> u32(16)
+    h *= u32(0x85EBCA6B)
+    h ^= h >> u32(13)
+    h *= u32(0xC2B2AE35)
+    return h ^ (h >> u32(16))
+
+
+def _reduce(config: BloomConfig, values: Sequence[int], n: int) -> Sequence[int]:
+    """config.reduce() over a whole column."""
+    if np is not None:
+        wide = np.asarray(values, dtype=np.uint32).astype(np.int64)
+        if config.range_reduction == RANGE_MULTIPLY_SHIFT:
+            return (wide * n) >> 32
+        return wide % n
+    if config.range_reduction == RANGE_MULTIPLY_SHIFT:
+        return [(value * n) >> 32 for value in values]
+    return [value % n for value in values]
+
+
+def _rest(config: BloomConfig, values: Sequence[int],
+          n: int) -> Sequence[int]:
+    """config.reduce_rest() over a whole column."""
+    if np is not None:
+        wide = np.asarray(values, dtype=np.uint32).astype(np.int64)
+        if config.range_reduction == RANGE_MULTIPLY_SHIFT:
+            return ((wide * n) & MASK32).astype(np.uint32)
+        return np.zeros(len(wide), dtype=np.uint32)
+    if config.range_reduction == RANGE_MULTIPLY_SHIFT:
+        return [(value * n) & MASK32 for value in values]
+    return [0] * len(values)
+
+
+def _leftover(config: BloomConfig, values: Sequence[int],
+              n: int) -> Sequence[int]:
+    """config.reduce_leftover() over a whole column."""
+    shift = 32 - FUSE_FINGERPRINT_BITS
+    low = (1 << FUSE_FINGERPRINT_BITS) - 1
+    if np is not None:
+        wide = np.asarray(values, dtype=np.uint32).astype(np.int64)
+        if config.range_reduction == RANGE_MULTIPLY_SHIFT:
+            return ((wide * n) & MASK32) >> shift
+        return (wide // n) & low
+    if config.range_reduction == RANGE_MULTIPLY_SHIFT:
+        return [((value * n) & MASK32) >> shift for value in values]
+    return [(value // n) & low for value in values]
+
+
+def set_bits(data: bytearray, positions: List[Sequence[int]]):
+    """Set every bit position in data, LSB first within a byte."""
+    if np is not None:
+        bits = np.unpackbits(np.frombuffer(bytes(data), dtype=np.uint8),
+                             bitorder='little')
+        for column in positions:
+            bits[column] = 1
+        data[:] = np.packbits(bits, bitorder='little').tobytes()
+        return
+    for column in positions:
+        for bit_pos in column:
+            data[bit_pos >> 3] |= 1 << (bit_pos & 7)
+
+
+def test_bits(data: bytes, positions: List[Sequence[int]]) -> List[bool]:
+    """For every word, whether all of its bit positions are set in data."""
+    if np is not None:
+        bits = np.unpackbits(np.frombuffer(bytes(data), dtype=np.uint8),
+                             bitorder='little').astype(bool)
+        hits = np.ones(len(positions[0]), dtype=bool)
+        for column in positions:
+            hits &= bits[column]
+        return hits.tolist()
+    return [all(data[bit_pos >> 3] & (1 << (bit_pos & 7)) for bit_pos in word)
+            for word in zip(*positions)]
+
+
+def test_shares(data: bytes, slots: List[Sequence[int]],
+                fingerprints: Sequence[int]) -> List[bool]:
+    """For every word, whether its fuse filter bytes XOR to its fingerprint."""
+    if np is not None:
+        filter_bytes = np.frombuffer(bytes(data), dtype=np.uint8)
+        shares = np.asarray(fingerprints, dtype=np.uint8)
+        for column in slots:
+            shares = shares ^ filter_bytes[column]
+        return (shares == 0).tolist()
+    hits = []
+    for word in zip(fingerprints, *slots):
+        shares = word[0]
+        for slot in word[1:]:
+            shares ^= data[slot]
+        hits.append(shares == 0)
+    return hits
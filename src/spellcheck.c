@@ -9,33 +9,185 @@
  * A spell checker for the Commodore 64 that uses a Bloom filter stored in a
  * REL file on disk. Words are hashed with 5 different hash functions and
  * checked against a bit array to determine if they exist in the dictionary.
+ * With the blocked layout, all bits for a word live in a single REL record.
+ * The gcs layout stores one hash per word as a Golomb-coded set instead,
+ * and the fuse layout a binary fuse filter: three bytes per word, in
+ * consecutive records, that XOR to the word's 8-bit fingerprint.
  *
  * The Bloom filter provides:
  * - 0% false negatives (correct words always pass)
- * - ~0.81% false positives (some misspellings incorrectly pass)
+ * - ~1.2% false positives (some misspellings incorrectly pass)
  *
- * Compiled with LLVM-MOS for Commodore 64
+ * Compiled with LLVM-MOS for Commodore 64. The spellcheck_min target builds
+ * it on console.h's KERNAL-only runtime, without printf and stdio, and the
+ * spellcheck_bench target (BLOOM_BENCH) as a benchmark that times a fixed
+ * word list through check_word() and writes the results to disk.
  */
 
 #include <c64.h>
 #include <cbm.h>
-#include <ctype.h>
 #include <stdbool.h>
 #include <stdint.h>
-#include <stdio.h>
 #include <string.h>
 
 #include "bloom_config.h"
+#include "bloom_core.h"
+#include "console.h"
+
+#if BLOOM_BENCH
+#include "bloom_bench.h"
+
+/* The benchmark times every lookup with the profiling counter */
+#undef BLOOM_PROFILE
+#define BLOOM_PROFILE 1
+#endif
 
 /* ========================================================================== */
 /* CONFIGURATION AND CONSTANTS                                               */
 /* ========================================================================== */
 
 #define MAX_WORD_LEN 64
-#define RECORD_SIZE 254     /* CBM DOS REL max record size */
 #define CBM_CMD_CHANNEL 15  /* CBM DOS command channel */
 #define CBM_STATUS_EOF 0x40 /* End of file status bit */
-#define BITS_PER_BYTE 8
+#define BLOOM_FILENAME "BLOOM.DAT"
+#define CACHE_SLOT_NONE 0xFF /* Record not present in the record cache */
+/* Batch document mode */
+#define BATCH_TEXT_SIZE (BLOOM_BATCH_WORDS * 8 + MAX_WORD_LEN) /* ~7 + NUL */
+#define BATCH_PROBES (BLOOM_BATCH_WORDS * NUM_BIT_PROBES)
+#define BATCH_BUCKETS 64    /* Hash buckets for de-duplicating words */
+#define BATCH_NONE 0xFF     /* End of a hash chain */
+#define BATCH_COMMAND '@'   /* "@NAME" checks the SEQ file NAME */
+/* Recently checked words */
+#define RECENT_BUCKETS 64      /* Hash buckets, by the fingerprint's low bits */
+#define RECENT_NONE 0xFF       /* End of a hash chain */
+#define RECENT_FOUND 0x01      /* The word passed */
+#define RECENT_REFERENCED 0x02 /* Looked up since the CLOCK hand passed */
+/* Spelling suggestions */
+#define SUGGEST_COMMAND '?' /* "?WORD" lists corrections of WORD */
+#define SUGGEST_MAX 10      /* Corrections listed at most */
+#define EDIT_DELETE 0       /* Edits tried at each position, in order */
+#define EDIT_TRANSPOSE 1
+#define EDIT_SUBSTITUTE 2
+#define EDIT_INSERT 3
+#define EDIT_NEXT 4         /* Move on to the next position */
+#define APOSTROPHE '\''
+#define PETSCII_RETURN 0x0D
+#define ASCII_LINEFEED 0x0A
+/* Type-ahead input */
+#define TYPEAHEAD_WORDS 16    /* Words of one line checked while typing */
+#define TYPEAHEAD_PAUSE 20    /* Jiffies without a key before guessing */
+#define TYPEAHEAD_HASH_DEPTH 16 /* Letters of a word hashed as it is typed */
+#define TYPEAHEAD_IDLE 0xFF   /* No word being checked in the background */
+#define TYPEAHEAD_PENDING 0   /* Word states */
+#define TYPEAHEAD_FOUND 1
+#define TYPEAHEAD_MISSING 2
+#define PETSCII_SPACE 0x20
+#define PETSCII_DELETE 0x14
+#define PETSCII_SHIFT_RETURN 0x8D
+
+/* CBM DOS disk layout, used by direct access mode */
+#define BLOCK_SIZE 256
+#define BLOCK_DATA_OFFSET 2   /* Bytes 0-1 of a block link to the next one */
+#define DIR_ENTRY_SIZE 32
+#define DIR_ENTRY_TYPE 2      /* Offsets within a directory entry */
+#define DIR_ENTRY_NAME 5
+#define DIR_ENTRY_SIDE_TS 21
+#define DIR_NAME_LEN 16
+#define DIR_NAME_PAD 0xA0
+#define FILE_TYPE_MASK 0x07
+#define FILE_TYPE_REL 0x04
+#define SIDE_SECTOR_NUMBER 2   /* Side sector index, or SUPER_SIDE_SECTOR */
+#define SIDE_SECTOR_DATA_TS 16 /* Data block T/S list within a side sector */
+#define SIDE_SECTOR_ENTRIES 120
+#define SUPER_SIDE_SECTOR 0xFE /* 1581: lists the groups of side sectors */
+#define DEVICE_RECORDS (NUM_RECORDS / BLOOM_DEVICE_COUNT) /* Per drive */
+
+/* Access modes that fetch records through a RAM track/sector map */
+#define BLOOM_RECORD_MAP                                                       \
+  (BLOOM_ACCESS == BLOOM_ACCESS_DIRECT || BLOOM_ACCESS == BLOOM_ACCESS_DRIVE)
+#if BLOOM_ACCESS == BLOOM_ACCESS_DRIVE || BLOOM_STRIPED
+#define DIRECT_BUFFER_NAME "#1" /* Jobs and the probe routine use buffer 1 */
+#else
+#define DIRECT_BUFFER_NAME "#"  /* Any free buffer */
+#endif
+
+/* 1541 drive-side probe routine, used by drive access mode */
+#define DRIVE_CODE_ADDR 0x0500    /* Buffer 2, reserved by opening "#2" */
+#define DRIVE_REQUEST_ADDR 0x05BF /* Result, count, then the probe list */
+#define DRIVE_STATE_ADDR 0x05FC   /* Track and sector held in buffer 1 */
+#define DRIVE_MAX_PROBES 8        /* Keeps a request within one M-W */
+#define DRIVE_PROBE_SIZE 4        /* Track, sector, byte in block, mask */
+#define DRIVE_REQUEST_SIZE (2 + DRIVE_MAX_PROBES * DRIVE_PROBE_SIZE)
+#define DRIVE_WRITE_CHUNK 32      /* Bytes per M-W while uploading */
+#define DRIVE_DONE 0x80           /* Result bit 7: routine finished */
+#define DRIVE_READ_ERROR 0xFF     /* Result: the drive could not read */
+#define DRIVE_POLL_LIMIT 255
+
+/* Striped reads: buffer 1's job queue entry, as used by the probe routine */
+#define JOB_CODE_ADDR 0x0001   /* Job code for buffer 1 */
+#define JOB_HEADER_ADDR 0x0008 /* Track and sector for buffer 1's job */
+#define JOB_READ 0x80          /* Read a block; bit 7 stays set until done */
+#define JOB_OK 0x01
+#define JOB_POLL_LIMIT 1000
+#define STRIPE_LFN_STEP 8      /* Logical files of each further drive */
+#define STRIPE_LOOKAHEAD 16    /* Queued reads looked ahead for other drives */
+#define RECORD_NONE 0xFFFF
+
+/* REU mode: 17xx RAM Expansion Unit registers. Record r is kept in REU
+ * page r, so a probe's REU address is its record and byte. */
+#define REU_COMMAND (*(volatile uint8_t *)0xDF01)
+#define REU_C64_LO (*(volatile uint8_t *)0xDF02)
+#define REU_C64_HI (*(volatile uint8_t *)0xDF03)
+#define REU_ADDR_LO (*(volatile uint8_t *)0xDF04)
+#define REU_ADDR_HI (*(volatile uint8_t *)0xDF05)
+#define REU_BANK (*(volatile uint8_t *)0xDF06)
+#define REU_LENGTH_LO (*(volatile uint8_t *)0xDF07)
+#define REU_LENGTH_HI (*(volatile uint8_t *)0xDF08)
+#define REU_ADDR_CONTROL (*(volatile uint8_t *)0xDF0A)
+#define REU_STASH 0x90            /* Execute now, C64 to REU */
+#define REU_FETCH 0x91            /* Execute now, REU to C64 */
+#define REU_PROBE_PATTERN 0xA5    /* Written to the address registers */
+#define REU_BANKS ((NUM_RECORDS + 255) / 256) /* 64KB banks the filter needs */
+
+/* JiffyDOS: named in the KERNAL's startup banner and in the drive's 73
+ * message, which a UI command resets the drive to report */
+#define KERNAL_ROM ((const uint8_t *)0xE000)
+#define KERNAL_ROM_SIZE 0x2000
+#define JIFFYDOS_NAME "JIFFYDOS"
+#define DOS_VERSION_MESSAGE 73
+
+#define JIFFY_CLOCK ((volatile uint8_t *)0xA0) /* KERNAL TI, 60Hz, big-endian */
+#define JIFFIES_PER_SECOND 60
+
+/* Screen editor cursor, blinked by the KERNAL IRQ while BLNSW is 0 */
+#define CURSOR_BLINK_OFF (*(volatile uint8_t *)0xCC) /* BLNSW */
+#define CURSOR_CHAR (*(volatile uint8_t *)0xCE)      /* GDBLN: char under it */
+#define CURSOR_REVERSED (*(volatile uint8_t *)0xCF)  /* BLNON: drawn reversed */
+#define CURSOR_LINE (*(uint8_t *volatile *)0xD1)     /* PNT: its screen line */
+#define CURSOR_COLUMN (*(volatile uint8_t *)0xD3)    /* PNTR */
+
+/* Profiling mode: CIA 2 timers A and B chained into a 32-bit cycle counter.
+ * CIA 1 drives the KERNAL IRQ; CIA 2's timers are only used by RS-232. */
+#define CIA2_TIMER_A_LO (*(volatile uint8_t *)0xDD04)
+#define CIA2_TIMER_A_HI (*(volatile uint8_t *)0xDD05)
+#define CIA2_TIMER_B_LO (*(volatile uint8_t *)0xDD06)
+#define CIA2_TIMER_B_HI (*(volatile uint8_t *)0xDD07)
+#define CIA2_CONTROL_A (*(volatile uint8_t *)0xDD0E)
+#define CIA2_CONTROL_B (*(volatile uint8_t *)0xDD0F)
+#define CIA_START_PHI2 0x11       /* Start, force load, count system clocks */
+#define CIA_START_CHAINED 0x51    /* Start, force load, count A underflows */
+#define KERNAL_PAL_FLAG (*(volatile uint8_t *)0x02A6) /* 1 = PAL */
+#define CYCLES_PER_MS_PAL 985UL
+#define CYCLES_PER_MS_NTSC 1023UL
+
+/* Benchmark build: results file, written to BENCH_DEVICE since the filter
+ * disks are full, and VICE's debug cartridge register, which ends the
+ * emulator with the value written when run with -debugcart. On a real C64
+ * it mirrors an unused SID register. */
+#define BENCH_FILENAME "@0:BENCH,S,W" /* Replaced on every run */
+#define BENCH_EXIT (*(volatile uint8_t *)0xD7FF)
+#define BENCH_EXIT_OK 0
+#define BENCH_EXIT_WRONG 1            /* Some answers were not the expected */
 
 /* PETSCII color control codes */
 #define PETSCII_COLOR_GOOD 0x1E      /* Green text for correct words */
@@ -50,21 +202,22 @@
 #define PROMPT_LENGTH 18   /* Length of "word (or 'quit'): " */
 #define CHECKING_LENGTH 8  /* Length of "Checking" */
 
-/* PETSCII character ranges */
-#define PETSCII_LOWERCASE_START 0xC1
-#define PETSCII_LOWERCASE_END 0xDA
-#define PETSCII_UPPERCASE_START 0x41
-#define PETSCII_UPPERCASE_END 0x5A
-#define PETSCII_SHIFTED_START 0x61
-#define PETSCII_SHIFTED_END 0x7A
-#define PETSCII_TO_ASCII_OFFSET 0x80
-#define LOWERCASE_TO_UPPERCASE_OFFSET 0x20
-
 /* ========================================================================== */
 /* TYPE DEFINITIONS                                                          */
 /* ========================================================================== */
 
-typedef uint32_t (*hash_func_t)(const char *, uint8_t);
+/* One probe in a batch sweep, tagged with the word that needs it */
+typedef struct {
+  bloom_probe_t probe;
+  uint8_t word;
+} sweep_entry_t;
+
+/* One edit of a word: kind applied at pos, with letter if it needs one */
+typedef struct {
+  uint8_t pos;
+  uint8_t kind;
+  char letter;
+} suggest_edit_t;
 
 /* ========================================================================== */
 /* GLOBAL VARIABLES                                                          */
@@ -72,14 +225,240 @@ typedef uint32_t (*hash_func_t)(const char *, uint8_t);
 
 /* Bloom filter file handles */
 static uint8_t bloom_lfn = 2;
-static uint8_t bloom_device = 8;
+static uint8_t bloom_device = BLOOM_DEVICE; /* Also holds the program */
 static uint8_t bloom_secondary = 2;
 
-/* Buffer for reading REL records */
-static uint8_t record_buffer[RECORD_SIZE];
+#if BLOOM_STRIPED
+/* Drives of a striped filter: record r is on drive r % BLOOM_DEVICE_COUNT */
+static const uint8_t stripe_devices[BLOOM_DEVICE_COUNT] = BLOOM_DEVICES;
+
+/* Record each drive is reading into buffer 1 (RECORD_NONE = idle) */
+static uint16_t stripe_record[BLOOM_DEVICE_COUNT];
+#endif
+
+#if BLOOM_RECORD_MAP
+/* Direct access buffer channel */
+static uint8_t direct_lfn = 3;
+static uint8_t direct_secondary = 3;
+
+/* Data block of each record, read from BLOOM.DAT's side sectors */
+static uint8_t record_track[NUM_RECORDS];
+static uint8_t record_sector[NUM_RECORDS];
+
+/* Scratch buffer for directory and side sector blocks */
+static uint8_t block_buffer[BLOCK_SIZE];
+#endif
 
-/* Current loaded record number (-1 = none loaded) */
-static int16_t current_record = -1;
+#if BLOOM_ACCESS == BLOOM_ACCESS_DRIVE
+/* Channel that reserves drive buffer 2 for the probe routine */
+static uint8_t drive_lfn = 5;
+static uint8_t drive_secondary = 5;
+
+/*
+ * Probe routine run in the 1541 at DRIVE_CODE_ADDR
+ *
+ * Tests up to DRIVE_MAX_PROBES bits. Each probe's block is read into
+ * buffer 1 ($0400) with a job queue READ, unless it is already there. The
+ * result is $80 plus the index of the first clear bit, or $80 plus the
+ * count if all bits are set, or $FF if a read fails.
+ *
+ * RESULT = $05BF, COUNT = $05C0, probe n at $05C1 + 4n (TRACKS, SECTORS,
+ * OFFSETS, MASKS), LAST_T/LAST_S = $05FC/$05FD. JOB, HDR_T and HDR_S are
+ * buffer 1's job code ($01) and header track/sector ($08/$09).
+ */
+static const uint8_t drive_code[] = {
+  0xA2, 0x00,        /* 0500          LDX #$00 */
+  0x8A,              /* 0502  loop:   TXA */
+  0x4A,              /* 0503          LSR A */
+  0x4A,              /* 0504          LSR A */
+  0xCD, 0xC0, 0x05,  /* 0505          CMP COUNT */
+  0xB0, 0x49,        /* 0508          BCS finish     ; All bits set */
+  0xBD, 0xC1, 0x05,  /* 050A          LDA TRACKS,X */
+  0xCD, 0xFC, 0x05,  /* 050D          CMP LAST_T */
+  0xD0, 0x08,        /* 0510          BNE read */
+  0xBD, 0xC2, 0x05,  /* 0512          LDA SECTORS,X */
+  0xCD, 0xFD, 0x05,  /* 0515          CMP LAST_S */
+  0xF0, 0x1C,        /* 0518          BEQ test       ; Block in buffer */
+  0xBD, 0xC1, 0x05,  /* 051A  read:   LDA TRACKS,X */
+  0x85, 0x08,        /* 051D          STA HDR_T */
+  0x8D, 0xFC, 0x05,  /* 051F          STA LAST_T */
+  0xBD, 0xC2, 0x05,  /* 0522          LDA SECTORS,X */
+  0x85, 0x09,        /* 0525          STA HDR_S */
+  0x8D, 0xFD, 0x05,  /* 0527          STA LAST_S */
+  0xA9, 0x80,        /* 052A          LDA #$80 */
+  0x85, 0x01,        /* 052C          STA JOB        ; Queue a read job */
+  0xA5, 0x01,        /* 052E  wait:   LDA JOB */
+  0x30, 0xFC,        /* 0530          BMI wait */
+  0xC9, 0x02,        /* 0532          CMP #$02 */
+  0xB0, 0x16,        /* 0534          BCS error      ; Job error code */
+  0xBC, 0xC3, 0x05,  /* 0536  test:   LDY OFFSETS,X */
+  0xB9, 0x00, 0x04,  /* 0539          LDA BUFFER,Y */
+  0x3D, 0xC4, 0x05,  /* 053C          AND MASKS,X */
+  0xF0, 0x06,        /* 053F          BEQ clear */
+  0xE8,              /* 0541          INX */
+  0xE8,              /* 0542          INX */
+  0xE8,              /* 0543          INX */
+  0xE8,              /* 0544          INX */
+  0xD0, 0xBB,        /* 0545          BNE loop */
+  0x8A,              /* 0547  clear:  TXA */
+  0x4A,              /* 0548          LSR A */
+  0x4A,              /* 0549          LSR A */
+  0x10, 0x07,        /* 054A          BPL finish     ; A = clear index */
+  0xA9, 0x00,        /* 054C  error:  LDA #$00 */
+  0x8D, 0xFC, 0x05,  /* 054E          STA LAST_T     ; Buffer invalid */
+  0xA9, 0x7F,        /* 0551          LDA #$7F */
+  0x09, 0x80,        /* 0553  finish: ORA #$80 */
+  0x8D, 0xBF, 0x05,  /* 0555          STA RESULT */
+  0x60,              /* 0558          RTS */
+};
+#endif
+
+#if BLOOM_CACHE_SLOTS > 0
+/* Record cache: BLOOM_CACHE_SLOTS REL records with CLOCK eviction */
+static uint8_t record_cache[BLOOM_CACHE_SLOTS][RECORD_SIZE];
+
+/* Record number held by each slot */
+static uint16_t cache_slot_record[BLOOM_CACHE_SLOTS];
+
+/* Slot holding each record (CACHE_SLOT_NONE = not cached) */
+static uint8_t cache_slot_of[NUM_RECORDS];
+
+/* CLOCK reference bits, one per slot */
+static uint8_t cache_referenced[BLOOM_CACHE_SLOTS];
+
+/* Number of slots filled so far, and the CLOCK hand */
+static uint8_t cache_used = 0;
+static uint8_t cache_hand = 0;
+
+/* Cache statistics, reported in debug mode */
+static uint16_t cache_hits = 0;
+static uint16_t cache_misses = 0;
+#endif
+
+#if COMMON_WORD_COUNT > 0
+/* Words answered by the common-word table, reported in debug mode */
+static uint16_t common_hits = 0;
+#endif
+
+#if BLOOM_RECENT_WORDS > 0
+/* Results of recently checked words, found by fingerprint through hash
+ * chains; recent_flags holds RECENT_FOUND and RECENT_REFERENCED */
+static uint32_t recent_fingerprint[BLOOM_RECENT_WORDS];
+static uint8_t recent_next[BLOOM_RECENT_WORDS];
+static uint8_t recent_flags[BLOOM_RECENT_WORDS];
+static uint8_t recent_bucket[RECENT_BUCKETS];
+static uint8_t recent_used = 0;
+static uint8_t recent_hand = 0;
+
+/* Words answered from their remembered result, reported in debug mode */
+static uint16_t recent_hits = 0;
+
+/* Set when a probe could not be read: the word's result is not kept */
+static bool probe_failed = false;
+#define PROBE_FAILED() (probe_failed = true)
+#else
+#define PROBE_FAILED()
+#endif
+
+#if BLOOM_BATCH_WORDS > 0
+/* SEQ file being checked in batch mode */
+static uint8_t seq_lfn = 4;
+static uint8_t seq_secondary = 4;
+
+/* Distinct words in the current batch, stored NUL-terminated */
+static char batch_text[BATCH_TEXT_SIZE];
+static uint16_t batch_text_used;
+static uint16_t batch_word_text[BLOOM_BATCH_WORDS]; /* Offset in batch_text */
+static uint16_t batch_word_line[BLOOM_BATCH_WORDS]; /* First line seen on */
+static uint8_t batch_word_next[BLOOM_BATCH_WORDS];  /* Hash chain link */
+#if BLOOM_RECENT_WORDS > 0
+static uint32_t batch_word_fingerprint[BLOOM_BATCH_WORDS];
+#endif
+static uint8_t batch_bucket[BATCH_BUCKETS];
+static uint8_t batch_words;
+
+/* Probes for every word in the batch, sorted by record before the sweep.
+ * Suggestions sweep their candidates through the same buffers. */
+static sweep_entry_t sweep[BATCH_PROBES];
+static uint16_t sweep_used;
+static uint8_t sweep_alive[BLOOM_BATCH_WORDS]; /* No clear bit yet */
+#if BLOOM_LAYOUT == BLOOM_LAYOUT_FUSE
+static uint8_t sweep_shares[BLOOM_BATCH_WORDS]; /* XOR of shares so far */
+#endif
+#endif
+
+#if BLOOM_BENCH
+/* Results file of the benchmark, and the command channel of its drive */
+static uint8_t bench_lfn = 6;
+static uint8_t bench_secondary = 6;
+static uint8_t bench_command_lfn = 7;
+#endif
+
+#if BLOOM_SUGGEST
+/* Edits that produced the corrections found so far */
+static suggest_edit_t suggest_found[SUGGEST_MAX];
+#endif
+
+#if BLOOM_PROFILE
+/* Lookup phases timed in profiling mode */
+enum {
+  PHASE_HASH,     /* Common-word table, probe computation and sorting */
+  PHASE_COMMAND,  /* Sending P, U1, B-P and M- commands */
+  PHASE_STATUS,   /* Reading the DOS error channel */
+  PHASE_TRANSFER, /* Receiving record, byte and result data */
+  PHASE_OTHER,    /* Cache bookkeeping and progress output */
+  NUM_PHASES
+};
+
+static const char *const phase_names[NUM_PHASES] = {"hash", "command",
+                                                    "status", "transfer",
+                                                    "other"};
+
+/* Cycles for the current word, and session totals and maxima */
+static uint32_t profile_word[NUM_PHASES];
+static uint32_t profile_total[NUM_PHASES];
+static uint32_t profile_max[NUM_PHASES];
+static uint16_t profile_words = 0;
+
+/* Records (or drive requests) read and cache hits for the current word */
+static uint16_t profile_reads;
+static uint16_t profile_hits_start;
+
+/* Phase being timed, and the counter value when it was entered */
+static uint8_t profile_phase = PHASE_OTHER;
+static uint32_t profile_mark;
+#endif
+
+#if BLOOM_TYPE_AHEAD
+/* Type-ahead: the line being typed and the words on it checked so far */
+static uint8_t typeahead_line[MAX_WORD_LEN]; /* PETSCII, as typed */
+static uint8_t typeahead_len;
+static uint8_t typeahead_start[TYPEAHEAD_WORDS]; /* Queued words, in order */
+static uint8_t typeahead_end[TYPEAHEAD_WORDS];
+static uint8_t typeahead_state[TYPEAHEAD_WORDS];
+static uint8_t typeahead_words;
+static bloom_probe_t typeahead_probes[NUM_BIT_PROBES]; /* Word in progress */
+static uint8_t typeahead_word = TYPEAHEAD_IDLE;        /* Its queue index */
+static uint8_t typeahead_next;                         /* Its next probe */
+#if BLOOM_RECENT_WORDS > 0
+static uint32_t typeahead_fingerprint;                 /* Its fingerprint */
+#endif
+#if BLOOM_LAYOUT == BLOOM_LAYOUT_FUSE
+static uint8_t typeahead_shares; /* XOR of its shares so far */
+#endif
+#endif
+
+#if BLOOM_REU
+/* Whole filter loaded into the REU at startup; disk reads stop here */
+static bool reu_present = false;
+#endif
+
+#if BLOOM_FAST_SERIAL
+/* KERNAL and drive both speak JiffyDOS: records are cached whole */
+static bool fast_serial = false;
+#else
+#define fast_serial false
+#endif
 
 /* Debug mode flag */
 static bool debug_mode = false;
@@ -87,73 +466,186 @@ static bool debug_mode = false;
 /* Progress indicator counter */
 static uint8_t period_count = 0;
 
+/* No progress periods while type-ahead works behind the user's typing */
+static bool quiet_mode = false;
+
 /* ========================================================================== */
-/* HASH FUNCTIONS                                                            */
+/* PROFILING                                                                 */
 /* ========================================================================== */
-/* Must match Python implementation exactly for compatibility                */
+/* Cycle-accurate per-phase timing of lookups, enabled with 'profile'        */
 
-uint32_t hash_fnv1a(const char *word, uint8_t seed) {
-  uint32_t hash = 2166136261UL + seed;
-  while (*word) {
-    hash ^= (uint8_t)(*word);
-    hash *= 16777619UL;
-    word++;
-  }
-  return hash;
+#if BLOOM_PROFILE
+/*
+ * Start the 32-bit CIA 2 cycle counter
+ */
+static void profile_start(void) {
+  CIA2_CONTROL_A = 0;
+  CIA2_CONTROL_B = 0;
+  CIA2_TIMER_A_LO = 0xFF;
+  CIA2_TIMER_A_HI = 0xFF;
+  CIA2_TIMER_B_LO = 0xFF;
+  CIA2_TIMER_B_HI = 0xFF;
+  CIA2_CONTROL_B = CIA_START_CHAINED;
+  CIA2_CONTROL_A = CIA_START_PHI2;
 }
 
-uint32_t hash_djb2(const char *word, uint8_t seed) {
-  uint32_t hash = 5381UL + seed;
-  while (*word) {
-    hash = ((hash << 5) + hash) + (uint8_t)(*word);
-    word++;
-  }
-  return hash;
+/*
+ * Read the cycle counter
+ *
+ * Returns: cycles since profile_start(), wrapping after about 72 minutes
+ *
+ * The timers count down. Reread if timer B or timer A's high byte
+ * changed while the four bytes were being read.
+ */
+static uint32_t profile_cycles(void) {
+  uint8_t b_hi, b_lo, a_hi, a_lo;
+
+  do {
+    b_hi = CIA2_TIMER_B_HI;
+    b_lo = CIA2_TIMER_B_LO;
+    a_hi = CIA2_TIMER_A_HI;
+    a_lo = CIA2_TIMER_A_LO;
+  } while (b_lo != CIA2_TIMER_B_LO || a_hi != CIA2_TIMER_A_HI);
+
+  return ~(((uint32_t)b_hi << 24) | ((uint32_t)b_lo << 16) |
+           ((uint16_t)a_hi << 8) | a_lo);
 }
 
-uint32_t hash_sdbm(const char *word, uint8_t seed) {
-  uint32_t hash = seed;
-  while (*word) {
-    hash = (uint8_t)(*word) + (hash << 6) + (hash << 16) - hash;
-    word++;
-  }
-  return hash;
+/*
+ * Charge the time since the last switch to the current phase
+ *
+ * Returns: the phase that was being timed, so callers can restore it
+ */
+static uint8_t profile_enter(uint8_t phase) {
+  uint32_t now = profile_cycles();
+  uint8_t previous = profile_phase;
+
+  profile_word[profile_phase] += now - profile_mark;
+  profile_mark = now;
+  profile_phase = phase;
+  return previous;
 }
 
-uint32_t hash_jenkins(const char *word, uint8_t seed) {
-  uint32_t hash = seed;
-  while (*word) {
-    hash += (uint8_t)(*word);
-    hash += (hash << 10);
-    hash ^= (hash >> 6);
-    word++;
+/*
+ * Start timing a lookup, in the hash phase
+ */
+static void profile_word_begin(void) {
+  memset(profile_word, 0, sizeof(profile_word));
+  profile_reads = 0;
+#if BLOOM_CACHE_SLOTS > 0
+  profile_hits_start = cache_hits;
+#endif
+  profile_mark = profile_cycles();
+  profile_phase = PHASE_HASH;
+}
+
+/*
+ * Stop timing a lookup and fold it into the session statistics
+ */
+static void profile_word_end(void) {
+  uint8_t i;
+
+  profile_enter(PHASE_OTHER);
+  profile_words++;
+  for (i = 0; i < NUM_PHASES; i++) {
+    profile_total[i] += profile_word[i];
+    if (profile_word[i] > profile_max[i])
+      profile_max[i] = profile_word[i];
   }
-  hash += (hash << 3);
-  hash ^= (hash >> 11);
-  hash += (hash << 15);
-  return hash;
 }
 
-uint32_t hash_murmur(const char *word, uint8_t seed) {
-  uint32_t hash = seed + 0x9747b28cUL;
-  while (*word) {
-    hash ^= (uint8_t)(*word);
-    hash *= 0x5bd1e995UL;
-    hash ^= (hash >> 15);
-    word++;
+/*
+ * Print a cycle count as milliseconds with one decimal
+ */
+static void profile_print_ms(uint32_t cycles) {
+  uint32_t per_ms = KERNAL_PAL_FLAG ? CYCLES_PER_MS_PAL : CYCLES_PER_MS_NTSC;
+  uint32_t tenths = cycles * 10 / per_ms;
+
+  console_printf("%6lu.%lu", tenths / 10, tenths % 10);
+}
+
+/*
+ * Print the last lookup's phases next to the session mean and maximum
+ */
+static void profile_report(void) {
+  uint8_t i;
+  uint32_t word_total = 0;
+
+  console_printf("phase ms    word    mean     max\n");
+  for (i = 0; i < NUM_PHASES; i++) {
+    word_total += profile_word[i];
+    console_printf("%-8s", phase_names[i]);
+    profile_print_ms(profile_word[i]);
+    profile_print_ms(profile_total[i] / profile_words);
+    profile_print_ms(profile_max[i]);
+    console_printf("\n");
   }
-  return hash;
+  console_printf("total   ");
+  profile_print_ms(word_total);
+  console_printf("\nreads: %u", profile_reads);
+#if BLOOM_CACHE_SLOTS > 0
+  console_printf(", cache hits: %u", cache_hits - profile_hits_start);
+#endif
+  console_printf(", words: %u\n", profile_words);
 }
 
-/* Array of hash functions - first NUM_HASH_FUNCTIONS will be used */
-const hash_func_t hash_functions[NUM_HASH_FUNCTIONS] = {
-    hash_fnv1a, hash_djb2, hash_sdbm, hash_jenkins, hash_murmur};
+#define PROFILE_ENTER(phase) uint8_t profile_saved = profile_enter(phase)
+#define PROFILE_LEAVE() profile_enter(profile_saved)
+#define PROFILE_READ() profile_reads++
+#else
+#define PROFILE_ENTER(phase)
+#define PROFILE_LEAVE()
+#define PROFILE_READ()
+#endif
 
 /* ========================================================================== */
 /* CBM DOS UTILITIES                                                         */
 /* ========================================================================== */
 /* Low-level Commodore DOS error checking and status reading                 */
 
+#if BLOOM_STRIPED
+/*
+ * Position of a device in stripe_devices
+ *
+ * Each drive after the first has its own command and direct access files:
+ * CBM_CMD_CHANNEL - drive and direct_lfn + STRIPE_LFN_STEP * drive.
+ */
+static uint8_t drive_index(uint8_t device) {
+  uint8_t drive;
+
+  for (drive = 1; drive < BLOOM_DEVICE_COUNT; drive++) {
+    if (stripe_devices[drive] == device)
+      return drive;
+  }
+  return 0;
+}
+
+#define DRIVE_COMMAND_LFN(device) (CBM_CMD_CHANNEL - drive_index(device))
+#define DIRECT_LFN(device) (direct_lfn + STRIPE_LFN_STEP * drive_index(device))
+#else
+#define drive_index(device) 0
+#define DRIVE_COMMAND_LFN(device) CBM_CMD_CHANNEL
+#define DIRECT_LFN(device) direct_lfn
+#endif
+
+#if BLOOM_BENCH
+/* The benchmark's results drive is not a filter drive */
+#define COMMAND_LFN(device)                                                    \
+  ((device) == BENCH_DEVICE ? bench_command_lfn : DRIVE_COMMAND_LFN(device))
+#else
+#define COMMAND_LFN(device) DRIVE_COMMAND_LFN(device)
+#endif
+
+/*
+ * Print one progress period for a disk access
+ */
+static void progress_period(void) {
+  if (!debug_mode && !quiet_mode) {
+    console_printf(".");
+    period_count++;
+  }
+}
+
 /*
  * Read DOS error status from command channel
  *
@@ -169,7 +661,7 @@ static uint8_t read_dos_status(uint8_t device, char *msg_buf,
   uint8_t c, status;
 
   /* Set input to command channel */
-  if (cbm_k_chkin(CBM_CMD_CHANNEL)) {
+  if (cbm_k_chkin(COMMAND_LFN(device))) {
     cbm_k_clrch();
     if (msg_buf && msg_bufsize) {
       strncpy(msg_buf, "CHKIN 15 FAIL", msg_bufsize - 1);
@@ -219,10 +711,12 @@ static bool check_dos_status(uint8_t device, const char *operation,
   uint8_t i;
   bool is_ok;
 
+  PROFILE_ENTER(PHASE_STATUS);
   err = read_dos_status(device, msg, sizeof(msg));
+  PROFILE_LEAVE();
 
   if (debug_mode) {
-    printf("%s: DOS %02u,%s\n", operation, err, msg);
+    console_printf("%s: DOS %02u,%s\n", operation, err, msg);
   }
 
   /* Check if error code is 0 or in the OK list */
@@ -233,267 +727,2501 @@ static bool check_dos_status(uint8_t device, const char *operation,
   }
 
   if (!is_ok) {
-    printf("ERR: %s failed\n", operation);
+    console_printf("ERR: %s failed\n", operation);
   }
 
   return is_ok;
 }
 
-/* ========================================================================== */
-/* BLOOM FILTER FILE I/O                                                     */
-/* ========================================================================== */
-/* REL file management and bit-level access to Bloom filter data             */
+#if BLOOM_FAST_SERIAL
+/*
+ * Look for a name, as PETSCII letters in either case, in len bytes of text
+ */
+static bool petscii_find(const uint8_t *text, uint16_t len, const char *name) {
+  uint8_t name_len = strlen(name);
+  uint16_t i;
+  uint8_t j;
+
+  for (i = 0; i + name_len <= len; i++) {
+    for (j = 0; j < name_len && petscii_letter(text[i + j]) == name[j]; j++)
+      ;
+    if (j == name_len)
+      return true;
+  }
+  return false;
+}
 
 /*
- * Open bloom filter file for reading
+ * Check for JiffyDOS at both ends of the serial bus
  *
- * Returns: true on success, false on error
+ * Returns: true if the KERNAL and the drive both speak JiffyDOS
  *
- * Opens BLOOM.DAT as a REL file with 254-byte records. The Bloom filter
- * data is stored sequentially across these records.
+ * A JiffyDOS KERNAL keeps the KERNAL entry points, so CHRIN already uses
+ * the faster protocol whenever the drive speaks it too; the answer only
+ * tells the program how cheap a whole record is. The KERNAL names itself
+ * in its startup banner, and the drive in the 73 message it reports after
+ * a UI reset. Only a JiffyDOS KERNAL resets the drive, so call this with
+ * nothing but the command channel open.
  */
-static bool bloom_open(void) {
-  uint8_t status;
+static bool jiffydos_detect(uint8_t device) {
+  char msg[40];
 
-  /* Open command channel */
-  cbm_k_setlfs(CBM_CMD_CHANNEL, bloom_device, CBM_CMD_CHANNEL);
-  cbm_k_setnam("");
-  status = cbm_k_open();
-  if (status) {
-    printf("ERR: open cmd ch, status=%u\n", status);
+  if (!petscii_find(KERNAL_ROM, KERNAL_ROM_SIZE, JIFFYDOS_NAME))
     return false;
-  }
-  check_dos_status(bloom_device, "open cmd", NULL, 0);
 
-  /* Open bloom data file as REL with RECORD_SIZE-byte records */
-  cbm_k_setlfs(bloom_lfn, bloom_device, bloom_secondary);
-  cbm_k_setnam("BLOOM.DAT,L,\xFE");
-  status = cbm_k_open();
-  if (status) {
-    printf("ERR: open bloom, status=%u\n", status);
+  if (cbm_k_chkout(COMMAND_LFN(device))) {
+    cbm_k_clrch();
     return false;
   }
-  if (!check_dos_status(bloom_device, "open bloom", NULL, 0)) {
+  cbm_k_bsout('U');
+  cbm_k_bsout('I');
+  cbm_k_clrch();
+
+  return read_dos_status(device, msg, sizeof(msg)) == DOS_VERSION_MESSAGE &&
+         petscii_find((const uint8_t *)msg, strlen(msg), JIFFYDOS_NAME);
+}
+#endif
+
+#if BLOOM_REU
+/* ========================================================================== */
+/* RAM EXPANSION UNIT                                                        */
+/* ========================================================================== */
+/* DMA between C64 RAM and a 17xx REU                                        */
+
+/*
+ * Copy len bytes between C64 RAM and REU page page, from offset
+ *
+ * The REU halts the CPU until the transfer is done: about one cycle per
+ * byte.
+ */
+static void reu_transfer(uint8_t command, uint8_t *c64, uint16_t page,
+                         uint8_t offset, uint16_t len) {
+  REU_C64_LO = (uint16_t)c64 & 0xFF;
+  REU_C64_HI = (uint16_t)c64 >> 8;
+  REU_ADDR_LO = offset;
+  REU_ADDR_HI = page & 0xFF;
+  REU_BANK = page >> 8;
+  REU_LENGTH_LO = len & 0xFF;
+  REU_LENGTH_HI = len >> 8;
+  REU_ADDR_CONTROL = 0; /* Both addresses count up */
+  REU_COMMAND = command;
+}
+
+/*
+ * Look for an REU large enough for the whole filter
+ *
+ * Returns: true if one is present
+ *
+ * Without an REU the address registers read back open bus. A smaller REU
+ * ignores the high bank bits, so the banks are tagged from the top down
+ * and the top bank must still hold its own tag.
+ */
+static bool reu_detect(void) {
+  uint8_t bank;
+  uint8_t tag;
+
+  REU_C64_LO = REU_PROBE_PATTERN;
+  REU_C64_HI = (uint8_t)~REU_PROBE_PATTERN;
+  REU_ADDR_LO = REU_PROBE_PATTERN + 1;
+  if (REU_C64_LO != REU_PROBE_PATTERN ||
+      REU_C64_HI != (uint8_t)~REU_PROBE_PATTERN ||
+      REU_ADDR_LO != REU_PROBE_PATTERN + 1) {
     return false;
   }
 
-  current_record = -1;
+  bank = REU_BANKS;
+  do {
+    bank--;
+    tag = bank;
+    reu_transfer(REU_STASH, &tag, (uint16_t)bank << 8, 0, 1);
+  } while (bank);
+  reu_transfer(REU_FETCH, &tag, (uint16_t)(REU_BANKS - 1) << 8, 0, 1);
+
+  if (tag != REU_BANKS - 1) {
+    console_printf("REU too small: %u KB needed\n", REU_BANKS * 64);
+    return false;
+  }
   return true;
 }
 
+#if BLOOM_LAYOUT != BLOOM_LAYOUT_GCS
 /*
- * Close bloom filter file
+ * Read one byte of a record from the REU
  */
-static void bloom_close(void) {
-  cbm_k_clrch();
-  cbm_k_close(bloom_lfn);
-  cbm_k_close(CBM_CMD_CHANNEL);
+static uint8_t reu_read_byte(uint16_t rec, uint8_t offset) {
+  uint8_t value;
+
+  reu_transfer(REU_FETCH, &value, rec, offset, 1);
+  return value;
+}
+#endif
+#endif
+
+/* ========================================================================== */
+/* BLOOM FILTER FILE I/O                                                     */
+/* ========================================================================== */
+/* REL file management and bit-level access to Bloom filter data             */
+
+#if BLOOM_CACHE_SLOTS > 0
+/*
+ * Empty the record cache
+ */
+static void cache_reset(void) {
+  memset(cache_slot_of, CACHE_SLOT_NONE, sizeof(cache_slot_of));
+  memset(cache_referenced, 0, sizeof(cache_referenced));
+  cache_used = 0;
+  cache_hand = 0;
+  cache_hits = 0;
+  cache_misses = 0;
 }
 
 /*
- * Read one bit from bloom filter
+ * Choose a cache slot for a new record
  *
- * Returns: true if bit is set, false if bit is clear
+ * Returns: slot number, with any record previously held there evicted
  *
- * Translates bit position to record number and byte offset within record.
- * Caches the current record to avoid unnecessary disk seeks.
+ * Free slots are used first. After that, the CLOCK hand sweeps the slots,
+ * clearing reference bits until it finds a slot not used since its last
+ * visit.
  */
-static bool bloom_read_bit(uint32_t bit_pos) {
-  uint32_t byte_off = bit_pos / BITS_PER_BYTE;
-  uint8_t bit_off = bit_pos % BITS_PER_BYTE;
-  uint16_t rec = byte_off / RECORD_SIZE;
-  uint16_t byte_in_rec = byte_off % RECORD_SIZE;
-  uint16_t dos_rec;
-  uint16_t i;
-  uint8_t st;
+static uint8_t cache_victim(void) {
+  uint8_t slot;
+
+  if (cache_used < BLOOM_CACHE_SLOTS) {
+    return cache_used++;
+  }
 
-  /* Seek to record if not already cached */
-  if (rec != current_record) {
-    dos_rec = rec + 1; /* DOS record numbers are 1-based */
+  while (cache_referenced[cache_hand]) {
+    cache_referenced[cache_hand] = 0;
+    if (++cache_hand == BLOOM_CACHE_SLOTS)
+      cache_hand = 0;
+  }
 
-    /* Send POSITION command to command channel */
-    st = cbm_k_chkout(CBM_CMD_CHANNEL);
-    if (st) {
-      cbm_k_clrch();
-      printf("ERR: chkout 15=%u\n", st);
-      return false;
-    }
+  slot = cache_hand;
+  if (++cache_hand == BLOOM_CACHE_SLOTS)
+    cache_hand = 0;
 
-    cbm_k_bsout('P');
-    cbm_k_bsout(bloom_secondary);
-    cbm_k_bsout(dos_rec & 0xFF);
-    cbm_k_bsout((dos_rec >> 8) & 0xFF);
-    cbm_k_bsout(1);
+  /* A slot left empty by a failed read no longer owns its old record */
+  if (cache_slot_of[cache_slot_record[slot]] == slot)
+    cache_slot_of[cache_slot_record[slot]] = CACHE_SLOT_NONE;
+  return slot;
+}
+#endif
+
+#if BLOOM_RECORD_MAP
+/*
+ * Send a command string to a drive's command channel
+ *
+ * Returns: true if the drive reports no error
+ */
+static bool send_dos_command(uint8_t device, const char *cmd) {
+  uint8_t st;
+  PROFILE_ENTER(PHASE_COMMAND);
 
+  st = cbm_k_chkout(COMMAND_LFN(device));
+  if (st) {
     cbm_k_clrch();
-    check_dos_status(bloom_device, "position", NULL, 0);
+    PROFILE_LEAVE();
+    console_printf("ERR: chkout 15=%u\n", st);
+    return false;
+  }
 
-    if (!debug_mode) {
-      printf("."); /* Progress indicator */
-      period_count++;
-    }
+  while (*cmd) {
+    cbm_k_bsout(*cmd++);
+  }
 
-    /* Read entire record into buffer */
-    st = cbm_k_chkin(bloom_lfn);
-    if (st) {
-      cbm_k_clrch();
-      printf("ERR: chkin %u=%u\n", bloom_lfn, st);
-      return false;
-    }
+  cbm_k_clrch();
+  PROFILE_LEAVE();
+  return check_dos_status(device, "command", NULL, 0);
+}
 
-    for (i = 0; i < RECORD_SIZE; i++) {
-      record_buffer[i] = cbm_k_basin();
-    }
+/*
+ * Read part of the block in a drive's direct access buffer
+ *
+ * Returns: true on success, false on error
+ *
+ * B-P moves the buffer pointer to offset, and len bytes are transferred
+ * from there.
+ */
+static bool direct_read_buffer(uint8_t device, uint8_t offset, uint8_t *buf,
+                               uint16_t len) {
+  char cmd[12];
+  uint16_t i;
+  uint8_t st;
+
+  console_sprintf(cmd, "B-P:%u,%u", direct_secondary, offset);
+  if (!send_dos_command(device, cmd)) {
+    return false;
+  }
 
+  PROFILE_ENTER(PHASE_TRANSFER);
+  st = cbm_k_chkin(DIRECT_LFN(device));
+  if (st) {
     cbm_k_clrch();
-    current_record = rec;
+    PROFILE_LEAVE();
+    console_printf("ERR: chkin %u=%u\n", DIRECT_LFN(device), st);
+    return false;
   }
 
-  /* Check the bit in the cached record */
-  return (record_buffer[byte_in_rec] & (1 << bit_off)) != 0;
-}
+  for (i = 0; i < len; i++) {
+    buf[i] = cbm_k_basin();
+  }
 
-/* ========================================================================== */
-/* BLOOM FILTER LOGIC                                                        */
-/* ========================================================================== */
-/* High-level Bloom filter algorithm                                         */
+  cbm_k_clrch();
+  PROFILE_LEAVE();
+  return true;
+}
 
 /*
- * Check if word exists in Bloom filter
+ * Read part of a disk block through the direct access channel
  *
- * Returns: true if word probably in dictionary (may have false positives)
- *          false if word definitely NOT in dictionary (no false negatives)
+ * Returns: true on success, false on error
  *
- * Algorithm:
- * 1. Compute all hash values and their bit positions
- * 2. Sort bit positions for optimal disk access (left-to-right)
- * 3. Check each bit - return false immediately if any bit is unset
- * 4. Return true only if all bits are set
+ * U1 reads the block into the drive buffer without any file system
+ * bookkeeping, and the bytes from offset are then read out of the buffer.
  */
-static bool check_word(const char *word) {
-  uint8_t i, j;
-  uint32_t hash;
-  uint32_t bit_positions[NUM_HASH_FUNCTIONS];
-  uint32_t temp;
+static bool direct_read_block(uint8_t device, uint8_t track, uint8_t sector,
+                              uint8_t offset, uint8_t *buf, uint16_t len) {
+  char cmd[20];
 
-  /* Reset period counter */
-  period_count = 0;
+  console_sprintf(cmd, "U1:%u,0,%u,%u", direct_secondary, track, sector);
+  if (!send_dos_command(device, cmd)) {
+    return false;
+  }
+  return direct_read_buffer(device, offset, buf, len);
+}
 
-  if (!debug_mode) {
-    printf("Checking");
+/*
+ * Check whether a directory entry is the BLOOM.DAT REL file
+ */
+static bool is_bloom_entry(const uint8_t *entry) {
+  static const char name[] = BLOOM_FILENAME;
+  uint8_t i;
+
+  if ((entry[DIR_ENTRY_TYPE] & FILE_TYPE_MASK) != FILE_TYPE_REL) {
+    return false;
   }
 
-  /* Compute all bit positions using hash functions */
-  for (i = 0; i < NUM_HASH_FUNCTIONS; i++) {
-    hash = hash_functions[i](word, i);
-    bit_positions[i] = hash % BLOOM_SIZE_BITS;
+  for (i = 0; i < DIR_NAME_LEN; i++) {
+    uint8_t expected = i < sizeof(name) - 1 ? name[i] : DIR_NAME_PAD;
+    if (entry[DIR_ENTRY_NAME + i] != expected)
+      return false;
   }
+  return true;
+}
 
-  /* Sort bit positions to minimize disk seeks (bubble sort) */
-  for (i = 0; i < NUM_HASH_FUNCTIONS - 1; i++) {
-    for (j = 0; j < NUM_HASH_FUNCTIONS - 1 - i; j++) {
-      if (bit_positions[j] < bit_positions[j + 1]) {
-        temp = bit_positions[j];
-        bit_positions[j] = bit_positions[j + 1];
-        bit_positions[j + 1] = temp;
+/*
+ * Build the record-to-block map from a drive's BLOOM.DAT side sectors
+ *
+ * Returns: true if every record on the drive was mapped
+ *
+ * Walks the directory to find the first side sector, then follows the
+ * side sector chain. Each side sector lists the track/sector of up to 120
+ * data blocks, and with 254-byte records data block N holds the drive's
+ * record N. On a 1581 the directory points at the super side sector, which
+ * links to the first side sector. A striped filter keeps every
+ * BLOOM_DEVICE_COUNT-th record on each drive.
+ */
+static bool direct_build_map(uint8_t device) {
+  uint8_t track = BLOOM_DIR_TRACK;
+  uint8_t sector = BLOOM_DIR_SECTOR;
+  uint8_t i;
+  uint16_t rec = 0;
+  uint16_t slot;
+  const uint8_t *entry;
+  bool found = false;
+
+  /* Find the directory entry and its first side sector */
+  while (track && !found) {
+    if (!direct_read_block(device, track, sector, 0, block_buffer,
+                           BLOCK_SIZE)) {
+      return false;
+    }
+    for (entry = block_buffer; entry < block_buffer + BLOCK_SIZE;
+         entry += DIR_ENTRY_SIZE) {
+      if (is_bloom_entry(entry)) {
+        found = true;
+        track = entry[DIR_ENTRY_SIDE_TS];
+        sector = entry[DIR_ENTRY_SIDE_TS + 1];
+        break;
       }
     }
+    if (!found) {
+      track = block_buffer[0];
+      sector = block_buffer[1];
+    }
   }
 
-  /* Check bits in sorted order (left-to-right on disk) */
-  for (i = 0; i < NUM_HASH_FUNCTIONS; i++) {
-    if (!bloom_read_bit(bit_positions[i])) {
-      return false; /* Definitely not in dictionary */
+  if (!found) {
+    console_printf("ERR: %s not in directory\n", BLOOM_FILENAME);
+    return false;
+  }
+
+  /* Collect data block locations from each side sector */
+  while (track && rec < DEVICE_RECORDS) {
+    if (!direct_read_block(device, track, sector, 0, block_buffer,
+                           BLOCK_SIZE)) {
+      return false;
     }
+    if (block_buffer[SIDE_SECTOR_NUMBER] != SUPER_SIDE_SECTOR) {
+      for (i = 0; i < SIDE_SECTOR_ENTRIES && rec < DEVICE_RECORDS; i++) {
+        slot = rec * BLOOM_DEVICE_COUNT + drive_index(device);
+        record_track[slot] = block_buffer[SIDE_SECTOR_DATA_TS + 2 * i];
+        record_sector[slot] = block_buffer[SIDE_SECTOR_DATA_TS + 2 * i + 1];
+        if (!record_track[slot])
+          break;
+        rec++;
+      }
+    }
+    track = block_buffer[0];
+    sector = block_buffer[1];
   }
 
-  return true; /* Probably in dictionary */
-}
+  if (rec < DEVICE_RECORDS) {
+    console_printf("ERR: map has %u of %u records\n", rec, DEVICE_RECORDS);
+    return false;
+  }
 
-/* ========================================================================== */
-/* STRING UTILITIES                                                          */
-/* ========================================================================== */
-/* PETSCII conversion and string manipulation                                */
+  if (debug_mode) {
+    console_printf("record map: %u records\n", rec);
+  }
+  return true;
+}
+#endif
 
+#if BLOOM_ACCESS == BLOOM_ACCESS_DRIVE || BLOOM_STRIPED
 /*
- * Convert PETSCII input to uppercase ASCII
+ * Send a drive memory command: M-W with data, M-R, or M-E
  *
- * Handles three PETSCII character ranges:
- * - PETSCII lowercase (0xC1-0xDA) -> ASCII uppercase (A-Z)
- * - PETSCII uppercase (0x41-0x5A) -> ASCII uppercase (A-Z)
- * - PETSCII shifted lowercase (0x61-0x7A) -> ASCII uppercase (A-Z)
+ * Returns: true if the command was sent
  *
- * Conversion ensures consistent hashing regardless of how user typed the word.
+ * The address and length are binary, so these commands cannot go
+ * through send_dos_command(). They leave the error channel alone.
  */
-void petscii_to_ascii_upper(char *str) {
-  while (*str) {
-    unsigned char c = (unsigned char)*str;
+static bool drive_memory_command(uint8_t device, char op, uint16_t addr,
+                                 const uint8_t *data, uint8_t len) {
+  uint8_t st;
+  uint8_t i;
+  PROFILE_ENTER(PHASE_COMMAND);
 
-    /* PETSCII lowercase letters (a-z) */
-    if (c >= PETSCII_LOWERCASE_START && c <= PETSCII_LOWERCASE_END) {
-      *str = c - PETSCII_TO_ASCII_OFFSET;
-    }
-    /* PETSCII uppercase letters (A-Z) - already ASCII */
-    else if (c >= PETSCII_UPPERCASE_START && c <= PETSCII_UPPERCASE_END) {
-      *str = c;
-    }
-    /* PETSCII shifted lowercase (A-Z) */
-    else if (c >= PETSCII_SHIFTED_START && c <= PETSCII_SHIFTED_END) {
-      *str = c - LOWERCASE_TO_UPPERCASE_OFFSET;
-    }
+  st = cbm_k_chkout(COMMAND_LFN(device));
+  if (st) {
+    cbm_k_clrch();
+    PROFILE_LEAVE();
+    console_printf("ERR: chkout 15=%u\n", st);
+    return false;
+  }
 
-    str++;
+  cbm_k_bsout('M');
+  cbm_k_bsout('-');
+  cbm_k_bsout(op);
+  cbm_k_bsout(addr & 0xFF);
+  cbm_k_bsout(addr >> 8);
+  if (op != 'E') {
+    cbm_k_bsout(len);
+  }
+  if (data) {
+    for (i = 0; i < len; i++) {
+      cbm_k_bsout(data[i]);
+    }
   }
+
+  cbm_k_clrch();
+  PROFILE_LEAVE();
+  return true;
 }
 
 /*
- * Trim leading and trailing whitespace
+ * Read one byte of drive memory with M-R
  */
-void trim(char *str) {
-  char *end;
+static uint8_t drive_peek(uint8_t device, uint16_t addr) {
+  uint8_t value;
 
-  /* Trim leading space */
-  while (isspace((unsigned char)*str))
-    str++;
+  if (!drive_memory_command(device, 'R', addr, NULL, 1)) {
+    return 0;
+  }
 
-  if (*str == 0)
-    return;
+  PROFILE_ENTER(PHASE_TRANSFER);
+  cbm_k_chkin(COMMAND_LFN(device));
+  value = cbm_k_basin();
+  cbm_k_clrch();
+  PROFILE_LEAVE();
+  return value;
+}
+#endif
 
-  /* Trim trailing space */
-  end = str + strlen(str) - 1;
-  while (end > str && isspace((unsigned char)*end))
-    end--;
+#if BLOOM_ACCESS == BLOOM_ACCESS_DRIVE
 
-  *(end + 1) = '\0';
+/*
+ * Upload the probe routine into drive buffer 2
+ *
+ * Returns: true on success, false on error
+ */
+static bool drive_upload(void) {
+  static const uint8_t no_block[2] = {0, 0};
+  uint8_t offset;
+  uint8_t len;
+
+  for (offset = 0; offset < sizeof(drive_code); offset += len) {
+    len = sizeof(drive_code) - offset;
+    if (len > DRIVE_WRITE_CHUNK)
+      len = DRIVE_WRITE_CHUNK;
+    if (!drive_memory_command(bloom_device, 'W', DRIVE_CODE_ADDR + offset,
+                              drive_code + offset, len)) {
+      return false;
+    }
+  }
+
+  /* Nothing has been read into buffer 1 yet */
+  return drive_memory_command(bloom_device, 'W', DRIVE_STATE_ADDR, no_block,
+                              sizeof(no_block));
 }
 
-/* ========================================================================== */
-/* MAIN PROGRAM                                                              */
-/* ========================================================================== */
+/*
+ * Test up to DRIVE_MAX_PROBES bits inside the drive
+ *
+ * Returns: index of the first clear bit, count if all bits are set, or
+ *          DRIVE_READ_ERROR
+ *
+ * One M-W carries the whole probe list, M-E runs the routine, and M-R
+ * fetches its result: about 40 bytes on the serial bus instead of a
+ * 254-byte record per probe.
+ */
+static uint8_t drive_test_probes(const bloom_probe_t *probes, uint8_t count) {
+  uint8_t request[DRIVE_REQUEST_SIZE];
+  uint8_t *p = request;
+  uint8_t i;
+  uint8_t result = 0;
+  uint8_t tries = DRIVE_POLL_LIMIT;
+
+  progress_period();
+  PROFILE_READ();
+
+  *p++ = 0; /* Result: not done */
+  *p++ = count;
+  for (i = 0; i < count; i++) {
+    *p++ = record_track[probes[i].record];
+    *p++ = record_sector[probes[i].record];
+    *p++ = probes[i].byte + BLOCK_DATA_OFFSET;
+    *p++ = probes[i].mask;
+  }
+
+  if (!drive_memory_command(bloom_device, 'W', DRIVE_REQUEST_ADDR, request,
+                            p - request) ||
+      !drive_memory_command(bloom_device, 'E', DRIVE_CODE_ADDR, NULL, 0)) {
+    PROBE_FAILED();
+    return DRIVE_READ_ERROR;
+  }
+
+  /* M-R is serviced once the routine returns; poll in case it is late */
+  while (!(result & DRIVE_DONE) && tries--) {
+    result = drive_peek(bloom_device, DRIVE_REQUEST_ADDR);
+  }
+
+  if (result == DRIVE_READ_ERROR || !(result & DRIVE_DONE)) {
+    console_printf("ERR: drive probe failed\n");
+    PROBE_FAILED();
+    return DRIVE_READ_ERROR;
+  }
+  return result & ~DRIVE_DONE;
+}
+#endif
+
+/*
+ * Open a drive's command channel
+ *
+ * Returns: true on success, false on error
+ *
+ * Opening the channel sends no command, so there is no status to read
+ * yet; the next check_dos_status() reports anything left from before.
+ */
+static bool command_open(uint8_t device) {
+  uint8_t status;
+
+  cbm_k_setlfs(COMMAND_LFN(device), device, CBM_CMD_CHANNEL);
+  cbm_k_setnam("");
+  status = cbm_k_open();
+  if (status) {
+    console_printf("ERR: open cmd ch, status=%u\n", status);
+    return false;
+  }
+  return true;
+}
+
+#if BLOOM_RECORD_MAP
+/*
+ * Open a drive's direct access buffer and map its BLOOM.DAT blocks
+ *
+ * Returns: true on success, false on error
+ */
+static bool direct_open(uint8_t device) {
+  uint8_t status;
+
+  cbm_k_setlfs(DIRECT_LFN(device), device, direct_secondary);
+  cbm_k_setnam(DIRECT_BUFFER_NAME);
+  status = cbm_k_open();
+  if (status) {
+    console_printf("ERR: open direct, status=%u\n", status);
+    return false;
+  }
+  if (!check_dos_status(device, "open direct", NULL, 0)) {
+    return false;
+  }
+  return direct_build_map(device);
+}
+#endif
+
+/*
+ * Open bloom filter file for reading
+ *
+ * Returns: true on success, false on error
+ *
+ * Opens BLOOM.DAT as a REL file with 254-byte records. The Bloom filter
+ * data is stored sequentially across these records. A striped filter opens
+ * a command channel and a direct access buffer on every drive. The REL
+ * file's status is left for bloom_open_finish().
+ */
+static bool bloom_open(void) {
+#if BLOOM_STRIPED
+  uint8_t drive;
+
+  for (drive = 0; drive < BLOOM_DEVICE_COUNT; drive++) {
+    if (!command_open(stripe_devices[drive]) ||
+        !direct_open(stripe_devices[drive])) {
+      return false;
+    }
+  }
+  memset(stripe_record, 0xFF, sizeof(stripe_record)); /* RECORD_NONE */
+#else
+#if BLOOM_ACCESS != BLOOM_ACCESS_DIRECT
+  uint8_t status;
+#endif
+
+  if (!command_open(bloom_device)) {
+    return false;
+  }
+
+#if BLOOM_FAST_SERIAL
+  fast_serial = jiffydos_detect(bloom_device);
+  if (fast_serial)
+    console_printf("JiffyDOS: caching whole records\n");
+#endif
+
+#if BLOOM_RECORD_MAP
+  if (!direct_open(bloom_device)) {
+    return false;
+  }
+#if BLOOM_ACCESS == BLOOM_ACCESS_DRIVE
+  /* Reserve buffer 2 so the DOS never overwrites the probe routine */
+  cbm_k_setlfs(drive_lfn, bloom_device, drive_secondary);
+  cbm_k_setnam("#2");
+  status = cbm_k_open();
+  if (status) {
+    console_printf("ERR: open drive buffer, status=%u\n", status);
+    return false;
+  }
+  if (!check_dos_status(bloom_device, "open drive buffer", NULL, 0)) {
+    return false;
+  }
+  if (!drive_upload()) {
+    return false;
+  }
+#endif
+#else
+  /* Open bloom data file as REL with RECORD_SIZE-byte records */
+  cbm_k_setlfs(bloom_lfn, bloom_device, bloom_secondary);
+  cbm_k_setnam(BLOOM_FILENAME ",L,\xFE");
+  status = cbm_k_open();
+  if (status) {
+    console_printf("ERR: open bloom, status=%u\n", status);
+    return false;
+  }
+#endif
+#endif
+
+#if BLOOM_CACHE_SLOTS > 0
+  cache_reset();
+#endif
+  return true;
+}
+
+/*
+ * Finish opening the bloom filter file
+ *
+ * Returns: true on success, false on error
+ *
+ * The DOS looks BLOOM.DAT up and reads its side sectors after the OPEN
+ * has been sent; reading the status waits for that. Until then the
+ * computer is free to print the banner.
+ */
+static bool bloom_open_finish(void) {
+#if !BLOOM_STRIPED && !BLOOM_RECORD_MAP
+  if (!check_dos_status(bloom_device, "open bloom", NULL, 0)) {
+    return false;
+  }
+#endif
+  return true;
+}
+
+/*
+ * Close bloom filter file
+ */
+static void bloom_close(void) {
+#if BLOOM_STRIPED
+  uint8_t drive;
+
+  cbm_k_clrch();
+  for (drive = 0; drive < BLOOM_DEVICE_COUNT; drive++) {
+    cbm_k_close(DIRECT_LFN(stripe_devices[drive]));
+    cbm_k_close(COMMAND_LFN(stripe_devices[drive]));
+  }
+#else
+  cbm_k_clrch();
+#if BLOOM_ACCESS == BLOOM_ACCESS_DRIVE
+  cbm_k_close(drive_lfn);
+#endif
+#if BLOOM_RECORD_MAP
+  cbm_k_close(direct_lfn);
+#else
+  cbm_k_close(bloom_lfn);
+#endif
+  cbm_k_close(CBM_CMD_CHANNEL);
+#endif
+}
+
+#if BLOOM_CACHE_SLOTS > 0
+#if !BLOOM_RECORD_MAP
+/*
+ * Position the REL channel with a P command
+ *
+ * Returns: true if the command was sent
+ *
+ * rec is 0-based; pos is the 1-based byte within the record where the
+ * next read will start. The DOS status is left for the caller to read.
+ */
+static bool rel_position(uint16_t rec, uint8_t pos) {
+  uint16_t dos_rec = rec + 1; /* DOS record numbers are 1-based */
+  uint8_t st;
+  PROFILE_ENTER(PHASE_COMMAND);
+
+  st = cbm_k_chkout(CBM_CMD_CHANNEL);
+  if (st) {
+    cbm_k_clrch();
+    PROFILE_LEAVE();
+    console_printf("ERR: chkout 15=%u\n", st);
+    return false;
+  }
+
+  cbm_k_bsout('P');
+  cbm_k_bsout(bloom_secondary);
+  cbm_k_bsout(dos_rec & 0xFF);
+  cbm_k_bsout((dos_rec >> 8) & 0xFF);
+  cbm_k_bsout(pos);
+
+  cbm_k_clrch();
+  PROFILE_LEAVE();
+  return true;
+}
+#endif
+
+#if BLOOM_STRIPED
+/*
+ * Wait for a drive's queued read to finish
+ *
+ * Returns: true if the block is in the drive's buffer 1
+ */
+static bool stripe_wait(uint8_t drive) {
+  uint8_t device = stripe_devices[drive];
+  uint16_t tries = JOB_POLL_LIMIT;
+  uint8_t code;
+
+  do {
+    code = drive_peek(device, JOB_CODE_ADDR);
+  } while ((code & JOB_READ) && --tries);
+
+  if (code != JOB_OK) {
+    stripe_record[drive] = RECORD_NONE;
+    console_printf("ERR: job %u on drive %u\n", code, device);
+    return false;
+  }
+  return true;
+}
+
+/*
+ * Queue a read of a record's block on its drive's job queue
+ *
+ * Returns: true if the read is queued
+ *
+ * The drive seeks and reads in the background, so records on different
+ * drives are fetched concurrently; P and U1 commands would hold the bus
+ * until the block is read. A read still running on the drive is waited
+ * for first, since it owns buffer 1.
+ */
+static bool stripe_queue(uint16_t rec) {
+  static const uint8_t job_read = JOB_READ;
+  uint8_t drive = rec % BLOOM_DEVICE_COUNT;
+  uint8_t device = stripe_devices[drive];
+  uint8_t header[2];
+
+  if (stripe_record[drive] == rec) {
+    return true;
+  }
+  if (stripe_record[drive] != RECORD_NONE) {
+    stripe_wait(drive);
+  }
+
+  header[0] = record_track[rec];
+  header[1] = record_sector[rec];
+  stripe_record[drive] = RECORD_NONE;
+  if (!drive_memory_command(device, 'W', JOB_HEADER_ADDR, header,
+                            sizeof(header)) ||
+      !drive_memory_command(device, 'W', JOB_CODE_ADDR, &job_read, 1)) {
+    return false;
+  }
+  stripe_record[drive] = rec;
+  return true;
+}
+
+/*
+ * Start reading an upcoming record if its drive is idle
+ *
+ * Called ahead of the lookup that needs the record, so the other drives
+ * seek while the current one is being waited for.
+ */
+static void stripe_prefetch(uint16_t rec) {
+#if BLOOM_REU
+  if (reu_present) {
+    return;
+  }
+#endif
+  if (stripe_record[rec % BLOOM_DEVICE_COUNT] == RECORD_NONE &&
+      cache_slot_of[rec] == CACHE_SLOT_NONE) {
+    stripe_queue(rec);
+  }
+}
+
+/*
+ * Read one record of a striped filter
+ *
+ * Returns: true on success, false on error
+ */
+static bool stripe_read_record(uint16_t rec, uint8_t *buf) {
+  uint8_t drive = rec % BLOOM_DEVICE_COUNT;
+  bool ok;
+
+  ok = stripe_queue(rec) && stripe_wait(drive) &&
+       direct_read_buffer(stripe_devices[drive], BLOCK_DATA_OFFSET, buf,
+                          RECORD_SIZE);
+  stripe_record[drive] = RECORD_NONE;
+  return ok;
+}
+#endif
+
+/*
+ * Read one record from disk
+ *
+ * Returns: true on success, false on error
+ *
+ * REL access positions the REL channel to the start of the record with a
+ * P command. Direct access reads the record's data block with U1, using
+ * the map built by direct_build_map(); a striped filter queues the read
+ * on the record's drive instead. Either way all RECORD_SIZE bytes are read
+ * into buf.
+ */
+static bool bloom_load_record(uint16_t rec, uint8_t *buf) {
+#if BLOOM_ACCESS != BLOOM_ACCESS_DIRECT
+  uint16_t i;
+  uint8_t st;
+#endif
+
+  progress_period();
+  PROFILE_READ();
+
+#if BLOOM_STRIPED
+  return stripe_read_record(rec, buf);
+#elif BLOOM_ACCESS == BLOOM_ACCESS_DIRECT
+  return direct_read_block(bloom_device, record_track[rec], record_sector[rec],
+                           BLOCK_DATA_OFFSET, buf, RECORD_SIZE);
+#else
+  /* Send POSITION command to command channel */
+  if (!rel_position(rec, 1)) {
+    return false;
+  }
+  check_dos_status(bloom_device, "position", NULL, 0);
+
+  /* Read entire record into buffer */
+  PROFILE_ENTER(PHASE_TRANSFER);
+  st = cbm_k_chkin(bloom_lfn);
+  if (st) {
+    cbm_k_clrch();
+    PROFILE_LEAVE();
+    console_printf("ERR: chkin %u=%u\n", bloom_lfn, st);
+    return false;
+  }
+
+  for (i = 0; i < RECORD_SIZE; i++) {
+    buf[i] = cbm_k_basin();
+  }
+
+  cbm_k_clrch();
+  PROFILE_LEAVE();
+  return true;
+#endif
+}
+
+#if BLOOM_ACCESS == BLOOM_ACCESS_REL_BYTE
+/*
+ * Read a single byte of a record
+ *
+ * Returns: true on success, false on error
+ *
+ * The P command positions straight to the byte, so one byte crosses the
+ * serial bus instead of the whole record. The status channel is only read
+ * in debug mode, since reading it costs more than the data.
+ */
+static bool bloom_read_byte(uint16_t rec, uint8_t offset, uint8_t *value) {
+  uint8_t st;
+
+  progress_period();
+  PROFILE_READ();
+
+  if (!rel_position(rec, offset + 1)) {
+    return false;
+  }
+  if (debug_mode && !check_dos_status(bloom_device, "position", NULL, 0)) {
+    return false;
+  }
+
+  PROFILE_ENTER(PHASE_TRANSFER);
+  st = cbm_k_chkin(bloom_lfn);
+  if (st) {
+    cbm_k_clrch();
+    PROFILE_LEAVE();
+    console_printf("ERR: chkin %u=%u\n", bloom_lfn, st);
+    return false;
+  }
+
+  *value = cbm_k_basin();
+  cbm_k_clrch();
+  PROFILE_LEAVE();
+  return true;
+}
+#endif
+
+/*
+ * Get a record through the record cache
+ *
+ * Returns: pointer to the cached record data, or NULL on disk error
+ */
+static const uint8_t *bloom_get_record(uint16_t rec) {
+  uint8_t slot = cache_slot_of[rec];
+
+  if (slot != CACHE_SLOT_NONE) {
+    cache_hits++;
+    cache_referenced[slot] = 1;
+    return record_cache[slot];
+  }
+
+  cache_misses++;
+  slot = cache_victim();
+  if (!bloom_load_record(rec, record_cache[slot])) {
+    cache_referenced[slot] = 0; /* Leave the slot empty for reuse */
+    PROBE_FAILED();
+    return NULL;
+  }
+
+  cache_slot_record[slot] = rec;
+  cache_slot_of[rec] = slot;
+  cache_referenced[slot] = 1;
+  return record_cache[slot];
+}
+
+#if BLOOM_LAYOUT == BLOOM_LAYOUT_FUSE
+/*
+ * Read one binary fuse filter probe's share of its word's lookup
+ *
+ * Returns: true on success, false on disk error; share receives the
+ * probe's byte XOR the fingerprint share it carries
+ *
+ * The byte comes from the REU, the record cache or a rel_byte read, as
+ * a Bloom filter bit does in bloom_test_probe(). A share alone decides
+ * nothing: the word passes if its NUM_BIT_PROBES shares XOR to zero.
+ */
+static bool bloom_probe_share(const bloom_probe_t *probe, uint8_t *share) {
+  const uint8_t *record;
+
+#if BLOOM_REU
+  if (reu_present) {
+    *share = reu_read_byte(probe->record, probe->byte) ^ probe->mask;
+    return true;
+  }
+#endif
+
+#if BLOOM_ACCESS == BLOOM_ACCESS_REL_BYTE
+  if (cache_slot_of[probe->record] == CACHE_SLOT_NONE && !fast_serial) {
+    cache_misses++;
+    if (!bloom_read_byte(probe->record, probe->byte, share)) {
+      PROBE_FAILED();
+      return false;
+    }
+    *share ^= probe->mask;
+    return true;
+  }
+#endif
+
+  record = bloom_get_record(probe->record);
+  if (!record) {
+    return false;
+  }
+
+  *share = bloom_record_share(record, probe);
+  return true;
+}
+#else
+/*
+ * Test one Bloom filter bit
+ *
+ * Returns: true if bit is set, false if bit is clear (or on disk error)
+ *
+ * Records are served from the record cache when possible. In rel_byte
+ * access mode the cache only holds the preloaded records, and any other
+ * probe reads just the byte it needs, unless JiffyDOS makes whole records
+ * cheap enough to cache as rel access does. With the filter in an REU, one byte
+ * is fetched by DMA and the disk is never touched. A Golomb-coded set
+ * needs the whole record, so the REU copies it into the first cache slot,
+ * which the cache leaves unused while the REU serves every probe.
+ */
+static bool bloom_test_probe(const bloom_probe_t *probe) {
+  const uint8_t *record;
+#if BLOOM_ACCESS == BLOOM_ACCESS_REL_BYTE
+  uint8_t value;
+#endif
+
+#if BLOOM_REU
+  if (reu_present) {
+#if BLOOM_LAYOUT == BLOOM_LAYOUT_GCS
+    reu_transfer(REU_FETCH, record_cache[0], probe->record, 0, RECORD_SIZE);
+    return bloom_record_hit(record_cache[0], probe);
+#else
+    return (reu_read_byte(probe->record, probe->byte) & probe->mask) != 0;
+#endif
+  }
+#endif
+
+#if BLOOM_ACCESS == BLOOM_ACCESS_REL_BYTE
+  if (cache_slot_of[probe->record] == CACHE_SLOT_NONE && !fast_serial) {
+    cache_misses++;
+    if (!bloom_read_byte(probe->record, probe->byte, &value)) {
+      PROBE_FAILED();
+      return false;
+    }
+    return (value & probe->mask) != 0;
+  }
+#endif
+
+  record = bloom_get_record(probe->record);
+  if (!record) {
+    return false;
+  }
+
+  return bloom_record_hit(record, probe);
+}
+#endif
+
+/*
+ * Test a list of Bloom filter bits in order
+ *
+ * Returns: true if every bit is set; stops at the first clear bit
+ *
+ * A binary fuse filter reads every probe and passes the word if the
+ * shares XOR to zero.
+ */
+static bool bloom_test_probes(const bloom_probe_t *probes, uint8_t count) {
+  uint8_t i;
+#if BLOOM_STRIPED
+  uint8_t j;
+#endif
+#if BLOOM_LAYOUT == BLOOM_LAYOUT_FUSE
+  uint8_t share, shares = 0;
+#endif
+
+  for (i = 0; i < count; i++) {
+#if BLOOM_STRIPED
+    for (j = i; j < count && j < i + STRIPE_LOOKAHEAD; j++) {
+      stripe_prefetch(probes[j].record);
+    }
+#endif
+#if BLOOM_LAYOUT == BLOOM_LAYOUT_FUSE
+    if (!bloom_probe_share(&probes[i], &share)) {
+      return false;
+    }
+    shares ^= share;
+#else
+    if (!bloom_test_probe(&probes[i])) {
+      return false;
+    }
+#endif
+  }
+#if BLOOM_LAYOUT == BLOOM_LAYOUT_FUSE
+  return shares == 0;
+#else
+  return true;
+#endif
+}
+#else
+/*
+ * Test a list of Bloom filter bits in order
+ *
+ * Returns: true if every bit is set (false on a clear bit or disk error)
+ *
+ * The drive reads the blocks and tests the bits itself, stopping at the
+ * first clear bit; only one result byte per request crosses the bus.
+ */
+static bool bloom_test_probes(const bloom_probe_t *probes, uint8_t count) {
+  uint8_t n;
+
+  while (count) {
+    n = count < DRIVE_MAX_PROBES ? count : DRIVE_MAX_PROBES;
+    if (drive_test_probes(probes, n) != n) {
+      return false;
+    }
+    probes += n;
+    count -= n;
+  }
+  return true;
+}
+
+/*
+ * Test one Bloom filter bit
+ *
+ * Returns: true if bit is set, false if bit is clear (or on disk error)
+ */
+static bool bloom_test_probe(const bloom_probe_t *probe) {
+  return bloom_test_probes(probe, 1);
+}
+#endif
+
+/*
+ * Read the KERNAL jiffy clock
+ *
+ * Returns: jiffies since power-on (or since TI was last set)
+ *
+ * The IRQ handler updates the three bytes non-atomically, so read until
+ * the low byte is stable across the whole read.
+ */
+static uint32_t read_jiffies(void) {
+  uint8_t lo;
+  uint32_t ticks;
+
+  do {
+    lo = JIFFY_CLOCK[2];
+    ticks = ((uint32_t)JIFFY_CLOCK[0] << 16) |
+            ((uint16_t)JIFFY_CLOCK[1] << 8) | lo;
+  } while (lo != JIFFY_CLOCK[2]);
+
+  return ticks;
+}
+
+/*
+ * Print a jiffy count as seconds with two decimals
+ */
+static void print_seconds(uint32_t jiffies) {
+  console_printf("%lu.%02lus", jiffies / JIFFIES_PER_SECOND,
+                 (jiffies % JIFFIES_PER_SECOND) * 100 / JIFFIES_PER_SECOND);
+}
+
+#if BLOOM_PRELOAD_COUNT > 0
+/*
+ * Stream the build-time list of hot records into the record cache
+ *
+ * The list is sorted by record number, so the drive head sweeps across the
+ * disk once instead of seeking back and forth.
+ */
+static void cache_preload(void) {
+  uint32_t start, elapsed;
+  uint16_t i, loaded = 0;
+#if BLOOM_STRIPED
+  uint16_t j;
+#endif
+
+#if BLOOM_REU
+  if (reu_present) {
+    return; /* Every record is already in the REU */
+  }
+#endif
+
+  console_printf("Preloading");
+  start = read_jiffies();
+
+  for (i = 0; i < BLOOM_PRELOAD_COUNT; i++) {
+#if BLOOM_STRIPED
+    for (j = i; j < BLOOM_PRELOAD_COUNT && j < i + STRIPE_LOOKAHEAD; j++) {
+      stripe_prefetch(bloom_preload_records[j]);
+    }
+#endif
+    if (bloom_get_record(bloom_preload_records[i]))
+      loaded++;
+  }
+
+  elapsed = read_jiffies() - start;
+  console_printf("\npreloaded %u records (%lu bytes) in ", loaded,
+                 (uint32_t)loaded * RECORD_SIZE);
+  print_seconds(elapsed);
+  console_printf("\n\n");
+
+  /* Session statistics start after the preload */
+  cache_hits = 0;
+  cache_misses = 0;
+}
+#endif
+
+#if BLOOM_REU
+/*
+ * Copy the whole filter from disk into the REU
+ *
+ * Returns: true if every record was loaded
+ *
+ * Records are read once in ascending order, which is also disk order, so
+ * the head makes a single pass. Cache slot 0 is borrowed as the transfer
+ * buffer; the cache is not used once the filter is in the REU.
+ */
+static bool reu_load(void) {
+  uint32_t start, elapsed;
+  uint16_t rec;
+#if BLOOM_STRIPED
+  uint16_t j;
+#endif
+
+  console_printf("Loading REU");
+  start = read_jiffies();
+
+  for (rec = 0; rec < NUM_RECORDS; rec++) {
+#if BLOOM_STRIPED
+    for (j = rec; j < NUM_RECORDS && j < rec + BLOOM_DEVICE_COUNT; j++) {
+      stripe_prefetch(j);
+    }
+#endif
+    if (!bloom_load_record(rec, record_cache[0])) {
+      console_printf("\nERR: REU load stopped at record %u\n", rec);
+      return false;
+    }
+    reu_transfer(REU_STASH, record_cache[0], rec, 0, RECORD_SIZE);
+  }
+
+  elapsed = read_jiffies() - start;
+  console_printf("\nloaded %u records (%lu bytes) into the REU in ",
+                 NUM_RECORDS, (uint32_t)NUM_RECORDS * RECORD_SIZE);
+  print_seconds(elapsed);
+  console_printf("\n\n");
+  return true;
+}
+#endif
+
+/* ========================================================================== */
+/* BLOOM FILTER LOGIC                                                        */
+/* ========================================================================== */
+/* High-level Bloom filter algorithm                                         */
+
+/*
+ * Running hashes of a word: the kernel's states, plus the common-word
+ * fingerprint when there is a table
+ *
+ * Every hash is a left-to-right fold, so a word can be hashed as it is
+ * typed; only the finishing steps are left for when it is checked. Under
+ * Pearson hashing the fingerprint is the kernel's first hash and needs
+ * no fold of its own.
+ */
+#define WORD_HASH_COMMON                                                      \
+  (COMMON_WORD_COUNT > 0 && BLOOM_HASH_SCHEME != BLOOM_HASH_PEARSON)
+
+typedef struct {
+  bloom_hash_state_t kernel;
+#if WORD_HASH_COMMON
+  uint32_t common;
+#endif
+} word_hash_t;
+
+/* Start the hashes of an empty word */
+static void word_hash_init(word_hash_t *hash) {
+  bloom_kernel_init(&hash->kernel);
+#if WORD_HASH_COMMON
+  hash->common = jenkins_init(0);
+#endif
+}
+
+/* Hash one more uppercase ASCII character */
+static void word_hash_step(word_hash_t *hash, uint8_t c) {
+  bloom_kernel_step(&hash->kernel, c);
+#if WORD_HASH_COMMON
+  hash->common = jenkins_step(hash->common, c);
+#endif
+}
+
+#if COMMON_WORD_COUNT > 0
+/* The hash common_word_hash() would compute for the word */
+static uint32_t word_hash_common(const word_hash_t *hash) {
+#if WORD_HASH_COMMON
+  return jenkins_final(hash->common);
+#else
+  return bloom_kernel_fingerprint(&hash->kernel);
+#endif
+}
+#endif
+
+/* Hash a whole word */
+static void word_hash_string(word_hash_t *hash, const char *word) {
+  word_hash_init(hash);
+  while (*word) {
+    word_hash_step(hash, (uint8_t)*word);
+    word++;
+  }
+}
+
+/*
+ * Finish a word's hashes into its probes, sorted by record
+ *
+ * Returns: false if the word is a common word, which needs no probes
+ *
+ * Sorting by record minimizes disk seeks: probes are then tested in
+ * left-to-right disk order.
+ */
+static bool word_hash_probes(const word_hash_t *hash, bloom_probe_t *probes) {
+#if COMMON_WORD_COUNT > 0
+  if (common_word_lookup(word_hash_common(hash))) {
+    common_hits++;
+    return false;
+  }
+#endif
+
+  /* Compute all probes using hash functions */
+  bloom_kernel_finish(&hash->kernel, probes);
+  bloom_sort_probes(probes);
+  return true;
+}
+
+#if BLOOM_RECENT_WORDS > 0
+/*
+ * Forget every recently checked word
+ */
+static void recent_reset(void) {
+  memset(recent_bucket, RECENT_NONE, sizeof(recent_bucket));
+  recent_used = 0;
+  recent_hand = 0;
+  recent_hits = 0;
+}
+
+/* The hash chain a fingerprint is kept on */
+static uint8_t *recent_chain(uint32_t fingerprint) {
+  return &recent_bucket[(uint8_t)fingerprint & (RECENT_BUCKETS - 1)];
+}
+
+/*
+ * Find a recently checked word by its fingerprint
+ *
+ * Returns: its entry, or RECENT_NONE
+ */
+static uint8_t recent_find(uint32_t fingerprint) {
+  uint8_t idx;
+
+  for (idx = *recent_chain(fingerprint); idx != RECENT_NONE;
+       idx = recent_next[idx]) {
+    if (recent_fingerprint[idx] == fingerprint)
+      break;
+  }
+  return idx;
+}
+
+/*
+ * Look up a word's remembered result
+ *
+ * Returns: true if the word was checked lately; found receives its result
+ *
+ * A fingerprint is the first of the word's hashes, finished alone. Two
+ * words among the last few hundred sharing all 32 bits is far less
+ * likely than a false positive from the filter itself.
+ */
+static bool recent_lookup(uint32_t fingerprint, bool *found) {
+  uint8_t idx = recent_find(fingerprint);
+
+  if (idx == RECENT_NONE)
+    return false;
+  recent_flags[idx] |= RECENT_REFERENCED;
+  recent_hits++;
+  *found = (recent_flags[idx] & RECENT_FOUND) != 0;
+  return true;
+}
+
+/*
+ * Choose the entry for a new word
+ *
+ * Returns: entry number, with any word previously held there unlinked
+ *
+ * Free entries are used first, then the CLOCK hand sweeps them as
+ * cache_victim() sweeps the record cache.
+ */
+static uint8_t recent_victim(void) {
+  uint8_t idx;
+  uint8_t *link;
+
+  if (recent_used < BLOOM_RECENT_WORDS) {
+    return recent_used++;
+  }
+
+  while (recent_flags[recent_hand] & RECENT_REFERENCED) {
+    recent_flags[recent_hand] &= ~RECENT_REFERENCED;
+    if (++recent_hand == BLOOM_RECENT_WORDS)
+      recent_hand = 0;
+  }
+
+  idx = recent_hand;
+  if (++recent_hand == BLOOM_RECENT_WORDS)
+    recent_hand = 0;
+
+  for (link = recent_chain(recent_fingerprint[idx]); *link != idx;
+       link = &recent_next[*link])
+    ;
+  *link = recent_next[idx];
+  return idx;
+}
+
+/*
+ * Remember a checked word's result
+ *
+ * Nothing is kept if one of the probes since probe_failed was last
+ * cleared could not be read, since a read error looks like a clear bit.
+ */
+static void recent_remember(uint32_t fingerprint, bool found) {
+  uint8_t idx;
+  uint8_t *chain;
+
+  if (probe_failed)
+    return;
+
+  idx = recent_find(fingerprint);
+  if (idx == RECENT_NONE) {
+    idx = recent_victim();
+    chain = recent_chain(fingerprint);
+    recent_fingerprint[idx] = fingerprint;
+    recent_next[idx] = *chain;
+    *chain = idx;
+  }
+  recent_flags[idx] = RECENT_REFERENCED | (found ? RECENT_FOUND : 0);
+}
+
+/* A word's fingerprint, from its running hashes */
+static uint32_t word_fingerprint(const word_hash_t *hash) {
+  return bloom_kernel_fingerprint(&hash->kernel);
+}
+#endif
+
+/*
+ * Check if word exists in Bloom filter
+ *
+ * hash holds the word's running hashes when they were kept while it was
+ * typed; with NULL the word is hashed here.
+ *
+ * Returns: true if word probably in dictionary (may have false positives)
+ *          false if word definitely NOT in dictionary (no false negatives)
+ *
+ * Algorithm:
+ * 0. Answer a word checked lately with its remembered result, and
+ *    accept common words found in the RAM table, without touching the disk
+ * 1. Compute all hash values and the bits they select
+ * 2. Sort probes by record for optimal disk access (left-to-right)
+ * 3. Check each bit - return false immediately if any bit is unset
+ * 4. Return true only if all bits are set, and remember the result
+ * (A binary fuse filter reads all three bytes, and passes if they XOR
+ * to zero with the fingerprint.)
+ */
+static bool check_word(const char *word, const word_hash_t *hash) {
+  bloom_probe_t probes[NUM_BIT_PROBES];
+  word_hash_t text_hash;
+#if BLOOM_RECENT_WORDS > 0
+  uint32_t fingerprint;
+  bool found;
+#endif
+
+  /* Reset period counter */
+  period_count = 0;
+
+  if (!debug_mode) {
+    console_printf("Checking");
+  }
+
+#if BLOOM_PROFILE
+  profile_word_begin();
+#endif
+
+  if (!hash) {
+    word_hash_string(&text_hash, word);
+    hash = &text_hash;
+  }
+#if BLOOM_RECENT_WORDS > 0
+  fingerprint = word_fingerprint(hash);
+  if (recent_lookup(fingerprint, &found)) {
+    return found;
+  }
+#endif
+  if (!word_hash_probes(hash, probes)) {
+    return true;
+  }
+
+#if BLOOM_PROFILE
+  profile_enter(PHASE_OTHER);
+#endif
+
+  /* Check bits in sorted order (left-to-right on disk); any clear bit
+   * means the word is definitely not in the dictionary */
+#if BLOOM_RECENT_WORDS > 0
+  probe_failed = false;
+  found = bloom_test_probes(probes, NUM_BIT_PROBES);
+  recent_remember(fingerprint, found);
+  return found;
+#else
+  return bloom_test_probes(probes, NUM_BIT_PROBES);
+#endif
+}
+
+/* ========================================================================== */
+/* STRING UTILITIES                                                          */
+/* ========================================================================== */
+/* PETSCII conversion and string manipulation                                */
+
+/*
+ * Convert PETSCII input to uppercase ASCII
+ *
+ * Letters are converted with petscii_letter(); everything else is kept.
+ * Conversion ensures consistent hashing regardless of how user typed the word.
+ */
+void petscii_to_ascii_upper(char *str) {
+  char letter;
+
+  while (*str) {
+    letter = petscii_letter((unsigned char)*str);
+    if (letter) {
+      *str = letter;
+    }
+    str++;
+  }
+}
+
+/*
+ * Print a colored result, aligned under the word typed after the prompt
+ *
+ * column is how far into the line the cursor already is.
+ */
+static void print_result(bool result, uint8_t column) {
+  do {
+    console_putc(' ');
+  } while (++column < PROMPT_LENGTH);
+
+  if (result) {
+    console_printf("%c%c %cOK\n", PETSCII_COLOR_GOOD, PETSCII_CIRCLE,
+                   PETSCII_COLOR_DEFAULT);
+  } else {
+    console_printf("%c%c %cNOT FOUND\n", PETSCII_COLOR_BAD, PETSCII_X,
+                   PETSCII_COLOR_DEFAULT);
+  }
+}
+
+/*
+ * Trim leading and trailing whitespace
+ */
+void trim(char *str) {
+  char *end;
+
+  /* Trim leading space */
+  while (console_isspace(*str))
+    str++;
+
+  if (*str == 0)
+    return;
+
+  /* Trim trailing space */
+  end = str + strlen(str) - 1;
+  while (end > str && console_isspace(*end))
+    end--;
+
+  *(end + 1) = '\0';
+}
+
+#if BLOOM_BATCH_WORDS > 0
+/* ========================================================================== */
+/* BATCH DOCUMENT MODE                                                       */
+/* ========================================================================== */
+/* Spell check a SEQ file with one ascending sweep over the records it needs */
+
+/*
+ * Queue a word for the next sweep
+ *
+ * Returns: false if the batch is full and must be swept first
+ *
+ * Words already in the batch are ignored, so each distinct word is probed
+ * once and reported under the first line it appears on. A word checked
+ * lately is not probed again: it joins the batch only to be reported if
+ * it was misspelled.
+ */
+static bool batch_add(const char *word, uint16_t line) {
+  uint8_t bucket = hash_djb2(word, 0) & (BATCH_BUCKETS - 1);
+  uint8_t idx;
+  uint8_t len = strlen(word) + 1;
+  bloom_hash_state_t state;
+  bloom_probe_t probes[NUM_BIT_PROBES];
+  const char *c;
+  uint8_t i;
+#if BLOOM_RECENT_WORDS > 0
+  uint32_t fingerprint;
+  bool known, found;
+#endif
+
+#if COMMON_WORD_COUNT > 0
+  /* Common words are known good and never join the sweep */
+  if (common_word_lookup(common_word_hash(word)))
+    return true;
+#endif
+
+  for (idx = batch_bucket[bucket]; idx != BATCH_NONE; idx = batch_word_next[idx]) {
+    if (strcmp(batch_text + batch_word_text[idx], word) == 0)
+      return true;
+  }
+
+  if (batch_words == BLOOM_BATCH_WORDS ||
+      batch_text_used + len > BATCH_TEXT_SIZE) {
+    return false;
+  }
+
+  bloom_kernel_init(&state);
+  for (c = word; *c; c++) {
+    bloom_kernel_step(&state, (uint8_t)*c);
+  }
+#if BLOOM_RECENT_WORDS > 0
+  fingerprint = bloom_kernel_fingerprint(&state);
+  known = recent_lookup(fingerprint, &found);
+  if (known && found)
+    return true;
+#endif
+
+  idx = batch_words++;
+  memcpy(batch_text + batch_text_used, word, len);
+  batch_word_text[idx] = batch_text_used;
+  batch_text_used += len;
+  batch_word_line[idx] = line;
+  sweep_alive[idx] = 1;
+  batch_word_next[idx] = batch_bucket[bucket];
+  batch_bucket[bucket] = idx;
+#if BLOOM_RECENT_WORDS > 0
+  batch_word_fingerprint[idx] = fingerprint;
+  if (known) {
+    sweep_alive[idx] = 0; /* Misspelled when last checked */
+    return true;
+  }
+#endif
+
+  bloom_kernel_finish(&state, probes);
+  for (i = 0; i < NUM_BIT_PROBES; i++) {
+    sweep[sweep_used].probe = probes[i];
+    sweep[sweep_used].word = idx;
+    sweep_used++;
+  }
+  return true;
+}
+
+/*
+ * Empty the batch
+ */
+static void batch_reset(void) {
+  memset(batch_bucket, BATCH_NONE, sizeof(batch_bucket));
+  batch_words = 0;
+  batch_text_used = 0;
+  sweep_used = 0;
+}
+
+/*
+ * Sort the sweep by record number (Shell sort, Knuth gaps)
+ */
+static void sweep_sort(void) {
+  uint16_t gap = 1, i, j;
+  sweep_entry_t temp;
+
+  while (gap < sweep_used / 3) {
+    gap = gap * 3 + 1;
+  }
+
+  for (; gap > 0; gap /= 3) {
+    for (i = gap; i < sweep_used; i++) {
+      temp = sweep[i];
+      for (j = i; j >= gap && sweep[j - gap].probe.record > temp.probe.record;
+           j -= gap) {
+        sweep[j] = sweep[j - gap];
+      }
+      sweep[j] = temp;
+    }
+  }
+}
+
+/*
+ * Test every queued probe in one ascending pass over the records
+ *
+ * Probes for one record are adjacent, so the record cache (or the drive's
+ * buffer, in drive mode) fetches each record at most once. Probes owned by
+ * words already known to be misspelled are skipped, and so are records
+ * whose probes all belong to such words. A binary fuse filter word stays
+ * alive until its shares are all in, and is then kept if they XOR to zero.
+ */
+static void sweep_run(void) {
+  uint16_t i;
+  const sweep_entry_t *entry;
+#if BLOOM_STRIPED
+  uint16_t j;
+#endif
+#if BLOOM_LAYOUT == BLOOM_LAYOUT_FUSE
+  uint8_t share;
+
+  for (i = 0; i < sweep_used; i++) {
+    sweep_shares[sweep[i].word] = 0;
+  }
+#endif
+
+  for (i = 0; i < sweep_used; i++) {
+    entry = &sweep[i];
+#if BLOOM_STRIPED
+    for (j = i; j < sweep_used && j < i + STRIPE_LOOKAHEAD; j++) {
+      if (sweep_alive[sweep[j].word])
+        stripe_prefetch(sweep[j].probe.record);
+    }
+#endif
+#if BLOOM_LAYOUT == BLOOM_LAYOUT_FUSE
+    if (sweep_alive[entry->word]) {
+      if (bloom_probe_share(&entry->probe, &share))
+        sweep_shares[entry->word] ^= share;
+      else
+        sweep_alive[entry->word] = 0;
+    }
+#else
+    if (sweep_alive[entry->word] && !bloom_test_probe(&entry->probe)) {
+      sweep_alive[entry->word] = 0;
+    }
+#endif
+  }
+
+#if BLOOM_LAYOUT == BLOOM_LAYOUT_FUSE
+  for (i = 0; i < sweep_used; i++) {
+    if (sweep_shares[sweep[i].word])
+      sweep_alive[sweep[i].word] = 0;
+  }
+#endif
+}
+
+/*
+ * Sweep the batch, print its misspelled words and empty it
+ *
+ * Returns: number of misspelled words
+ */
+static uint16_t batch_flush(void) {
+  uint8_t idx;
+  uint16_t misspelled = 0;
+
+  sweep_sort();
+#if BLOOM_RECENT_WORDS > 0
+  probe_failed = false;
+#endif
+  sweep_run();
+  console_printf("\n");
+
+  for (idx = 0; idx < batch_words; idx++) {
+#if BLOOM_RECENT_WORDS > 0
+    recent_remember(batch_word_fingerprint[idx], sweep_alive[idx]);
+#endif
+    if (!sweep_alive[idx]) {
+      console_printf("%c%5u %s%c\n", PETSCII_COLOR_BAD,
+                     batch_word_line[idx], batch_text + batch_word_text[idx],
+                     PETSCII_COLOR_DEFAULT);
+      misspelled++;
+    }
+  }
+
+  batch_reset();
+  return misspelled;
+}
+
+/*
+ * Spell check every word in a SEQ file
+ *
+ * Letters (and apostrophes inside words) form words; anything else
+ * separates them. Words are queued until the batch is full, then swept.
+ */
+static void batch_check_file(const char *name) {
+  char token[MAX_WORD_LEN];
+  char open_name[MAX_WORD_LEN + 4];
+  uint8_t len = 0;
+  uint8_t c, st;
+  char letter;
+  uint16_t line = 1, total = 0, misspelled = 0;
+  bool was_return = false;
+  uint32_t start = read_jiffies();
+
+  console_sprintf(open_name, "%s,S,R", name);
+  cbm_k_setlfs(seq_lfn, bloom_device, seq_secondary);
+  cbm_k_setnam(open_name);
+  if (cbm_k_open() || !check_dos_status(bloom_device, "open file", NULL, 0)) {
+    cbm_k_close(seq_lfn);
+    return;
+  }
+
+  console_printf("Checking %s", name);
+  batch_reset();
+  cbm_k_chkin(seq_lfn);
+
+  do {
+    c = cbm_k_basin();
+    st = cbm_k_readst();
+    letter = petscii_letter(c);
+
+    if (letter || (c == APOSTROPHE && len > 0)) {
+      if (len < MAX_WORD_LEN - 1)
+        token[len++] = letter ? letter : c;
+    } else if (len) {
+      /* Closing quotes are not part of the word */
+      while (token[len - 1] == APOSTROPHE)
+        len--;
+      token[len] = '\0';
+      len = 0;
+      total++;
+
+      if (!batch_add(token, line)) {
+        cbm_k_clrch();
+        misspelled += batch_flush();
+        batch_add(token, line); /* Always fits in an empty batch */
+        cbm_k_chkin(seq_lfn);
+      }
+    }
+
+    /* Count CR (PETSCII) and LF (ASCII) line endings, but CR LF once */
+    if (c == PETSCII_RETURN || (c == ASCII_LINEFEED && !was_return))
+      line++;
+    was_return = (c == PETSCII_RETURN);
+  } while (st == 0);
+
+  cbm_k_clrch();
+
+  if (len) {
+    while (token[len - 1] == APOSTROPHE)
+      len--;
+    token[len] = '\0';
+    total++;
+    if (!batch_add(token, line)) {
+      misspelled += batch_flush();
+      batch_add(token, line);
+    }
+  }
+
+  misspelled += batch_flush();
+  cbm_k_close(seq_lfn);
+
+  console_printf("%u words, %u misspelled, ", total, misspelled);
+  print_seconds(read_jiffies() - start);
+  console_printf("\n");
+}
+#endif
+
+#if BLOOM_SUGGEST
+/* ========================================================================== */
+/* SPELLING SUGGESTIONS                                                      */
+/* ========================================================================== */
+/* Corrections one edit away, found with batch mode's ascending sweeps       */
+
+/*
+ * Position in the edits of a word: the edit tried next, and the running
+ * hashes of the characters before it, which every edit there shares
+ */
+typedef struct {
+  suggest_edit_t edit;
+  word_hash_t prefix;
+} suggest_cursor_t;
+
+/*
+ * Write out the word an edit makes of word
+ */
+static void suggest_text(const char *word, const suggest_edit_t *edit,
+                         char *text) {
+  const char *tail = word + edit->pos;
+
+  memcpy(text, word, edit->pos);
+  text += edit->pos;
+  switch (edit->kind) {
+  case EDIT_DELETE:
+    tail++;
+    break;
+  case EDIT_TRANSPOSE:
+    *text++ = tail[1];
+    *text++ = tail[0];
+    tail += 2;
+    break;
+  case EDIT_SUBSTITUTE:
+    *text++ = edit->letter;
+    tail++;
+    break;
+  case EDIT_INSERT:
+    *text++ = edit->letter;
+    break;
+  }
+  strcpy(text, tail);
+}
+
+/*
+ * Step a cursor to the next edit worth trying
+ *
+ * Returns: false once every edit of word has been tried
+ *
+ * Edits that repeat another are skipped: deleting the second of two equal
+ * letters, swapping equal letters, substituting a letter with itself and
+ * inserting a letter after the same letter. Every candidate is then
+ * distinct, and none is word itself.
+ */
+static bool suggest_next(suggest_cursor_t *cursor, const char *word,
+                         suggest_edit_t *edit) {
+  suggest_edit_t *next = &cursor->edit;
+  char before, at;
+
+  for (;;) {
+    before = next->pos ? word[next->pos - 1] : 0;
+    at = word[next->pos]; /* NUL past the last letter */
+    *edit = *next;
+
+    switch (next->kind) {
+    case EDIT_DELETE:
+      next->kind = EDIT_TRANSPOSE;
+      if (at && at != before)
+        return true;
+      break;
+    case EDIT_TRANSPOSE:
+      next->kind = EDIT_SUBSTITUTE;
+      next->letter = 'A';
+      if (at && word[next->pos + 1] && at != word[next->pos + 1])
+        return true;
+      break;
+    case EDIT_SUBSTITUTE:
+      if (!at || next->letter > 'Z') {
+        next->kind = EDIT_INSERT;
+        next->letter = 'A';
+        break;
+      }
+      next->letter++;
+      if (edit->letter != at)
+        return true;
+      break;
+    case EDIT_INSERT:
+      if (next->letter > 'Z') {
+        next->kind = EDIT_NEXT;
+        break;
+      }
+      next->letter++;
+      if (edit->letter != before)
+        return true;
+      break;
+    default: /* EDIT_NEXT */
+      if (!at)
+        return false;
+      word_hash_step(&cursor->prefix, (uint8_t)at);
+      next->pos++;
+      next->kind = EDIT_DELETE;
+    }
+  }
+}
+
+/*
+ * List corrections of a misspelled word
+ *
+ * Every word one deletion, transposition, substitution or insertion away
+ * is a candidate: several hundred for a typical word, each needing
+ * NUM_BIT_PROBES probes. Rather than check them one by one, candidates
+ * are queued BLOOM_BATCH_WORDS at a time and swept like a batch of
+ * document words, so each record is read at most once per sweep and a
+ * candidate costs no more reads after its first clear bit. Candidate
+ * hashes continue from the running hashes of the unchanged prefix.
+ */
+static void suggest_words(const char *word) {
+  suggest_cursor_t cursor, replay;
+  suggest_edit_t edit;
+  char text[MAX_WORD_LEN + 1];
+  word_hash_t hash;
+  bloom_probe_t probes[NUM_BIT_PROBES];
+  const char *tail;
+  uint8_t count, idx, i;
+  uint8_t found = 0;
+  uint16_t tried = 0;
+  uint32_t start = read_jiffies();
+
+  cursor.edit.pos = 0;
+  cursor.edit.kind = EDIT_DELETE;
+  word_hash_init(&cursor.prefix);
+  console_printf("Suggesting");
+
+  do {
+    /* Queue the next sweep's candidates */
+    replay = cursor;
+    sweep_used = 0;
+    for (count = 0;
+         count < BLOOM_BATCH_WORDS && suggest_next(&cursor, word, &edit);
+         count++) {
+      suggest_text(word, &edit, text);
+      hash = cursor.prefix;
+      for (tail = text + edit.pos; *tail; tail++)
+        word_hash_step(&hash, (uint8_t)*tail);
+
+      sweep_alive[count] = 1;
+      if (!word_hash_probes(&hash, probes))
+        continue; /* Common word: passes without probes */
+      for (i = 0; i < NUM_BIT_PROBES; i++) {
+        sweep[sweep_used].probe = probes[i];
+        sweep[sweep_used].word = count;
+        sweep_used++;
+      }
+    }
+
+    sweep_sort();
+    sweep_run();
+    tried += count;
+
+    /* Replay the same edits to keep the ones that passed */
+    for (idx = 0; idx < count && found < SUGGEST_MAX; idx++) {
+      suggest_next(&replay, word, &edit);
+      if (sweep_alive[idx])
+        suggest_found[found++] = edit;
+    }
+  } while (count == BLOOM_BATCH_WORDS && found < SUGGEST_MAX);
+
+  console_printf("\n");
+  for (idx = 0; idx < found; idx++) {
+    suggest_text(word, &suggest_found[idx], text);
+    console_printf("%c%s%c\n", PETSCII_COLOR_GOOD, text,
+                   PETSCII_COLOR_DEFAULT);
+  }
+  console_printf("%u candidates, %u suggestions, ", tried, found);
+  print_seconds(read_jiffies() - start);
+  console_printf("\n");
+}
+#endif
+
+#if BLOOM_TYPE_AHEAD
+/* ========================================================================== */
+/* TYPE-AHEAD INPUT                                                          */
+/* ========================================================================== */
+/* Keystroke-driven line editor that checks words while the user types      */
+
+/*
+ * typeahead_hash[n] holds the running hashes of the first n characters
+ * of the word being typed, so DEL just steps back one entry. Queued
+ * words keep a copy. Words longer than TYPEAHEAD_HASH_DEPTH are hashed
+ * from their text when checked.
+ */
+static word_hash_t typeahead_hash[TYPEAHEAD_HASH_DEPTH + 1];
+static word_hash_t typeahead_word_hash[TYPEAHEAD_WORDS];
+static bool typeahead_hashed[TYPEAHEAD_WORDS];
+
+/*
+ * Start the cursor blinking, as the screen editor does while it waits
+ */
+static void cursor_show(void) {
+  CURSOR_BLINK_OFF = 0;
+}
+
+/*
+ * Stop the cursor blinking and put back the character under it
+ *
+ * Blinking stops first, so the IRQ cannot redraw it behind our back.
+ */
+static void cursor_hide(void) {
+  CURSOR_BLINK_OFF = 1;
+  if (CURSOR_REVERSED) {
+    CURSOR_REVERSED = 0;
+    CURSOR_LINE[CURSOR_COLUMN] = CURSOR_CHAR;
+  }
+}
+
+/*
+ * Print part of the typed line, as typed
+ */
+static void typeahead_print(uint8_t start, uint8_t end) {
+  while (start < end)
+    cbm_k_bsout(typeahead_line[start++]);
+}
+
+/*
+ * Copy part of the typed line out as an uppercase ASCII word
+ */
+static void typeahead_text(uint8_t start, uint8_t end, char *word) {
+  memcpy(word, typeahead_line + start, end - start);
+  word[end - start] = '\0';
+  petscii_to_ascii_upper(word);
+}
+
+/*
+ * Find where the word being typed starts
+ */
+static uint8_t typeahead_word_start(void) {
+  uint8_t start = typeahead_len;
+
+  while (start && typeahead_line[start - 1] != PETSCII_SPACE)
+    start--;
+  return start;
+}
+
+/*
+ * Hash one more typed character of the word being typed
+ *
+ * length is the number of characters before it. The character is
+ * converted as petscii_to_ascii_upper() would.
+ */
+static void typeahead_hash_key(uint8_t length, uint8_t key) {
+  char letter;
+
+  if (length >= TYPEAHEAD_HASH_DEPTH)
+    return;
+  letter = petscii_letter(key);
+  typeahead_hash[length + 1] = typeahead_hash[length];
+  word_hash_step(&typeahead_hash[length + 1], letter ? letter : key);
+}
+
+/*
+ * Rebuild the hash stack of the word being typed from its text
+ *
+ * Needed when DEL removes a space and the cursor is back in a word whose
+ * entries have since been reused.
+ */
+static void typeahead_rehash(void) {
+  uint8_t start = typeahead_word_start();
+  uint8_t i;
+
+  for (i = start; i < typeahead_len; i++)
+    typeahead_hash_key(i - start, typeahead_line[i]);
+}
+
+/*
+ * Running hashes of the word being typed, which starts at column start
+ *
+ * Returns: NULL if the word is too long to have been kept
+ */
+static const word_hash_t *typeahead_current_hash(uint8_t start) {
+  if (typeahead_len - start > TYPEAHEAD_HASH_DEPTH)
+    return NULL;
+  return &typeahead_hash[typeahead_len - start];
+}
+
+/*
+ * Find a queued word by its place on the line
+ *
+ * Returns: its queue index, or typeahead_words if it is not queued
+ */
+static uint8_t typeahead_find(uint8_t start, uint8_t end) {
+  uint8_t i;
+
+  for (i = 0; i < typeahead_words; i++) {
+    if (typeahead_start[i] == start && typeahead_end[i] == end)
+      break;
+  }
+  return i;
+}
+
+/*
+ * Queue the word being typed, which starts at column start, for a
+ * background check
+ *
+ * Returns: false if the queue is full; the word is then checked after
+ * RETURN like any other
+ */
+static bool typeahead_queue(uint8_t start) {
+  const word_hash_t *hash = typeahead_current_hash(start);
+
+  if (typeahead_words == TYPEAHEAD_WORDS)
+    return false;
+  typeahead_start[typeahead_words] = start;
+  typeahead_end[typeahead_words] = typeahead_len;
+  typeahead_state[typeahead_words] = TYPEAHEAD_PENDING;
+  typeahead_hashed[typeahead_words] = hash != NULL;
+  if (hash)
+    typeahead_word_hash[typeahead_words] = *hash;
+  typeahead_words++;
+  return true;
+}
+
+/*
+ * Forget queued words that reach column end or beyond
+ *
+ * Typing a letter at the end of a word, or deleting into it, changes the
+ * word. Words are queued in line order, so only the last ones can go.
+ */
+static void typeahead_drop(uint8_t end) {
+  while (typeahead_words && typeahead_end[typeahead_words - 1] >= end)
+    typeahead_words--;
+  if (typeahead_word != TYPEAHEAD_IDLE && typeahead_word >= typeahead_words)
+    typeahead_word = TYPEAHEAD_IDLE;
+}
+
+/*
+ * Do one step of background work while no key is waiting
+ *
+ * Words finished with a space are checked in order, one probe per call,
+ * so a keystroke waits for at most one record read; the KERNAL keeps
+ * buffering keys meanwhile. With nothing queued and the user pausing,
+ * the word being typed is guessed to be complete and checked too: if
+ * RETURN follows, its answer is ready, and if another letter follows,
+ * its records still sit in the cache.
+ */
+static void typeahead_step(uint32_t idle_since) {
+  char word[MAX_WORD_LEN];
+  word_hash_t text_hash;
+  const word_hash_t *hash;
+  uint8_t i, start;
+  bool hit;
+#if BLOOM_STRIPED
+  uint8_t j;
+#endif
+#if BLOOM_RECENT_WORDS > 0
+  bool found;
+#endif
+#if BLOOM_LAYOUT == BLOOM_LAYOUT_FUSE
+  uint8_t share;
+#endif
+
+  if (typeahead_word == TYPEAHEAD_IDLE) {
+    for (i = 0; i < typeahead_words; i++) {
+      if (typeahead_state[i] == TYPEAHEAD_PENDING)
+        break;
+    }
+    if (i == typeahead_words) {
+      start = typeahead_word_start();
+      if (start == typeahead_len ||
+          read_jiffies() - idle_since < TYPEAHEAD_PAUSE ||
+          typeahead_find(start, typeahead_len) < typeahead_words ||
+          !typeahead_queue(start)) {
+        return;
+      }
+    }
+
+    hash = &typeahead_word_hash[i];
+    if (!typeahead_hashed[i]) {
+      typeahead_text(typeahead_start[i], typeahead_end[i], word);
+      word_hash_string(&text_hash, word);
+      hash = &text_hash;
+    }
+#if BLOOM_RECENT_WORDS > 0
+    typeahead_fingerprint = word_fingerprint(hash);
+    if (recent_lookup(typeahead_fingerprint, &found)) {
+      typeahead_state[i] = found ? TYPEAHEAD_FOUND : TYPEAHEAD_MISSING;
+      return;
+    }
+    probe_failed = false;
+#endif
+    if (!word_hash_probes(hash, typeahead_probes)) {
+      typeahead_state[i] = TYPEAHEAD_FOUND;
+      return;
+    }
+    typeahead_word = i;
+    typeahead_next = 0;
+#if BLOOM_LAYOUT == BLOOM_LAYOUT_FUSE
+    typeahead_shares = 0;
+#endif
+    return;
+  }
+
+  quiet_mode = true;
+#if BLOOM_STRIPED
+  for (j = typeahead_next;
+       j < NUM_BIT_PROBES && j < typeahead_next + STRIPE_LOOKAHEAD; j++) {
+    stripe_prefetch(typeahead_probes[j].record);
+  }
+#endif
+#if BLOOM_LAYOUT == BLOOM_LAYOUT_FUSE
+  hit = bloom_probe_share(&typeahead_probes[typeahead_next], &share);
+  typeahead_shares ^= share;
+#else
+  hit = bloom_test_probe(&typeahead_probes[typeahead_next]);
+#endif
+  quiet_mode = false;
+  cbm_k_clrch();
+
+#if BLOOM_LAYOUT == BLOOM_LAYOUT_FUSE
+  if (hit && typeahead_next + 1 == NUM_BIT_PROBES && typeahead_shares)
+    hit = false; /* All shares in, and they do not cancel */
+#endif
+  if (!hit || ++typeahead_next == NUM_BIT_PROBES) {
+    typeahead_state[typeahead_word] = hit ? TYPEAHEAD_FOUND : TYPEAHEAD_MISSING;
+#if BLOOM_RECENT_WORDS > 0
+    recent_remember(typeahead_fingerprint, hit);
+#endif
+    typeahead_word = TYPEAHEAD_IDLE;
+  }
+}
+
+/*
+ * Read one line from the keyboard, checking its words as they are typed
+ *
+ * Replaces the screen editor's line input: keys are read with GETIN,
+ * echoed, and the time between them goes to typeahead_step(). Only
+ * printable keys, DEL and RETURN are accepted. Debug mode does no
+ * background work, so its output never lands in the middle of a line.
+ */
+static void typeahead_read_line(char *line) {
+  uint32_t idle_since = read_jiffies();
+  uint8_t start;
+  uint8_t key;
+
+  typeahead_len = 0;
+  typeahead_words = 0;
+  typeahead_word = TYPEAHEAD_IDLE;
+  word_hash_init(&typeahead_hash[0]);
+  cursor_show();
+
+  for (;;) {
+    key = cbm_k_getin();
+    if (!key) {
+      if (!debug_mode)
+        typeahead_step(idle_since);
+      continue;
+    }
+    idle_since = read_jiffies();
+
+    if (key == PETSCII_RETURN || key == PETSCII_SHIFT_RETURN)
+      break;
+
+    if (key == PETSCII_DELETE) {
+      if (typeahead_len) {
+        typeahead_len--;
+        typeahead_drop(typeahead_len + 1);
+        if (typeahead_line[typeahead_len] == PETSCII_SPACE)
+          typeahead_rehash();
+      } else {
+        continue;
+      }
+    } else if ((key & 0x7F) < PETSCII_SPACE ||
+               typeahead_len == MAX_WORD_LEN - 1) {
+      continue; /* Cursor and color keys, or the line is full */
+    } else {
+      if (key == PETSCII_SPACE) {
+        /* A space finishes the word before it */
+        start = typeahead_word_start();
+        if (start < typeahead_len &&
+            typeahead_find(start, typeahead_len) == typeahead_words) {
+          typeahead_queue(start);
+        }
+      } else {
+        typeahead_drop(typeahead_len);
+        typeahead_hash_key(typeahead_len - typeahead_word_start(), key);
+      }
+      typeahead_line[typeahead_len++] = key;
+    }
+
+    cursor_hide();
+    cbm_k_bsout(key);
+    cursor_show();
+  }
+
+  cursor_hide();
+  cbm_k_bsout(PETSCII_RETURN);
+  typeahead_text(0, typeahead_len, line);
+}
+
+/*
+ * Print the result of every word on the typed line
+ *
+ * Returns: number of words that still had to be checked
+ *
+ * Words settled in the background print at once, as typed; the rest
+ * are checked now with the usual progress periods.
+ */
+static uint8_t typeahead_check_line(void) {
+  char word[MAX_WORD_LEN];
+  const word_hash_t *hash;
+  uint8_t start = 0, end, i;
+  uint8_t checked = 0;
+  bool result;
+
+  for (;;) {
+    while (start < typeahead_len && typeahead_line[start] == PETSCII_SPACE)
+      start++;
+    if (start == typeahead_len)
+      break;
+    for (end = start;
+         end < typeahead_len && typeahead_line[end] != PETSCII_SPACE; end++)
+      ;
+
+    i = typeahead_find(start, end);
+    if (i < typeahead_words && typeahead_state[i] != TYPEAHEAD_PENDING) {
+      typeahead_print(start, end);
+      print_result(typeahead_state[i] == TYPEAHEAD_FOUND, end - start);
+    } else {
+      typeahead_text(start, end, word);
+      if (i < typeahead_words && typeahead_hashed[i])
+        hash = &typeahead_word_hash[i];
+      else if (end == typeahead_len)
+        hash = typeahead_current_hash(start);
+      else
+        hash = NULL;
+      result = check_word(word, hash);
+#if BLOOM_PROFILE
+      profile_word_end();
+#endif
+      print_result(result, CHECKING_LENGTH + period_count);
+      checked++;
+    }
+    start = end;
+  }
+  return checked;
+}
+#endif
+
+#if BLOOM_BENCH
+/* ========================================================================== */
+/* BENCHMARK                                                                 */
+/* ========================================================================== */
+/* spellcheck_bench: the embedded word list, timed, with results on disk     */
+
+/*
+ * Write a line to the results file, ending it with a PETSCII RETURN
+ */
+static void bench_write_line(const char *line) {
+  cbm_k_chkout(bench_lfn);
+  while (*line) {
+    cbm_k_bsout(*line++);
+  }
+  cbm_k_bsout(PETSCII_RETURN);
+  cbm_k_clrch();
+}
+
+/*
+ * Check every word of bench_text and write one line per word to BENCH
+ * on BENCH_DEVICE
+ *
+ * Returns: the number of words answered differently than expected
+ *
+ * A line is the word, the answer expected and the one given, the cycles
+ * of each profiling phase, then the records read and the record cache,
+ * common-word and recent-word hits of the lookup, separated by commas.
+ * vice_bench.py turns the file into latency and hit rate figures. Lines
+ * are written between lookups, so the drive's writes are not timed.
+ */
+static uint16_t bench_run(void) {
+  char line[MAX_WORD_LEN + 64];
+  const char *word = bench_text;
+  uint16_t i, wrong = 0;
+  uint16_t cache = 0, common = 0, recent = 0; /* Hits of one lookup */
+  uint8_t phase;
+  bool found;
+
+  if (!command_open(BENCH_DEVICE)) {
+    return BENCH_WORDS;
+  }
+  cbm_k_setlfs(bench_lfn, BENCH_DEVICE, bench_secondary);
+  cbm_k_setnam(BENCH_FILENAME);
+  if (cbm_k_open() || !check_dos_status(BENCH_DEVICE, "open bench", NULL, 0)) {
+    cbm_k_close(bench_lfn);
+    cbm_k_close(bench_command_lfn);
+    return BENCH_WORDS;
+  }
+
+  for (i = 0; i < BENCH_WORDS; i++) {
+#if COMMON_WORD_COUNT > 0
+    common = common_hits;
+#endif
+#if BLOOM_RECENT_WORDS > 0
+    recent = recent_hits;
+#endif
+
+    console_printf("%s ", word);
+    found = check_word(word, NULL);
+    profile_word_end();
+    print_result(found, strlen(word) + 1 + CHECKING_LENGTH + period_count);
+    if (found != bench_expected[i]) {
+      wrong++;
+    }
+
+    console_sprintf(line, "%s,%u,%u", word, bench_expected[i], found);
+    for (phase = 0; phase < NUM_PHASES; phase++) {
+      console_sprintf(line + strlen(line), ",%lu", profile_word[phase]);
+    }
+#if BLOOM_CACHE_SLOTS > 0
+    cache = cache_hits - profile_hits_start;
+#endif
+#if COMMON_WORD_COUNT > 0
+    common = common_hits - common;
+#endif
+#if BLOOM_RECENT_WORDS > 0
+    recent = recent_hits - recent;
+#endif
+    console_sprintf(line + strlen(line), ",%u,%u,%u,%u", profile_reads, cache,
+                    common, recent);
+    bench_write_line(line);
+
+    word += strlen(word) + 1;
+  }
+
+  /* Reading the status waits for the drive to finish writing the file */
+  cbm_k_close(bench_lfn);
+  check_dos_status(BENCH_DEVICE, "close bench", NULL, 0);
+  cbm_k_close(bench_command_lfn);
+
+  console_printf("\nbench: %u words, %u wrong\n", BENCH_WORDS, wrong);
+  return wrong;
+}
+#endif
+
+/* ========================================================================== */
+/* MAIN PROGRAM                                                              */
+/* ========================================================================== */
 
 int main(void) {
+#if BLOOM_BENCH
+  uint16_t wrong;
+#else
   char word[MAX_WORD_LEN];
+#if !BLOOM_TYPE_AHEAD
   bool result;
-  uint8_t spaces_needed;
-  uint8_t i;
+#endif
+#endif
 
-  putchar(PETSCII_COLOR_DEFAULT);
-  printf(DICT_INFO);
+#if BLOOM_PROFILE
+  profile_start();
+#endif
 
-  /* Open bloom filter file */
+  /* Open bloom filter file, then print the banner while the drive works */
+  console_putc(PETSCII_COLOR_DEFAULT);
   if (!bloom_open()) {
-    printf("failed to open bloom.dat\n");
+    console_printf("failed to open bloom.dat\n");
     return 1;
   }
-
+  console_printf(DICT_INFO);
+  if (!bloom_open_finish()) {
+    console_printf("failed to open bloom.dat\n");
+    return 1;
+  }
+#if BLOOM_RECENT_WORDS > 0
+  recent_reset();
+#endif
+
+#if BLOOM_REU
+  /* Without an REU (or if loading fails) the disk path serves every probe */
+  reu_present = reu_detect() && reu_load();
+#endif
+#if BLOOM_PRELOAD_COUNT > 0
+  cache_preload();
+#endif
+
+#if BLOOM_BENCH
+  wrong = bench_run();
+#else
   /* Main spell-checking loop */
   while (1) {
     cbm_k_clrch();
-    printf("word (or 'quit'): ");
+    console_printf("word (or 'quit'): ");
 
-    if (fgets(word, sizeof(word), stdin) == NULL) {
+#if BLOOM_TYPE_AHEAD
+    typeahead_read_line(word);
+#else
+    if (!console_gets(word, sizeof(word))) {
       break;
     }
+#endif
 
     trim(word);
     if (strlen(word) == 0) {
@@ -506,26 +3234,63 @@ int main(void) {
       break;
     }
 
-    result = check_word(word);
+#if BLOOM_BATCH_WORDS > 0
+    if (word[0] == BATCH_COMMAND) {
+      batch_check_file(word + 1);
+      continue;
+    }
+#endif
 
-    /* Calculate alignment: prompt length - "Checking" length - periods printed */
-    spaces_needed = PROMPT_LENGTH - CHECKING_LENGTH - period_count;
+#if BLOOM_SUGGEST
+    if (word[0] == SUGGEST_COMMAND) {
+      suggest_words(word + 1);
+      continue;
+    }
+#endif
 
-    /* Print spaces to align under user's word */
-    for (i = 0; i < spaces_needed; i++) {
-      printf(" ");
+    if (strcmp(word, "DEBUG") == 0) {
+      debug_mode = !debug_mode;
+      console_printf("debug %s\n", debug_mode ? "on" : "off");
+      continue;
     }
 
-    /* Print colored result */
-    if (result) {
-      printf("%c%c %cOK\n", PETSCII_COLOR_GOOD, PETSCII_CIRCLE, PETSCII_COLOR_DEFAULT);
-    } else {
-      printf("%c%c %cNOT FOUND\n", PETSCII_COLOR_BAD, PETSCII_X, PETSCII_COLOR_DEFAULT);
+#if BLOOM_TYPE_AHEAD
+    if (!typeahead_check_line()) {
+      continue; /* Every answer was ready: nothing new to report */
     }
+#else
+    result = check_word(word, NULL);
+#if BLOOM_PROFILE
+    profile_word_end();
+#endif
+    print_result(result, CHECKING_LENGTH + period_count);
+#endif
+
+    if (debug_mode) {
+#if BLOOM_CACHE_SLOTS > 0
+      console_printf("cache: %u hits, %u misses, %u/%u slots\n",
+                     cache_hits, cache_misses, cache_used, BLOOM_CACHE_SLOTS);
+#endif
+#if COMMON_WORD_COUNT > 0
+      console_printf("common: %u hits\n", common_hits);
+#endif
+#if BLOOM_RECENT_WORDS > 0
+      console_printf("recent: %u hits, %u/%u words\n", recent_hits,
+                     recent_used, BLOOM_RECENT_WORDS);
+#endif
+    }
+
+#if BLOOM_PROFILE
+    profile_report();
+#endif
   }
+#endif
 
   bloom_close();
-  printf("\ngoodbye!\n");
+  console_printf("\ngoodbye!\n");
+#if BLOOM_BENCH
+  BENCH_EXIT = wrong ? BENCH_EXIT_WRONG : BENCH_EXIT_OK;
+#endif
 
   return 0;
 }